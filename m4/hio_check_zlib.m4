@@ -0,0 +1,29 @@
+# -*- mode: shell-script -*-
+# Copyright 2015-2016 Los Alamos National Security, LLC. All rights
+#                     reserved.
+
+AC_DEFUN([HIO_CHECK_ZLIB],[
+    # Check for zlib (used for dataset data compression)
+    AC_ARG_WITH(zlib, [AS_HELP_STRING([--with-zlib=DIR], [enable support for zlib data compression @<:@default=auto@:>@])],
+                [], [with_zlib=auto])
+
+    use_zlib=0
+    if test $with_zlib != no ; then
+        if ( test $with_zlib != auto && test $with_zlib != yes ) ; then
+            if test -d "$with_zlib/lib64" ; then
+                LDFLAGS="$LDFLAGS -L$with_zlib/lib64"
+            else
+                LDFLAGS="$LDFLAGS -L$with_zlib/lib"
+            fi
+            CPPFLAGS="$CPPFLAGS -I$with_zlib/include"
+        fi
+
+        AC_CHECK_HEADERS([zlib.h], [AC_CHECK_LIB([z], [compress2], [use_zlib=1 ; LIBS="$LIBS -lz"])])
+    fi
+
+    if ( test $use_zlib = 0 && test $with_zlib != no && test $with_zlib != auto ) ; then
+        AC_ERROR([zlib support requested but not found])
+    fi
+
+    AC_DEFINE_UNQUOTED([HIO_USE_ZLIB], [$use_zlib], [Whether to use zlib for data compression])
+])
@@ -62,10 +62,22 @@ int hio_dataset_close (hio_dataset_t dataset) {
   }
 #if HIO_MPI_HAVE(1)
   if (1 != context->c_size) {
-    MPI_Reduce (0 == context->c_rank ? MPI_IN_PLACE : tmp, tmp, 6, MPI_UINT64_T, MPI_SUM, 0, context->c_comm);
+    /* all ranks need the total size written to update the expected dataset size */
+    MPI_Allreduce (MPI_IN_PLACE, tmp, 6, MPI_UINT64_T, MPI_SUM, context->c_comm);
   }
 #endif
 
+  if (HIO_SUCCESS == rc && (HIO_FLAG_WRITE & dataset->ds_flags)) {
+    hio_dataset_data_t *ds_data = dataset->ds_data;
+
+    if (0 == ds_data->dd_average_size) {
+      ds_data->dd_average_size = tmp[1];
+    } else {
+      /* integer math. a float can not represent large sizes exactly */
+      ds_data->dd_average_size = ds_data->dd_average_size / 5 * 4 + tmp[1] / 5;
+    }
+  }
+
   if (0 == context->c_rank && context->c_print_stats) {
     printf ("hio.dataset.stat %s.%s.%" PRIu64 " RW_Bytes %" PRIu64 " B %" PRIu64 " B, RW_Ops %" PRIu64 " ops %" PRIu64 " ops, "
             "RW_API_Time %" PRIu64 " us %" PRIu64 " us, Walltime %" PRIu64 " us\n", hioi_object_identifier (&context->c_object),
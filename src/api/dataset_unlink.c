@@ -13,7 +13,7 @@
 
 int hio_dataset_unlink (hio_context_t ctx, const char *name, int64_t set_id, hio_unlink_mode_t mode) {
   hio_module_t *module;
-  int rc = HIO_ERR_NOT_FOUND;
+  int rc = HIO_ERR_NOT_FOUND, ret;
 
   if (NULL == ctx || NULL == name || 0 > set_id) {
     return HIO_ERR_BAD_PARAM;
@@ -36,11 +36,15 @@ int hio_dataset_unlink (hio_context_t ctx, const char *name, int64_t set_id, hio
   for (int i = 0 ; i < ctx->c_mcount ; ++i) {
     module = ctx->c_modules[i];
 
-    if (HIO_SUCCESS == module->dataset_unlink (module, name, set_id)) {
+    ret = module->dataset_unlink (module, name, set_id);
+    if (HIO_SUCCESS == ret) {
       rc = HIO_SUCCESS;
       if (HIO_UNLINK_MODE_FIRST == mode) {
         break;
       }
+    } else if (HIO_ERR_PERM == ret && HIO_SUCCESS != rc) {
+      /* report why an existing dataset could not be removed (ex: it is referenced) */
+      rc = ret;
     }
   }
 
@@ -11,6 +11,49 @@
 
 #include "hio_internal.h"
 
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * Queue a read for coalescing with other reads of the dataset. Queued reads are
+ * issued by hioi_dataset_read_flush().
+ */
+static int hioi_element_read_queue (hio_dataset_t dataset, const hio_internal_request_t *req, hio_request_t *request) {
+  hio_context_t context = hioi_object_context (&dataset->ds_object);
+  hio_internal_request_t *new_req;
+  hio_request_t new_request = NULL;
+
+  if (request) {
+    new_request = hioi_request_alloc (context);
+    if (NULL == new_request) {
+      return HIO_ERR_OUT_OF_RESOURCE;
+    }
+
+    new_request->req_dataset = dataset;
+  }
+
+  new_req = malloc (sizeof (*new_req));
+  if (NULL == new_req) {
+    hioi_request_release (new_request);
+    return HIO_ERR_OUT_OF_RESOURCE;
+  }
+
+  memcpy (new_req, req, sizeof (*new_req));
+  new_req->ir_urequest = new_request;
+  new_req->ir_status = 0;
+
+  pthread_mutex_lock (&dataset->ds_buffer.b_lock);
+  hioi_list_append (new_req, dataset->ds_rqueue, ir_list);
+  ++dataset->ds_rqueue_count;
+  pthread_mutex_unlock (&dataset->ds_buffer.b_lock);
+
+  if (request) {
+    *request = new_request;
+  }
+
+  return HIO_SUCCESS;
+}
+
 ssize_t hio_element_read (hio_element_t element, off_t offset, unsigned long reserved0, void *ptr,
                           size_t count, size_t size) {
   return hio_element_read_strided (element, offset, reserved0, ptr, count, size, 0);
@@ -41,7 +84,7 @@ int hio_element_read_strided_nb (hio_element_t element, hio_request_t *request,
                                  unsigned long reserved0, void *ptr, size_t count, size_t size,
                                  size_t stride) {
   hio_dataset_t dataset = hioi_element_dataset (element);
-  hio_internal_request_t req, *reqs[1] = {&req};
+  hio_internal_request_t req = {.ir_iov = NULL};
 
   if (HIO_OBJECT_NULL == element || offset < 0) {
     return HIO_ERR_BAD_PARAM;
@@ -56,7 +99,78 @@ int hio_element_read_strided_nb (hio_element_t element, hio_request_t *request,
   req.ir_size = size;
   req.ir_stride = stride;
   req.ir_type = HIO_REQUEST_TYPE_READ;
-  req.ir_urequest = request;
 
-  return dataset->ds_process_reqs (dataset, (hio_internal_request_t **) &reqs, 1);
+  if (dataset->ds_read_aggregate && count && size && count * size < (dataset->ds_buffer_size >> 2)) {
+    return hioi_element_read_queue (dataset, &req, request);
+  }
+
+  return hioi_worker_submit (dataset, &req, request);
+}
+
+ssize_t hio_element_read_list (hio_element_t element, int count, const off_t *offsets, void * const *ptrs,
+                               const size_t *lengths) {
+  hio_dataset_t dataset = hioi_element_dataset (element);
+  hio_internal_request_t *items, **reqs;
+  ssize_t total = 0;
+  int nreqs = 0;
+
+  if (HIO_OBJECT_NULL == element || count < 0 || (count && (NULL == offsets || NULL == ptrs || NULL == lengths))) {
+    return HIO_ERR_BAD_PARAM;
+  }
+
+  (void) atomic_fetch_add (&dataset->ds_stat.s_rcount, count);
+
+  items = calloc (count, sizeof (*items));
+  /* the second half of the array is sort scratch space */
+  reqs = malloc (2 * count * sizeof (*reqs));
+  if (NULL == items || NULL == reqs) {
+    free (items);
+    free (reqs);
+    return count ? HIO_ERR_OUT_OF_RESOURCE : 0;
+  }
+
+  for (int i = 0 ; i < count ; ++i) {
+    if (offsets[i] < 0) {
+      free (items);
+      free (reqs);
+      return HIO_ERR_BAD_PARAM;
+    }
+
+    if (0 == lengths[i]) {
+      continue;
+    }
+
+    items[nreqs].ir_element = element;
+    items[nreqs].ir_offset = offsets[i];
+    items[nreqs].ir_data.r = ptrs[i];
+    items[nreqs].ir_count = 1;
+    items[nreqs].ir_size = lengths[i];
+    items[nreqs].ir_type = HIO_REQUEST_TYPE_READ;
+    reqs[nreqs] = items + nreqs;
+    ++nreqs;
+  }
+
+  hioi_dataset_process_reads (dataset, reqs, nreqs, reqs + count);
+
+  for (int i = 0 ; i < nreqs ; ++i) {
+    if (items[i].ir_status < 0) {
+      total = items[i].ir_status;
+      break;
+    }
+
+    total += items[i].ir_status;
+  }
+
+  free (items);
+  free (reqs);
+
+  return total;
+}
+
+int hio_complete (hio_element_t element) {
+  if (HIO_OBJECT_NULL == element) {
+    return HIO_ERR_BAD_PARAM;
+  }
+
+  return hioi_worker_drain (hioi_element_dataset (element));
 }
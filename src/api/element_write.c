@@ -13,78 +13,155 @@
 #include <stdlib.h>
 #include <string.h>
 
+/**
+ * Try to append a write to the dataset buffer without taking the buffer lock
+ *
+ * Buffer space and a request slot are reserved with atomic operations so concurrent
+ * writers only contend on the reservation counters. The data is always contiguous
+ * in the element so a single slot describes the whole write.
+ *
+ * @returns true if the write was appended
+ * @returns false if the buffer is being flushed or does not have enough space or
+ *          slots left for the write
+ */
+static bool hioi_dataset_buffer_try_append (hio_buffer_t *buffer, hio_element_t element, off_t offset,
+                                            const void *ptr, size_t count, size_t size, size_t stride) {
+  size_t length = count * size;
+  unsigned long boffset, slot;
+  bool appended = false;
+  uint64_t start;
+
+  (void) atomic_fetch_add (&buffer->b_active, 1);
+
+  if (!atomic_load (&buffer->b_closed)) {
+    boffset = atomic_fetch_add (&buffer->b_reserved, length);
+    if (boffset + length <= buffer->b_size) {
+      slot = atomic_fetch_add (&buffer->b_nslots, 1);
+      if (slot < buffer->b_max_slots) {
+        void *data = (void *)((intptr_t) buffer->b_base + boffset);
+
+        start = hioi_gettime ();
+
+        for (size_t i = 0 ; i < count ; ++i) {
+          memcpy ((void *)((intptr_t) data + i * size), ptr, size);
+          ptr = (const void *) ((intptr_t) ptr + size + stride);
+        }
+
+        buffer->b_slots[slot] = (hio_internal_request_t) {.ir_element = element, .ir_offset = offset,
+                                                          .ir_data.w = data, .ir_count = 1, .ir_size = length,
+                                                          .ir_type = HIO_REQUEST_TYPE_WRITE};
+
+        (void) atomic_fetch_add (&buffer->b_time, hioi_gettime () - start);
+        appended = true;
+      }
+    }
+  }
+
+  (void) atomic_fetch_sub (&buffer->b_active, 1);
+
+  return appended;
+}
+
 int hioi_dataset_buffer_append (hio_dataset_t dataset, hio_element_t element, off_t offset, const void *ptr,
                                 size_t count, size_t size, size_t stride) {
   hio_buffer_t *buffer = &dataset->ds_buffer;
-  hio_internal_request_t *req;
   int rc = HIO_SUCCESS;
-  uint64_t start, stop;
 
-  hioi_object_lock (&dataset->ds_object);
+  if (0 == count * size) {
+    return HIO_SUCCESS;
+  }
+
+  for (bool appended = hioi_dataset_buffer_try_append (buffer, element, offset, ptr, count, size, stride) ;
+       !appended && HIO_SUCCESS == rc ; ) {
+    /* the dataset lock is not held here as flushing the buffer may require other
+     * threads to take the dataset lock */
+    pthread_mutex_lock (&buffer->b_lock);
 
-  if (buffer->b_reqcount) {
-    /* check if this request can be appended to the previous one */
-    req = (hio_internal_request_t *) buffer->b_reqlist.prev;
-    if (req->ir_element != element || (req->ir_offset + req->ir_size) != offset) {
-      /* create a new request */
-      req = NULL;
+    /* another thread may have flushed the buffer while this thread waited for the lock */
+    appended = hioi_dataset_buffer_try_append (buffer, element, offset, ptr, count, size, stride);
+    if (!appended) {
+      rc = hioi_dataset_buffer_flush (dataset);
     }
-  } else {
-    req = NULL;
+
+    pthread_mutex_unlock (&buffer->b_lock);
   }
 
-  for (size_t i = 0 ; i < count && HIO_SUCCESS == rc ; ++i) {
-    for (size_t block = size, to_write = 0 ; block ; block -= to_write) {
-      to_write = (buffer->b_remaining > block) ? block : buffer->b_remaining;
+  return rc;
+}
 
-      start = hioi_gettime ();
+/**
+ * Record a deferred write in the dataset buffer
+ *
+ * The user buffers are referenced by the request instead of being copied. The request
+ * and its iovec list are taken from the buffer arena. Deferred writes that continue the
+ * previous deferred write to the same element are added to its iovec list so they are
+ * gathered by a single request when the buffer is flushed. Writes with more blocks than
+ * the arena can hold are submitted immediately.
+ */
+static int hioi_dataset_buffer_defer (hio_dataset_t dataset, hio_element_t element, off_t offset, const void *ptr,
+                                      size_t count, size_t size, size_t stride) {
+  hio_buffer_t *buffer = &dataset->ds_buffer;
+  hio_internal_request_t *req;
+  unsigned long slot;
+  int rc;
 
-      if (NULL == req) {
-        /* allocate and fill in new request */
-        req = calloc (1, sizeof (*req));
-        if (NULL == req) {
-          rc = HIO_ERR_OUT_OF_RESOURCE;
-          break;
-        }
-        req->ir_element = element;
-        req->ir_offset = offset;
-        req->ir_data.w = (const void *)((intptr_t) buffer->b_base + buffer->b_size - buffer->b_remaining);
-        req->ir_count = 1;
-        req->ir_size = 0;
-        req->ir_stride = 0;
-        req->ir_type = HIO_REQUEST_TYPE_WRITE;
-        req->ir_urequest = NULL;
-        hioi_list_append (req, buffer->b_reqlist, ir_list);
-        ++buffer->b_reqcount;
-      }
+  if (0 == stride) {
+    size *= count;
+    count = 1;
+  }
 
-      memcpy ((void *)((intptr_t) req->ir_data.r + req->ir_size), ptr, to_write);
+  if (count > buffer->b_max_slots) {
+    hio_internal_request_t direct = {.ir_element = element, .ir_offset = offset, .ir_data.w = ptr,
+                                     .ir_count = count, .ir_size = size, .ir_stride = stride,
+                                     .ir_type = HIO_REQUEST_TYPE_WRITE};
 
-      req->ir_size += to_write;
-      buffer->b_remaining -= to_write;
-      ptr = (const void *) ((intptr_t) ptr + to_write);
-      offset += to_write;
+    /* the user buffers stay valid until the next flush which waits for this request */
+    return hioi_worker_submit (dataset, &direct, NULL);
+  }
 
-      stop = hioi_gettime ();
+  pthread_mutex_lock (&buffer->b_lock);
 
-      /* add buffering time to the overall write time */
-      dataset->ds_stat.s_wtime += stop - start;
+  while (buffer->b_niov + count > buffer->b_max_slots) {
+    rc = hioi_dataset_buffer_flush (dataset);
+    if (HIO_SUCCESS != rc) {
+      pthread_mutex_unlock (&buffer->b_lock);
+      return rc;
+    }
+  }
 
-      if (block - to_write) {
-        rc = hioi_dataset_buffer_flush (dataset);
-        if (HIO_SUCCESS != rc) {
-          break;
-        }
-        req = NULL;
+  /* the iovec list of the previous deferred write ends at the top of the iovec arena */
+  req = buffer->b_deferred;
+  if (NULL == req || req->ir_element != element || (req->ir_offset + req->ir_size) != offset) {
+    /* slots are shared with lock-free appends */
+    slot = atomic_fetch_add (&buffer->b_nslots, 1);
+    while (slot >= buffer->b_max_slots) {
+      rc = hioi_dataset_buffer_flush (dataset);
+      if (HIO_SUCCESS != rc) {
+        pthread_mutex_unlock (&buffer->b_lock);
+        return rc;
       }
+
+      slot = atomic_fetch_add (&buffer->b_nslots, 1);
     }
 
-    ptr = (const void *) ((intptr_t) ptr + stride);
+    req = buffer->b_deferred = buffer->b_slots + slot;
+    *req = (hio_internal_request_t) {.ir_element = element, .ir_offset = offset, .ir_data.w = ptr,
+                                     .ir_count = 1, .ir_type = HIO_REQUEST_TYPE_WRITE,
+                                     .ir_iov = buffer->b_iov + buffer->b_niov};
   }
 
-  hioi_object_unlock (&dataset->ds_object);
+  for (size_t i = 0 ; i < count ; ++i) {
+    req->ir_iov[req->ir_iovcnt].iov_base = (void *) ptr;
+    req->ir_iov[req->ir_iovcnt++].iov_len = size;
+    ptr = (const void *) ((intptr_t) ptr + size + stride);
+  }
 
-  return rc;
+  buffer->b_niov += count;
+  req->ir_size += count * size;
+
+  pthread_mutex_unlock (&buffer->b_lock);
+
+  return HIO_SUCCESS;
 }
 
 ssize_t hio_element_write (hio_element_t element, off_t offset, unsigned long reserved0, const void *ptr,
@@ -117,7 +194,7 @@ int hio_element_write_strided_nb (hio_element_t element, hio_request_t *request,
                                   unsigned long reserved0, const void *ptr, size_t count, size_t size,
                                   size_t stride) {
   hio_dataset_t dataset = hioi_element_dataset (element);
-  hio_internal_request_t req, *reqs[1] = {&req};
+  hio_internal_request_t req = {.ir_iov = NULL};
   int rc;
 
   if (NULL == element || offset < 0) {
@@ -159,15 +236,117 @@ int hio_element_write_strided_nb (hio_element_t element, hio_request_t *request,
   req.ir_size = size;
   req.ir_stride = stride;
   req.ir_type = HIO_REQUEST_TYPE_WRITE;
-  req.ir_urequest = request;
 
-  return dataset->ds_process_reqs (dataset, (hio_internal_request_t **) &reqs, 1);
+  return hioi_worker_submit (dataset, &req, request);
+}
+
+int hio_element_write_deferred (hio_element_t element, off_t offset, unsigned long reserved0, const void *ptr,
+                                size_t count, size_t size, size_t stride) {
+  hio_dataset_t dataset = hioi_element_dataset (element);
+
+  if (NULL == element || offset < 0) {
+    return HIO_ERR_BAD_PARAM;
+  }
+
+  if (!(dataset->ds_flags & HIO_FLAG_WRITE)) {
+    return HIO_ERR_PERM;
+  }
+
+  (void) atomic_fetch_add (&dataset->ds_stat.s_wcount, 1);
+
+  if (0 == count * size) {
+    return HIO_SUCCESS;
+  }
+
+  return hioi_dataset_buffer_defer (dataset, element, offset, ptr, count, size, stride);
+}
+
+ssize_t hio_element_write_list (hio_element_t element, int count, const off_t *offsets, const void * const *ptrs,
+                                const size_t *lengths) {
+  hio_dataset_t dataset = hioi_element_dataset (element);
+  hio_internal_request_t *items, **reqs;
+  int nreqs = 0, nmerged, rc;
+  struct iovec *iov;
+  ssize_t total = 0;
+
+  if (NULL == element || count < 0 || (count && (NULL == offsets || NULL == ptrs || NULL == lengths))) {
+    return HIO_ERR_BAD_PARAM;
+  }
+
+  if (!(dataset->ds_flags & HIO_FLAG_WRITE)) {
+    return HIO_ERR_PERM;
+  }
+
+  (void) atomic_fetch_add (&dataset->ds_stat.s_wcount, count);
+
+  items = calloc (count, sizeof (*items));
+  /* the second half of the array is sort scratch space */
+  reqs = malloc (2 * count * sizeof (*reqs));
+  iov = malloc (count * sizeof (*iov));
+  if (NULL == items || NULL == reqs || NULL == iov) {
+    free (items);
+    free (reqs);
+    free (iov);
+    return count ? HIO_ERR_OUT_OF_RESOURCE : 0;
+  }
+
+  for (int i = 0 ; i < count ; ++i) {
+    if (offsets[i] < 0) {
+      free (items);
+      free (reqs);
+      free (iov);
+      return HIO_ERR_BAD_PARAM;
+    }
+
+    if (0 == lengths[i]) {
+      continue;
+    }
+
+    items[nreqs].ir_element = element;
+    items[nreqs].ir_offset = offsets[i];
+    items[nreqs].ir_data.w = ptrs[i];
+    items[nreqs].ir_count = 1;
+    items[nreqs].ir_size = lengths[i];
+    items[nreqs].ir_type = HIO_REQUEST_TYPE_WRITE;
+    reqs[nreqs] = items + nreqs;
+    ++nreqs;
+  }
+
+  hioi_dataset_sort_requests (reqs, nreqs, reqs + count);
+
+  /* extents that are contiguous in the element become a single request that gathers
+   * the data from the user buffers */
+  nmerged = hioi_dataset_merge_writes (reqs, nreqs, iov);
+
+  if (dataset->ds_flush_reqs) {
+    rc = dataset->ds_flush_reqs (dataset, reqs, nmerged);
+  } else {
+    rc = dataset->ds_process_reqs (dataset, reqs, nmerged);
+  }
+
+  for (int i = 0 ; i < nmerged ; ++i) {
+    if (reqs[i]->ir_status > 0) {
+      total += reqs[i]->ir_status;
+    }
+  }
+
+  free (items);
+  free (reqs);
+  free (iov);
+
+  return (HIO_SUCCESS == rc) ? total : rc;
 }
 
 int hio_element_flush (hio_element_t element, hio_flush_mode_t mode) {
   hio_dataset_t dataset = hioi_element_dataset (element);
   int rc;
 
+  /* wait for outstanding non-blocking requests */
+  rc = hioi_worker_drain (dataset);
+  if (HIO_SUCCESS != rc) {
+    return rc;
+  }
+
   rc = hioi_dataset_buffer_flush (dataset);
   if (HIO_SUCCESS != rc) {
     return rc;
@@ -180,6 +359,12 @@ int hio_dataset_flush (hio_dataset_t dataset, hio_flush_mode_t mode) {
   hio_element_t element;
   int rc;
 
+  /* wait for outstanding non-blocking requests */
+  rc = hioi_worker_drain (dataset);
+  if (HIO_SUCCESS != rc) {
+    return rc;
+  }
+
   /* flush buffers to the backing store */
   rc = hioi_dataset_buffer_flush (dataset);
   if (HIO_SUCCESS != rc) {
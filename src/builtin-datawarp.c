@@ -211,7 +211,7 @@ static int builtin_datawarp_module_dataset_close (hio_dataset_t dataset) {
 
     if (DW_STAGE_AT_JOB_END == stage_mode) {
       builtin_datawarp_dataset_backend_data_t *ds_data;
-      int64_t last_stage_id;
+      int64_t last_stage_id, dependent_id;
 
       ds_data = (builtin_datawarp_dataset_backend_data_t *) hioi_dbd_lookup_backend_data (dataset->ds_data, "datawarp");
       if (NULL == ds_data) {
@@ -233,6 +233,18 @@ static int builtin_datawarp_module_dataset_close (hio_dataset_t dataset) {
 
       last_stage_id = ds_data->last_scheduled_stage_id;
 
+      /* incremental datasets refer to data stored by older datasets. a dataset that is still
+       * referenced must be staged out with the datasets that refer to it so leave its stage in place */
+      dependent_id = builtin_posix_dataset_dependent (&posix_module->base, hioi_object_identifier (dataset),
+                                                      last_stage_id);
+      if (-1 != dependent_id) {
+        hioi_log (context, HIO_VERBOSE_DEBUG_LOW, "builtin-datawarp/dataset_close: keeping end-of-job stage for "
+                  "datawarp dataset %s::%" PRId64 ". dataset %s::%" PRId64 " refers to its data",
+                  hioi_object_identifier (dataset), last_stage_id, hioi_object_identifier (dataset), dependent_id);
+        ds_data->last_scheduled_stage_id = dataset->ds_id;
+        return HIO_SUCCESS;
+      }
+
       rc = asprintf (&dataset_path, "%s/%s.hio/%s/%llu", posix_module->base.data_root, hioi_object_identifier (context),
                      hioi_object_identifier (dataset), last_stage_id);
       if (0 > rc) {
@@ -264,7 +276,12 @@ static int builtin_datawarp_module_dataset_close (hio_dataset_t dataset) {
       ds_data->last_scheduled_stage_id = dataset->ds_id;
 
       /* remove the last end-of-job dataset from the burst buffer */
-      (void) posix_module->base.dataset_unlink (&posix_module->base, hioi_object_identifier (dataset), last_stage_id);
+      rc = posix_module->base.dataset_unlink (&posix_module->base, hioi_object_identifier (dataset), last_stage_id);
+      if (HIO_SUCCESS != rc) {
+        hioi_err_push (rc, &dataset->ds_object, "builtin-datawarp/dataset_close: could not remove dataset "
+                       "%s::%" PRId64 " from the burst buffer", hioi_object_identifier (dataset), last_stage_id);
+        return rc;
+      }
 
       /* remove created directories on pfs */
       rc = asprintf (&pfs_path, "%s/%s.hio/%s/%llu", datawarp_module->pfs_path, hioi_object_identifier (context),
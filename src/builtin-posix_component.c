@@ -45,6 +45,16 @@ static hio_var_enum_t hioi_dataset_file_modes = {
   .values = hioi_dataset_file_mode_values,
 };
 
+static hio_var_enum_value_t hioi_dataset_codec_values[] = {
+  {.string_value = "none", .value = HIO_CODEC_NONE},
+  {.string_value = "zlib", .value = HIO_CODEC_ZLIB},
+};
+
+static hio_var_enum_t hioi_dataset_codecs = {
+  .count  = 2,
+  .values = hioi_dataset_codec_values,
+};
+
 /** static functions */
 static int builtin_posix_module_dataset_unlink (struct hio_module_t *module, const char *name, int64_t set_id);
 static int builtin_posix_module_dataset_close (hio_dataset_t dataset);
@@ -53,6 +63,7 @@ static int builtin_posix_module_element_close (hio_element_t element);
 static int builtin_posix_module_element_flush (hio_element_t element, hio_flush_mode_t mode);
 static int builtin_posix_module_element_complete (hio_element_t element);
 static int builtin_posix_module_process_reqs (hio_dataset_t dataset, hio_internal_request_t **reqs, int req_count);
+static int builtin_posix_module_flush_reqs (hio_dataset_t dataset, hio_internal_request_t **reqs, int req_count);
 
 
 static void builtin_posix_trace (builtin_posix_module_dataset_t *posix_dataset, const char *event,
@@ -351,6 +362,164 @@ static int builtin_posix_module_dataset_manifest_list (builtin_posix_module_data
 }
 #endif /* HIO_MPI_HAVE(3) */
 
+static unsigned long builtin_posix_file_hash (builtin_posix_module_dataset_t *posix_dataset, hio_element_t element,
+                                               int64_t dataset_id, int file_id) {
+  uint64_t hash = (uint64_t) file_id * 0x9e3779b97f4a7c15ul ^ (uint64_t) dataset_id * 0xc2b2ae3d27d4eb4ful ^
+    (uint64_t) (intptr_t) element;
+
+  hash ^= hash >> 29;
+
+  return (unsigned long) hash & posix_dataset->ds_file_bucket_mask;
+}
+
+/**
+ * Generate the name of a data file relative to the dataset's data directory
+ *
+ * See builtin_posix_file_cache_get() for a description of the file identifiers.
+ */
+static void builtin_posix_file_name (builtin_posix_module_dataset_t *posix_dataset, hio_element_t element,
+                                     int64_t dataset_id, int file_id, char name[HIO_POSIX_NAME_MAX]) {
+  if (element) {
+    /* strided mode block file */
+    snprintf (name, HIO_POSIX_NAME_MAX, "%s_block.%08lu", hioi_object_identifier (element), (unsigned long) file_id);
+  } else if ((uint64_t) dataset_id != posix_dataset->base.ds_id) {
+    /* data file of an older dataset. dataset directories are siblings */
+    snprintf (name, HIO_POSIX_NAME_MAX, "../../%" PRId64 "/data/data.%x", dataset_id, file_id);
+  } else {
+    snprintf (name, HIO_POSIX_NAME_MAX, "data.%x", file_id);
+  }
+}
+
+/**
+ * Close a file in the open file cache
+ *
+ * Files this process preallocated space in are recorded so the space past the end of
+ * the data can be released when the dataset is closed (see builtin_posix_prealloc_trim).
+ */
+static void builtin_posix_file_close (builtin_posix_module_dataset_t *posix_dataset, hio_file_t *file) {
+  if (file->f_prealloc_end) {
+    char name[HIO_POSIX_NAME_MAX];
+
+    if (posix_dataset->ds_prealloc_count == posix_dataset->ds_prealloc_max) {
+      int new_max = posix_dataset->ds_prealloc_max ? 2 * posix_dataset->ds_prealloc_max : 16;
+      void *tmp = realloc (posix_dataset->ds_prealloc_files, new_max * sizeof (posix_dataset->ds_prealloc_files[0]));
+
+      if (NULL != tmp) {
+        posix_dataset->ds_prealloc_files = tmp;
+        posix_dataset->ds_prealloc_max = new_max;
+      }
+    }
+
+    /* the space is not released if there is no memory to record the file */
+    if (posix_dataset->ds_prealloc_count < posix_dataset->ds_prealloc_max) {
+      builtin_posix_prealloc_file_t *pfile = posix_dataset->ds_prealloc_files + posix_dataset->ds_prealloc_count;
+
+      builtin_posix_file_name (posix_dataset, file->f_element, file->f_dsid, file->f_bid, name);
+      pfile->pf_name = strdup (name);
+      pfile->pf_end = file->f_prealloc_end;
+      if (NULL != pfile->pf_name) {
+        ++posix_dataset->ds_prealloc_count;
+      }
+    }
+  }
+
+  POSIX_TRACE_CALL(posix_dataset, hioi_file_close (file), "file_close", file->f_bid, 0);
+}
+
+static int builtin_posix_file_cache_init (builtin_posix_module_dataset_t *posix_dataset) {
+  unsigned long bucket_count = 1;
+
+  /* keep the load factor at or below 1/2 */
+  while (bucket_count < 2 * (unsigned long) posix_dataset->ds_max_open_files) {
+    bucket_count <<= 1;
+  }
+
+  posix_dataset->files = calloc (posix_dataset->ds_max_open_files, sizeof (posix_dataset->files[0]));
+  posix_dataset->ds_file_buckets = malloc (bucket_count * sizeof (posix_dataset->ds_file_buckets[0]));
+  if (NULL == posix_dataset->files || NULL == posix_dataset->ds_file_buckets) {
+    free (posix_dataset->files);
+    free (posix_dataset->ds_file_buckets);
+    posix_dataset->files = NULL;
+    posix_dataset->ds_file_buckets = NULL;
+    return HIO_ERR_OUT_OF_RESOURCE;
+  }
+
+  posix_dataset->ds_file_bucket_mask = bucket_count - 1;
+  for (unsigned long i = 0 ; i < bucket_count ; ++i) {
+    hioi_list_init (posix_dataset->ds_file_buckets[i]);
+  }
+
+  for (int i = 0 ; i < posix_dataset->ds_max_open_files ; ++i) {
+    hio_file_t *file = posix_dataset->files + i;
+
+    hioi_file_init (file);
+    hioi_list_append (file, posix_dataset->ds_file_lru, f_lru);
+    /* not in any bucket until a file is opened */
+    file->f_hash.next = file->f_hash.prev = NULL;
+  }
+
+  return HIO_SUCCESS;
+}
+
+static void builtin_posix_file_cache_fini (builtin_posix_module_dataset_t *posix_dataset) {
+  if (NULL == posix_dataset->files) {
+    return;
+  }
+
+  for (int i = 0 ; i < posix_dataset->ds_max_open_files ; ++i) {
+    hio_file_t *file = posix_dataset->files + i;
+
+    if (file->f_bid >= 0) {
+      builtin_posix_file_close (posix_dataset, file);
+    }
+
+    hioi_file_fini (file);
+  }
+
+  free (posix_dataset->files);
+  free (posix_dataset->ds_file_buckets);
+  posix_dataset->files = NULL;
+  posix_dataset->ds_file_buckets = NULL;
+  hioi_list_init (posix_dataset->ds_file_lru);
+  posix_dataset->ds_data_dirfd = -1;
+}
+
+/**
+ * Open the directory containing the dataset's data files
+ *
+ * Older versions of hio wrote data files to the top-level dataset directory. The
+ * layout is detected once here so data files can be opened without probing.
+ */
+static int builtin_posix_open_data_dir (builtin_posix_module_dataset_t *posix_dataset) {
+  hio_context_t context = hioi_object_context ((hio_object_t) posix_dataset);
+  char *path;
+  int rc;
+
+  rc = asprintf (&path, "%s/data", posix_dataset->base_path);
+  if (0 > rc) {
+    return HIO_ERR_OUT_OF_RESOURCE;
+  }
+
+  posix_dataset->ds_data_dirfd = open (path, O_RDONLY | O_DIRECTORY);
+  if (-1 == posix_dataset->ds_data_dirfd && ENOENT == errno && !(posix_dataset->base.ds_flags & HIO_FLAG_WRITE)) {
+    hioi_log (context, HIO_VERBOSE_DEBUG_LOW, "posix: no data directory found. using legacy layout for dataset %s",
+              posix_dataset->base_path);
+    posix_dataset->ds_data_dirfd = open (posix_dataset->base_path, O_RDONLY | O_DIRECTORY);
+  }
+
+  if (-1 == posix_dataset->ds_data_dirfd) {
+    rc = hioi_err_errno (errno);
+    hioi_err_push (rc, &posix_dataset->base.ds_object, "posix: error opening data directory %s. errno: %d",
+                   path, errno);
+    free (path);
+    return rc;
+  }
+
+  free (path);
+
+  return HIO_SUCCESS;
+}
+
 static int builtin_posix_module_dataset_init (struct hio_module_t *module,
                                               builtin_posix_module_dataset_t *posix_dataset) {
   hio_context_t context = hioi_object_context ((hio_object_t) posix_dataset);
@@ -362,11 +531,16 @@ static int builtin_posix_module_dataset_init (struct hio_module_t *module,
   assert (0 < rc);
 
   /* initialize posix dataset specific data */
-  for (int i = 0 ; i < HIO_POSIX_MAX_OPEN_FILES ; ++i) {
-    posix_dataset->files[i].f_bid = -1;
-    posix_dataset->files[i].f_hndl = NULL;
-    posix_dataset->files[i].f_fd = -1;
-  }
+  posix_dataset->files = NULL;
+  posix_dataset->ds_file_buckets = NULL;
+  hioi_list_init (posix_dataset->ds_file_lru);
+  posix_dataset->ds_data_dirfd = -1;
+  posix_dataset->ds_pack_threshold = 0;
+  posix_dataset->ds_codec = HIO_CODEC_NONE;
+  posix_dataset->ds_checksum = false;
+  posix_dataset->ds_incremental = false;
+  posix_dataset->ds_prev = NULL;
+  posix_dataset->ds_ref_used = NULL;
 
   /* default to strided output mode */
   posix_dataset->ds_fmode = HIO_FILE_MODE_STRIDED;
@@ -379,13 +553,100 @@ static int builtin_posix_module_dataset_init (struct hio_module_t *module,
     posix_dataset->ds_fmode = HIO_FILE_MODE_BASIC;
   }
 
+  posix_dataset->ds_direct_io = false;
+  hioi_config_add (context, &posix_dataset->base.ds_object, &posix_dataset->ds_direct_io,
+                   "dataset_direct_io", HIO_CONFIG_TYPE_BOOL, NULL,
+                   "Bypass the page cache when reading/writing dataset files (default: false)", 0);
+  posix_dataset->ds_flush_threads = 1;
+  if (posix_dataset->base.ds_flags & HIO_FLAG_WRITE) {
+    hioi_config_add (context, &posix_dataset->base.ds_object, &posix_dataset->ds_flush_threads,
+                     "dataset_flush_threads", HIO_CONFIG_TYPE_INT32, NULL, "Number of threads to use "
+                     "when flushing buffered writes (default: 1)", 0);
+    if (posix_dataset->ds_flush_threads < 1) {
+      posix_dataset->ds_flush_threads = 1;
+    }
+  }
+
+  posix_dataset->ds_preallocate = false;
+  posix_dataset->ds_prealloc_size = 0;
+  atomic_init (&posix_dataset->ds_prealloc_unsupported, false);
+  posix_dataset->ds_prealloc_files = NULL;
+  posix_dataset->ds_prealloc_count = 0;
+  posix_dataset->ds_prealloc_max = 0;
+  posix_dataset->ds_writeback_size = 0;
+  if (posix_dataset->base.ds_flags & HIO_FLAG_WRITE) {
+    posix_dataset->ds_preallocate = true;
+    hioi_config_add (context, &posix_dataset->base.ds_object, &posix_dataset->ds_preallocate,
+                     "dataset_preallocate", HIO_CONFIG_TYPE_BOOL, NULL, "Preallocate space in data files "
+                     "based on dataset_expected_size in optimized and strided file modes (default: true)", 0);
+
+    hioi_config_add (context, &posix_dataset->base.ds_object, &posix_dataset->ds_writeback_size,
+                     "dataset_writeback_size", HIO_CONFIG_TYPE_UINT64, NULL, "Start writing back data "
+                     "file pages each time this many bytes have been written to a file. 0 disables early "
+                     "writeback (default: 0)", 0);
+  }
+
+  posix_dataset->ds_mmap_read = false;
+  posix_dataset->ds_read_ahead = 0;
+  if (!(posix_dataset->base.ds_flags & HIO_FLAG_WRITE)) {
+    hioi_config_add (context, &posix_dataset->base.ds_object, &posix_dataset->ds_mmap_read,
+                     "dataset_mmap_read", HIO_CONFIG_TYPE_BOOL, NULL,
+                     "Map data files into memory when reading a dataset (default: false)", 0);
+
+    hioi_config_add (context, &posix_dataset->base.ds_object, &posix_dataset->ds_read_ahead,
+                     "dataset_read_ahead", HIO_CONFIG_TYPE_INT32, NULL, "Number of reads to prefetch "
+                     "when sequential or fixed-stride element reads are detected. 0 disables read-ahead "
+                     "(default: 0)", 0);
+  }
+
+#if BUILTIN_POSIX_HAVE_DIRECT_IO
+  if (posix_dataset->ds_direct_io) {
+    /* stage data in page-aligned buffers. this is sufficient for O_DIRECT on most filesystems */
+    posix_dataset->ds_direct_align = sysconf (_SC_PAGESIZE);
+    posix_dataset->base.ds_buffer_align = posix_dataset->ds_direct_align;
+  }
+#else
+  posix_dataset->ds_direct_io = false;
+#endif
+
+  posix_dataset->ds_bs_user = false;
   if (HIO_FILE_MODE_BASIC != posix_dataset->ds_fmode) {
-    posix_dataset->ds_bs = 1ul << 23;
+    /* 0 means not set. the default may be raised to the stripe size in optimized mode */
+    posix_dataset->ds_bs = 0;
     hioi_config_add (context, &posix_dataset->base.ds_object, &posix_dataset->ds_bs,
                      "dataset_block_size", HIO_CONFIG_TYPE_INT64, NULL,
-                     "Block size to use when writing in optimized mode (default: 8M)", 0);
+                     "Block size to use when writing in optimized mode (default: 8M or the stripe "
+                     "size if larger)", 0);
+    posix_dataset->ds_bs_user = 0 != posix_dataset->ds_bs;
+    if (!posix_dataset->ds_bs_user) {
+      posix_dataset->ds_bs = 1ul << 23;
+    }
   }
 
+  posix_dataset->ds_max_open_files = HIO_POSIX_MAX_OPEN_FILES;
+  hioi_config_add (context, &posix_dataset->base.ds_object, &posix_dataset->ds_max_open_files,
+                   "dataset_max_open_files", HIO_CONFIG_TYPE_INT32, NULL, "Maximum number of data files "
+                   "to keep open in optimized and strided file modes (default: 32)", 0);
+  if (posix_dataset->ds_max_open_files < 1) {
+    posix_dataset->ds_max_open_files = 1;
+  }
+
+  posix_dataset->ds_file_cache_hits = posix_dataset->ds_file_cache_misses = 0;
+  posix_dataset->ds_file_cache_evictions = 0;
+  posix_dataset->ds_file_syncs = 0;
+  hioi_perf_add (context, &posix_dataset->base.ds_object, &posix_dataset->ds_file_cache_hits,
+                 "file_cache_hits", HIO_CONFIG_TYPE_UINT64, NULL, "Number of data file lookups that found "
+                 "an open file", 0);
+  hioi_perf_add (context, &posix_dataset->base.ds_object, &posix_dataset->ds_file_cache_misses,
+                 "file_cache_misses", HIO_CONFIG_TYPE_UINT64, NULL, "Number of data file lookups that "
+                 "required opening a file", 0);
+  hioi_perf_add (context, &posix_dataset->base.ds_object, &posix_dataset->ds_file_cache_evictions,
+                 "file_cache_evictions", HIO_CONFIG_TYPE_UINT64, NULL, "Number of open data files closed "
+                 "to make room for another file", 0);
+  hioi_perf_add (context, &posix_dataset->base.ds_object, &posix_dataset->ds_file_syncs,
+                 "file_syncs", HIO_CONFIG_TYPE_UINT64, NULL, "Number of data file syncs issued when "
+                 "flushing elements", 0);
+
   return HIO_SUCCESS;
 }
 
@@ -401,8 +662,10 @@ static int builtin_posix_module_setup_striping (hio_context_t context, struct hi
     return rc;
   }
 
-  /* for now do not use stripe exclusivity in any path */
+  /* stripe exclusivity is only used in optimized mode (see below) */
   posix_dataset->my_stripe = 0;
+  posix_dataset->ds_stripe_count = 1;
+  posix_dataset->ds_stripe_exclusive = false;
 
   /* set default stripe count */
   fs_attr->fs_scount = 1;
@@ -470,9 +733,47 @@ static int builtin_posix_module_setup_striping (hio_context_t context, struct hi
     }
 
     if (HIO_FILE_MODE_OPTIMIZED == posix_dataset->ds_fmode && posix_dataset->ds_bs < fs_attr->fs_ssize) {
-      posix_dataset->ds_bs = fs_attr->fs_ssize;
+      if (posix_dataset->ds_bs_user) {
+        hioi_log (context, HIO_VERBOSE_WARN, "posix:dataset_open: requested block size %" PRIu64 " is smaller "
+                  "than the stripe size %" PRIu64, posix_dataset->ds_bs, fs_attr->fs_ssize);
+      } else {
+        posix_dataset->ds_bs = fs_attr->fs_ssize;
+      }
+    }
+  }
+
+#if HIO_MPI_HAVE(3)
+  if (HIO_FILE_MODE_OPTIMIZED == posix_dataset->ds_fmode) {
+    posix_dataset->ds_stripe_exclusive = true;
+    hioi_config_add (context, &dataset->ds_object, &posix_dataset->ds_stripe_exclusive,
+                     "dataset_stripe_exclusive", HIO_CONFIG_TYPE_BOOL, NULL, "Reserve blocks in optimized "
+                     "mode from a per-rank stripe lane of the shared file instead of a single node-wide "
+                     "counter (default: true)", 0);
+
+    if (posix_dataset->ds_stripe_exclusive && context->c_shared_size > 1) {
+      if (fs_attr->fs_flags & HIO_FS_SUPPORTS_STRIPING) {
+        /* one lane per stripe. with a block size equal to the stripe size every block in
+         * a lane lands on the same I/O server */
+        posix_dataset->ds_stripe_count = fs_attr->fs_scount;
+        if (!posix_dataset->ds_bs_user) {
+          posix_dataset->ds_bs = fs_attr->fs_ssize;
+        } else if (posix_dataset->ds_bs != fs_attr->fs_ssize) {
+          hioi_log (context, HIO_VERBOSE_WARN, "posix:dataset_open: block size %" PRIu64 " does not match the "
+                    "stripe size %" PRIu64 ". stripe lanes will span I/O servers", posix_dataset->ds_bs,
+                    fs_attr->fs_ssize);
+        }
+      } else {
+        /* no striping information available. give each rank on the node its own lane */
+        posix_dataset->ds_stripe_count = context->c_shared_size;
+      }
+
+      posix_dataset->my_stripe = context->c_shared_rank % posix_dataset->ds_stripe_count;
+
+      hioi_log (context, HIO_VERBOSE_DEBUG_LOW, "posix:dataset_open: using stripe lane %d of %d. block size: %"
+                PRIu64, posix_dataset->my_stripe, posix_dataset->ds_stripe_count, posix_dataset->ds_bs);
     }
   }
+#endif
 
   return HIO_SUCCESS;
 }
@@ -559,6 +860,240 @@ static int bultin_posix_scatter_data (builtin_posix_module_dataset_t *posix_data
 }
 #endif
 
+/**
+ * Set up packing of small reservations in optimized mode
+ */
+static void builtin_posix_pack_setup (builtin_posix_module_dataset_t *posix_dataset) {
+  hio_context_t context = hioi_object_context ((hio_object_t) posix_dataset);
+  hio_object_t object = &posix_dataset->base.ds_object;
+  uint64_t max_class_size = (uint64_t) HIO_SHARED_PACK_MIN << (HIO_SHARED_PACK_CLASSES - 1);
+
+  posix_dataset->ds_pack_threshold = 1ul << 16;
+  hioi_config_add (context, object, &posix_dataset->ds_pack_threshold, "dataset_pack_threshold",
+                   HIO_CONFIG_TYPE_UINT64, NULL, "Writes smaller than this many bytes are packed into "
+                   "blocks shared by all ranks on a node in optimized mode. 0 disables packing (default: 64k)", 0);
+
+  posix_dataset->ds_pack_align = HIO_SHARED_PACK_MIN;
+  hioi_config_add (context, object, &posix_dataset->ds_pack_align, "dataset_pack_alignment",
+                   HIO_CONFIG_TYPE_UINT64, NULL, "Alignment of packed writes in optimized mode (default: 4k)", 0);
+
+  posix_dataset->ds_pack_count = 0;
+  hioi_perf_add (context, object, &posix_dataset->ds_pack_count, "pack_count", HIO_CONFIG_TYPE_UINT64,
+                 NULL, "Number of writes packed into shared blocks", 0);
+
+  if (posix_dataset->ds_direct_io && posix_dataset->ds_pack_align < posix_dataset->ds_direct_align) {
+    posix_dataset->ds_pack_align = posix_dataset->ds_direct_align;
+  }
+
+  if (0 == posix_dataset->ds_pack_align || posix_dataset->ds_pack_align & (posix_dataset->ds_pack_align - 1)) {
+    hioi_log (context, HIO_VERBOSE_WARN, "posix:dataset_open: pack alignment %" PRIu64 " is not a power of two. "
+              "using %d", posix_dataset->ds_pack_align, HIO_SHARED_PACK_MIN);
+    posix_dataset->ds_pack_align = HIO_SHARED_PACK_MIN;
+  }
+
+  /* the largest packed reservation must fit in both the largest size class and half a block */
+  posix_dataset->ds_pack_threshold = min(posix_dataset->ds_pack_threshold, max_class_size);
+  posix_dataset->ds_pack_threshold = min(posix_dataset->ds_pack_threshold, posix_dataset->ds_bs / 2);
+}
+
+/**
+ * Set up compression of element data in optimized mode
+ *
+ * Element data is compressed in independent blocks of ds_cblock_size bytes so
+ * any block can be read back without decompressing its neighbors.
+ */
+static void builtin_posix_compress_setup (builtin_posix_module_dataset_t *posix_dataset) {
+  hio_context_t context = hioi_object_context ((hio_object_t) posix_dataset);
+  hio_object_t object = &posix_dataset->base.ds_object;
+
+  posix_dataset->ds_codec = HIO_CODEC_NONE;
+  hioi_config_add (context, object, &posix_dataset->ds_codec, "dataset_compression", HIO_CONFIG_TYPE_INT32,
+                   &hioi_dataset_codecs, "Codec used to compress element data in optimized mode. Valid values: "
+                   "(0: none, 1: zlib) (default: none)", 0);
+
+  posix_dataset->ds_cblock_size = 1ul << 20;
+  hioi_config_add (context, object, &posix_dataset->ds_cblock_size, "dataset_compression_block_size",
+                   HIO_CONFIG_TYPE_UINT64, NULL, "Size of the element blocks that are compressed independently. "
+                   "Smaller blocks make small reads cheaper at the cost of compression ratio (default: 1M)", 0);
+
+  posix_dataset->ds_compressed_bytes = 0;
+  hioi_perf_add (context, object, &posix_dataset->ds_compressed_bytes, "compressed_bytes", HIO_CONFIG_TYPE_UINT64,
+                 NULL, "Number of bytes stored by compressed writes", 0);
+
+  if (!hioi_codec_available (posix_dataset->ds_codec)) {
+    hioi_log (context, HIO_VERBOSE_WARN, "posix:dataset_open: compression codec %d is not available. element data "
+              "will not be compressed", (int) posix_dataset->ds_codec);
+    posix_dataset->ds_codec = HIO_CODEC_NONE;
+  }
+
+  /* a compressed block must fit in a single reservation */
+  posix_dataset->ds_cblock_size = min(posix_dataset->ds_cblock_size, posix_dataset->ds_bs);
+  if (0 == posix_dataset->ds_cblock_size) {
+    posix_dataset->ds_codec = HIO_CODEC_NONE;
+  }
+}
+
+/**
+ * Set up incremental writes in optimized mode
+ *
+ * Each block of ds_iblock_size bytes written is hashed. Blocks whose hash matches
+ * the same block of the previous instance of the dataset are not written. The
+ * segment instead refers to the data stored by the older dataset. Compressed
+ * datasets compare compression blocks.
+ */
+static void builtin_posix_incremental_setup (builtin_posix_module_dataset_t *posix_dataset) {
+  hio_context_t context = hioi_object_context ((hio_object_t) posix_dataset);
+  hio_object_t object = &posix_dataset->base.ds_object;
+
+  hioi_config_add (context, object, &posix_dataset->ds_incremental, "dataset_incremental", HIO_CONFIG_TYPE_BOOL,
+                   NULL, "Only write element blocks that changed since the last instance of this dataset written "
+                   "by this context in optimized mode. Unchanged blocks refer to the older dataset (default: false)", 0);
+
+  posix_dataset->ds_iblock_size = 1ul << 20;
+  hioi_config_add (context, object, &posix_dataset->ds_iblock_size, "dataset_incremental_block_size",
+                   HIO_CONFIG_TYPE_UINT64, NULL, "Size of the element blocks compared with the last instance of "
+                   "the dataset when writing incrementally. Ignored if compression is enabled (default: 1M)", 0);
+
+  posix_dataset->ds_unchanged_bytes = 0;
+  hioi_perf_add (context, object, &posix_dataset->ds_unchanged_bytes, "unchanged_bytes", HIO_CONFIG_TYPE_UINT64,
+                 NULL, "Number of element bytes not written because they did not change since the last instance "
+                 "of the dataset", 0);
+
+  if (HIO_CODEC_NONE != posix_dataset->ds_codec) {
+    /* compressed blocks are compared whole */
+    posix_dataset->ds_iblock_size = posix_dataset->ds_cblock_size;
+  }
+
+  posix_dataset->ds_iblock_size = min(posix_dataset->ds_iblock_size, posix_dataset->ds_bs);
+  if (0 == posix_dataset->ds_iblock_size) {
+    posix_dataset->ds_incremental = false;
+  }
+}
+
+/**
+ * Open the last instance of the dataset written by this context
+ *
+ * The previous instance provides the block hashes compared by incremental
+ * writes. Unchanged blocks refer directly to the dataset that stores the data
+ * so the datasets this dataset may depend on are the previous instance and the
+ * datasets it depends on. This is collective.
+ */
+static int builtin_posix_incremental_open (struct hio_module_t *module, builtin_posix_module_dataset_t *posix_dataset) {
+  hio_dataset_t dataset = &posix_dataset->base;
+  hio_context_t context = hioi_object_context (&dataset->ds_object);
+  int64_t prev_id = dataset->ds_data->dd_last_id;
+  hio_dataset_t prev;
+  int rc;
+
+  if (0 > prev_id || (uint64_t) prev_id == dataset->ds_id) {
+    hioi_log (context, HIO_VERBOSE_DEBUG_LOW, "posix:dataset_open: no previous instance of dataset %s. writing "
+              "all blocks", hioi_object_identifier (dataset));
+    return HIO_SUCCESS;
+  }
+
+  prev = hioi_dataset_alloc (context, hioi_object_identifier (dataset), prev_id, HIO_FLAG_READ, dataset->ds_mode);
+  if (NULL == prev) {
+    return HIO_ERR_OUT_OF_RESOURCE;
+  }
+
+  rc = hioi_dataset_open_internal (module, prev);
+  if (HIO_SUCCESS != rc) {
+    hioi_log (context, HIO_VERBOSE_WARN, "posix:dataset_open: could not open previous instance %s::%" PRId64
+              " for incremental write. writing all blocks", hioi_object_identifier (dataset), prev_id);
+    hioi_object_release (&prev->ds_object);
+    return HIO_SUCCESS;
+  }
+
+  free (dataset->ds_refs);
+  dataset->ds_refs = calloc (prev->ds_ref_count + 1, sizeof (dataset->ds_refs[0]));
+  posix_dataset->ds_ref_used = calloc (prev->ds_ref_count + 1, sizeof (posix_dataset->ds_ref_used[0]));
+  if (NULL == dataset->ds_refs || NULL == posix_dataset->ds_ref_used) {
+    (void) hioi_dataset_close_internal (prev);
+    hioi_object_release (&prev->ds_object);
+    return HIO_ERR_OUT_OF_RESOURCE;
+  }
+
+  dataset->ds_refs[0] = prev_id;
+  for (int i = 0 ; i < prev->ds_ref_count ; ++i) {
+    dataset->ds_refs[i + 1] = prev->ds_refs[i];
+  }
+  dataset->ds_ref_count = prev->ds_ref_count + 1;
+
+  posix_dataset->ds_prev = prev;
+
+  return HIO_SUCCESS;
+}
+
+/**
+ * Close the previous instance of the dataset and determine which datasets are
+ * referenced. Only referenced datasets are recorded in the manifest. This is
+ * collective.
+ */
+static void builtin_posix_incremental_close (builtin_posix_module_dataset_t *posix_dataset) {
+  hio_dataset_t dataset = &posix_dataset->base;
+  int ref_count = 0;
+
+  if (NULL == posix_dataset->ds_prev) {
+    return;
+  }
+
+  (void) hioi_dataset_close_internal (posix_dataset->ds_prev);
+  hioi_object_release (&posix_dataset->ds_prev->ds_object);
+  posix_dataset->ds_prev = NULL;
+
+#if HIO_MPI_HAVE(1)
+  if (hioi_context_using_mpi (hioi_object_context (&dataset->ds_object))) {
+    MPI_Allreduce (MPI_IN_PLACE, posix_dataset->ds_ref_used, dataset->ds_ref_count, MPI_C_BOOL, MPI_LOR,
+                   hioi_object_context (&dataset->ds_object)->c_comm);
+  }
+#endif
+
+  for (int i = 0 ; i < dataset->ds_ref_count ; ++i) {
+    if (posix_dataset->ds_ref_used[i]) {
+      dataset->ds_refs[ref_count++] = dataset->ds_refs[i];
+    }
+  }
+
+  dataset->ds_ref_count = ref_count;
+  free (posix_dataset->ds_ref_used);
+  posix_dataset->ds_ref_used = NULL;
+}
+
+/**
+ * Determine how much space to preallocate in each data file
+ *
+ * In optimized mode the expected size of the dataset (set by the user or averaged
+ * over previous instances of the dataset) is divided evenly across the files that
+ * will be written (one per node). In strided mode every element has its own set
+ * of ds_fcount files and the number of elements is not known when the dataset is
+ * opened so each block is allocated when it is first written instead.
+ */
+static void builtin_posix_prealloc_setup (builtin_posix_module_dataset_t *posix_dataset) {
+  hio_context_t context = hioi_object_context ((hio_object_t) posix_dataset);
+  uint64_t expected_size = posix_dataset->base.ds_expected_size;
+
+  switch (posix_dataset->ds_fmode) {
+  case HIO_FILE_MODE_OPTIMIZED:
+    posix_dataset->ds_prealloc_size = expected_size / (context->c_node_count ? context->c_node_count : 1);
+    break;
+  case HIO_FILE_MODE_STRIDED:
+    /* see builtin_posix_element_translate_strided () */
+    posix_dataset->ds_prealloc_size = 0;
+    return;
+  default:
+    /* basic mode files are written by a single rank in whatever order it chooses */
+    posix_dataset->ds_preallocate = false;
+    return;
+  }
+
+  if (posix_dataset->ds_bs && posix_dataset->ds_prealloc_size % posix_dataset->ds_bs) {
+    posix_dataset->ds_prealloc_size += posix_dataset->ds_bs - posix_dataset->ds_prealloc_size % posix_dataset->ds_bs;
+  }
+
+  hioi_log (context, HIO_VERBOSE_DEBUG_LOW, "posix:dataset_open: preallocating %" PRIu64 " bytes per data file "
+            "(expected dataset size: %" PRIu64 ")", posix_dataset->ds_prealloc_size, expected_size);
+}
+
 static int builtin_posix_module_dataset_open (struct hio_module_t *module, hio_dataset_t dataset) {
   builtin_posix_module_dataset_t *posix_dataset = (builtin_posix_module_dataset_t *) dataset;
   builtin_posix_module_t *posix_module = (builtin_posix_module_t *) module;
@@ -594,13 +1129,48 @@ static int builtin_posix_module_dataset_open (struct hio_module_t *module, hio_d
     hioi_config_add (context, &dataset->ds_object, &posix_dataset->ds_use_bzip,
                      "dataset_use_bzip", HIO_CONFIG_TYPE_BOOL, NULL,
                      "Use bzip2 compression for dataset manifests", 0);
+
+    if (dataset->ds_flags & HIO_FLAG_WRITE) {
+      builtin_posix_pack_setup (posix_dataset);
+      builtin_posix_compress_setup (posix_dataset);
+      builtin_posix_incremental_setup (posix_dataset);
+
+      hioi_config_add (context, &dataset->ds_object, &posix_dataset->ds_checksum, "dataset_checksum",
+                       HIO_CONFIG_TYPE_BOOL, NULL, "Store a crc32c checksum with each segment of element data "
+                       "written in optimized mode. Checksums are verified when the data is read (default: false)", 0);
+    }
+
+    posix_dataset->ds_checksum_errors = 0;
+    hioi_perf_add (context, &dataset->ds_object, &posix_dataset->ds_checksum_errors, "checksum_errors",
+                   HIO_CONFIG_TYPE_UINT64, NULL, "Number of segments read that failed checksum verification", 0);
+
+    posix_dataset->ds_unverified_segments = 0;
+    hioi_perf_add (context, &dataset->ds_object, &posix_dataset->ds_unverified_segments, "unverified_segments",
+                   HIO_CONFIG_TYPE_UINT64, NULL, "Number of checksummed segments whose checksum was dropped "
+                   "because it could not be recomputed after a partial overwrite", 0);
   }
 
   if (dataset->ds_flags & HIO_FLAG_TRUNC) {
     /* blow away the existing dataset */
     if (0 == context->c_rank) {
-      (void) builtin_posix_module_dataset_unlink (module, hioi_object_identifier(dataset),
-                                                  dataset->ds_id);
+      rc = builtin_posix_module_dataset_unlink (module, hioi_object_identifier(dataset),
+                                                dataset->ds_id);
+      /* an existing dataset can not be truncated if newer incremental datasets refer to its data. other
+       * errors (usually there is no existing dataset) are ignored */
+      if (HIO_ERR_PERM != rc) {
+        rc = HIO_SUCCESS;
+      }
+    }
+
+#if HIO_MPI_HAVE(1)
+    if (hioi_context_using_mpi (context)) {
+      MPI_Bcast (&rc, 1, MPI_INT, 0, context->c_comm);
+    }
+#endif
+
+    if (HIO_SUCCESS != rc) {
+      free (posix_dataset->base_path);
+      return rc;
     }
   }
 
@@ -666,7 +1236,8 @@ static int builtin_posix_module_dataset_open (struct hio_module_t *module, hio_d
   }
 
   /* if possible set up a shared memory window for this dataset */
-  POSIX_TRACE_CALL(posix_dataset, hioi_dataset_shared_init (dataset, 1), "shared_init", 0, 0);
+  POSIX_TRACE_CALL(posix_dataset, hioi_dataset_shared_init (dataset, posix_dataset->ds_stripe_count),
+                   "shared_init", 0, 0);
 
   if (HIO_FILE_MODE_OPTIMIZED == posix_dataset->ds_fmode) {
     if (2 > context->c_size || NULL == dataset->ds_shared_control) {
@@ -686,10 +1257,42 @@ static int builtin_posix_module_dataset_open (struct hio_module_t *module, hio_d
   /* NTH: if requested more code is needed to load an optimized dataset with an older MPI */
 #endif /* HIO_MPI_HAVE(3) */
 
+  if (posix_dataset->ds_direct_io && (dataset->ds_flags & HIO_FLAG_WRITE) && 1 < context->c_size &&
+      !(HIO_FILE_MODE_BASIC == posix_dataset->ds_fmode && HIO_SET_ELEMENT_UNIQUE == dataset->ds_mode)) {
+    /* unaligned direct writes read back and rewrite whole blocks. this can overwrite data written
+     * by another process to the same block so direct writes are limited to files with one writer */
+    hioi_log (context, HIO_VERBOSE_WARN, "posix:dataset_open: direct I/O is not supported when writing files "
+              "shared between processes. falling back on buffered I/O, path: %s", posix_dataset->base_path);
+    posix_dataset->ds_direct_io = false;
+  }
+
+  if (posix_dataset->ds_preallocate) {
+    builtin_posix_prealloc_setup (posix_dataset);
+  }
+
+  rc = builtin_posix_open_data_dir (posix_dataset);
+  if (HIO_SUCCESS == rc && HIO_FILE_MODE_BASIC != posix_dataset->ds_fmode) {
+    rc = builtin_posix_file_cache_init (posix_dataset);
+  }
+
+  if (HIO_SUCCESS == rc && HIO_FILE_MODE_OPTIMIZED == posix_dataset->ds_fmode && posix_dataset->ds_incremental) {
+    rc = builtin_posix_incremental_open (module, posix_dataset);
+  }
+
+  if (HIO_SUCCESS != rc) {
+    if (-1 != posix_dataset->ds_data_dirfd) {
+      close (posix_dataset->ds_data_dirfd);
+    }
+    builtin_posix_file_cache_fini (posix_dataset);
+    free (posix_dataset->base_path);
+    return rc;
+  }
+
   dataset->ds_module = module;
   dataset->ds_close = builtin_posix_module_dataset_close;
   dataset->ds_element_open = builtin_posix_module_element_open;
   dataset->ds_process_reqs = builtin_posix_module_process_reqs;
+  dataset->ds_flush_reqs = builtin_posix_module_flush_reqs;
 
   /* record the open time */
   gettimeofday (&dataset->ds_otime, NULL);
@@ -706,6 +1309,70 @@ static int builtin_posix_module_dataset_open (struct hio_module_t *module, hio_d
   return HIO_SUCCESS;
 }
 
+static int builtin_posix_prealloc_file_compare (const void *a, const void *b) {
+  return strcmp (((const builtin_posix_prealloc_file_t *) a)->pf_name,
+                 ((const builtin_posix_prealloc_file_t *) b)->pf_name);
+}
+
+/**
+ * Release preallocated space past the end of the data files
+ *
+ * Space is preallocated based on the expected size of the dataset so files may
+ * have space allocated past the end of the data actually written. Each process
+ * releases the space it preallocated in the files it wrote. This must only be
+ * called once all ranks have finished writing.
+ */
+static void builtin_posix_prealloc_trim (builtin_posix_module_dataset_t *posix_dataset) {
+  hio_context_t context = hioi_object_context ((hio_object_t) posix_dataset);
+  builtin_posix_prealloc_file_t *files = posix_dataset->ds_prealloc_files;
+  struct stat statinfo;
+  int dirfd = -1, fd;
+  char *path;
+
+  /* a file may have been recorded more than once if it was closed and reopened */
+  qsort (files, posix_dataset->ds_prealloc_count, sizeof (files[0]), builtin_posix_prealloc_file_compare);
+
+  if (0 < asprintf (&path, "%s/data", posix_dataset->base_path)) {
+    dirfd = open (path, O_RDONLY | O_DIRECTORY);
+    free (path);
+  }
+
+  for (int i = 0 ; i < posix_dataset->ds_prealloc_count && -1 != dirfd ; ++i) {
+    uint64_t end = files[i].pf_end;
+
+    while (i + 1 < posix_dataset->ds_prealloc_count && 0 == strcmp (files[i].pf_name, files[i + 1].pf_name)) {
+      end = max(end, files[i + 1].pf_end);
+      free (files[i++].pf_name);
+    }
+
+    fd = openat (dirfd, files[i].pf_name, O_WRONLY);
+    if (0 <= fd) {
+      /* truncating to the current size releases blocks allocated past the end of the file. some
+       * filesystems (ext4) ignore hole punches past the end of the file */
+      if (0 == fstat (fd, &statinfo) && end > (uint64_t) statinfo.st_size) {
+        if (0 != ftruncate (fd, statinfo.st_size)) {
+          hioi_log (context, HIO_VERBOSE_DEBUG_LOW, "posix: could not release preallocated space in data "
+                    "file %s. errno: %d", files[i].pf_name, errno);
+        }
+      }
+
+      close (fd);
+    }
+  }
+
+  if (-1 != dirfd) {
+    close (dirfd);
+  }
+
+  for (int i = 0 ; i < posix_dataset->ds_prealloc_count ; ++i) {
+    free (files[i].pf_name);
+  }
+
+  free (files);
+  posix_dataset->ds_prealloc_files = NULL;
+  posix_dataset->ds_prealloc_count = posix_dataset->ds_prealloc_max = 0;
+}
+
 static int builtin_posix_module_dataset_close (hio_dataset_t dataset) {
   builtin_posix_module_dataset_t *posix_dataset = (builtin_posix_module_dataset_t *) dataset;
   hio_context_t context = hioi_object_context ((hio_object_t) dataset);
@@ -717,12 +1384,13 @@ static int builtin_posix_module_dataset_close (hio_dataset_t dataset) {
 
   start = hioi_gettime ();
 
-  for (int i = 0 ; i < HIO_POSIX_MAX_OPEN_FILES ; ++i) {
-    if (posix_dataset->files[i].f_bid >= 0) {
-      POSIX_TRACE_CALL(posix_dataset, hioi_file_close (posix_dataset->files + i), "file_close",
-                       posix_dataset->files[i].f_bid, 0);
-    }
-  }
+  /* datasets referenced by this one are recorded in the manifest */
+  builtin_posix_incremental_close (posix_dataset);
+
+  /* builtin_posix_file_cache_fini () resets the directory descriptor */
+  close (posix_dataset->ds_data_dirfd);
+  builtin_posix_file_cache_fini (posix_dataset);
+  posix_dataset->ds_data_dirfd = -1;
 
 #if HIO_MPI_HAVE(3)
   /* release the shared state if it was allocated */
@@ -736,6 +1404,12 @@ static int builtin_posix_module_dataset_close (hio_dataset_t dataset) {
   if (dataset->ds_flags & HIO_FLAG_WRITE) {
     char *path;
 
+    /* fewer segments means smaller manifests and faster translation when the dataset is read */
+    POSIX_TRACE_CALL(posix_dataset, rc = hioi_dataset_compact_segments (dataset), "compact_segments", 0, 0);
+    if (HIO_SUCCESS != rc) {
+      dataset->ds_status = rc;
+    }
+
     /* write manifest header */
     POSIX_TRACE_CALL(posix_dataset, rc = hioi_dataset_gather_manifest (dataset, &manifest, &manifest_size, false, true),
                      "gather_manifest", 0, 0);
@@ -793,7 +1467,14 @@ static int builtin_posix_module_dataset_close (hio_dataset_t dataset) {
   }
 #endif
 
+  if (posix_dataset->ds_prealloc_count) {
+    POSIX_TRACE_CALL(posix_dataset, builtin_posix_prealloc_trim (posix_dataset), "prealloc_trim", 0, 0);
+  }
+
   free (posix_dataset->base_path);
+  free (dataset->ds_refs);
+  dataset->ds_refs = NULL;
+  dataset->ds_ref_count = 0;
 
   stop = hioi_gettime ();
 
@@ -815,9 +1496,69 @@ static int builtin_posix_unlink_cb (const char *path, const struct stat *sb, int
   return remove (path);
 }
 
-static int builtin_posix_module_dataset_unlink (struct hio_module_t *module, const char *name, int64_t set_id) {
+/**
+ * Find a dataset that refers to the data of another dataset
+ *
+ * Incremental datasets list the datasets holding data they reference in their
+ * manifest. Returns the identifier of the first dataset found that depends on
+ * set_id or -1 if there is none.
+ */
+int64_t builtin_posix_dataset_dependent (struct hio_module_t *module, const char *name, int64_t set_id) {
+  hio_context_t context = module->context;
+  int64_t dependent = -1, *refs;
+  int ref_count, rc;
+  struct dirent *dp;
+  char *path;
+  DIR *dir;
+
+  rc = asprintf (&path, "%s/%s.hio/%s", module->data_root, hioi_object_identifier(context), name);
+  if (0 > rc) {
+    return -1;
+  }
+
+  dir = opendir (path);
+  if (NULL == dir) {
+    free (path);
+    return -1;
+  }
+
+  while (-1 == dependent && NULL != (dp = readdir (dir))) {
+    char *manifest_path;
+
+    if ('.' == dp->d_name[0] || set_id == strtoll (dp->d_name, NULL, 10)) {
+      continue;
+    }
+
+    rc = asprintf (&manifest_path, "%s/%s/manifest.json", path, dp->d_name);
+    if (0 > rc) {
+      break;
+    }
+
+    if (0 == access (manifest_path, R_OK) &&
+        HIO_SUCCESS == hioi_manifest_read_references (context, manifest_path, &refs, &ref_count)) {
+      for (int i = 0 ; i < ref_count ; ++i) {
+        if (refs[i] == set_id) {
+          dependent = strtoll (dp->d_name, NULL, 10);
+          break;
+        }
+      }
+
+      free (refs);
+    }
+
+    free (manifest_path);
+  }
+
+  closedir (dir);
+  free (path);
+
+  return dependent;
+}
+
+static int builtin_posix_module_dataset_unlink (struct hio_module_t *module, const char *name, int64_t set_id) {
   struct stat statinfo;
   char *path = NULL;
+  int64_t dependent;
   int rc;
 
   if (module->context->c_rank) {
@@ -834,6 +1575,15 @@ static int builtin_posix_module_dataset_unlink (struct hio_module_t *module, con
     return hioi_err_errno (errno);
   }
 
+  /* data of this dataset may still be referenced by newer incremental datasets */
+  dependent = builtin_posix_dataset_dependent (module, name, set_id);
+  if (-1 != dependent) {
+    free (path);
+    hioi_err_push (HIO_ERR_PERM, &module->context->c_object, "posix: can not unlink dataset %s::%" PRId64
+                   ". dataset %s::%" PRId64 " refers to its data", name, set_id, name, dependent);
+    return HIO_ERR_PERM;
+  }
+
   hioi_log (module->context, HIO_VERBOSE_DEBUG_LOW, "posix: unlinking existing dataset %s::%" PRId64,
             name, set_id);
 
@@ -849,8 +1599,11 @@ static int builtin_posix_module_dataset_unlink (struct hio_module_t *module, con
   return HIO_SUCCESS;
 }
 
+/**
+ * Open a data file relative to the dataset's data directory
+ */
 static int builtin_posix_open_file (builtin_posix_module_t *posix_module, builtin_posix_module_dataset_t *posix_dataset,
-                                    char *path, hio_file_t *file) {
+                                    const char *name, hio_file_t *file) {
   hio_object_t hio_object = &posix_dataset->base.ds_object;
   int open_flags, fd;
 #if BUILTIN_POSIX_USE_STDIO
@@ -859,24 +1612,69 @@ static int builtin_posix_open_file (builtin_posix_module_t *posix_module, builti
 
   /* determine the fopen file mode to use */
   if (HIO_FLAG_WRITE & posix_dataset->base.ds_flags) {
-    open_flags = O_CREAT | O_WRONLY;
+    /* checksummed segments are read back to update their checksum after a partial overwrite */
+    open_flags = O_CREAT | (posix_dataset->ds_checksum ? O_RDWR : O_WRONLY);
   } else {
     open_flags = O_RDONLY;
   }
 
+#if BUILTIN_POSIX_HAVE_DIRECT_IO
+  if (posix_dataset->ds_direct_io && !posix_dataset->ds_mmap_read) {
+    /* unaligned direct writes need to read back partial blocks */
+    if (HIO_FLAG_WRITE & posix_dataset->base.ds_flags) {
+      open_flags = O_CREAT | O_RDWR;
+    }
+
+    fd = openat (posix_dataset->ds_data_dirfd, name, open_flags | O_DIRECT, posix_module->access_mode);
+    if (fd >= 0) {
+      struct stat statinfo;
+
+      file->f_align = posix_dataset->ds_direct_align;
+      file->f_size = 0;
+      file->f_extended = false;
+      if (0 == fstat (fd, &statinfo)) {
+        file->f_size = statinfo.st_size;
+      }
+
+      file->f_fd = fd;
+      return HIO_SUCCESS;
+    }
+
+    if (EINVAL != errno && ENOENT != errno) {
+      hioi_err_push (hioi_err_errno (errno), hio_object, "posix: error opening element file %s. "
+                     "errno: %d", name, errno);
+      return hioi_err_errno (errno);
+    }
+
+    if (EINVAL == errno) {
+      /* the filesystem does not support O_DIRECT. fall back on buffered I/O */
+      hioi_log (hioi_object_context (hio_object), HIO_VERBOSE_WARN, "posix: filesystem does not support "
+                "direct I/O for %s. falling back on buffered I/O", name);
+      posix_dataset->ds_direct_io = false;
+    }
+  }
+#endif
+
   /* it is not possible to get open with create without truncation using fopen so use a
    * combination of open and fdopen to get the desired effect */
-  //hioi_log (context, HIO_VERBOSE_DEBUG_HIGH, "posix: calling open; path: %s open_flags: %i", path, open_flags);
-  fd = open (path, open_flags, posix_module->access_mode);
+  fd = openat (posix_dataset->ds_data_dirfd, name, open_flags, posix_module->access_mode);
+  if (fd < 0 && ENOENT == errno && !(HIO_FLAG_WRITE & posix_dataset->base.ds_flags)) {
+    /* not necessarily an error. reads (and prefetches) past the end of an element may
+     * hit files that were never written */
+    hioi_log (hioi_object_context (hio_object), HIO_VERBOSE_DEBUG_LOW, "posix: element file %s does not exist",
+              name);
+    return HIO_ERR_NOT_FOUND;
+  }
+
   if (fd < 0) {
-    hioi_err_push (fd, hio_object, "posix: error opening element path %s. "
-                  "errno: %d", path, errno);
+    hioi_err_push (fd, hio_object, "posix: error opening element file %s. "
+                  "errno: %d", name, errno);
     return fd;
   }
 
 #if BUILTIN_POSIX_USE_STDIO
   if (HIO_FLAG_WRITE & posix_dataset->base.ds_flags) {
-    file_mode = "w";
+    file_mode = posix_dataset->ds_checksum ? "r+" : "w";
   } else {
     file_mode = "r";
   }
@@ -885,14 +1683,24 @@ static int builtin_posix_open_file (builtin_posix_module_t *posix_module, builti
   if (NULL == file->f_hndl) {
     int hrc = hioi_err_errno (errno);
     hioi_err_push (hrc, hio_object, "posix: error opening element file %s. "
-                   "errno: %d", path, errno);
+                   "errno: %d", name, errno);
+    close (fd);
     return hrc;
   }
 #else
   file->f_fd = fd;
 #endif
 
-  file->f_offset = 0;
+  file->f_wb_size = posix_dataset->ds_writeback_size;
+
+  if (posix_dataset->ds_mmap_read) {
+    int rc = hioi_file_map (file);
+    if (HIO_SUCCESS != rc) {
+      /* not fatal. fall back on reading the file */
+      hioi_log (hioi_object_context (hio_object), HIO_VERBOSE_DEBUG_LOW, "posix: could not map data file %s. rc: %d",
+                name, rc);
+    }
+  }
 
   return HIO_SUCCESS;
 }
@@ -900,37 +1708,17 @@ static int builtin_posix_open_file (builtin_posix_module_t *posix_module, builti
 static int builtin_posix_module_element_open_basic (builtin_posix_module_t *posix_module, builtin_posix_module_dataset_t *posix_dataset,
                                                     hio_element_t element) {
   const char *element_name = hioi_object_identifier(element);
-  char *path;
+  char name[HIO_POSIX_NAME_MAX];
   int rc;
 
   if (HIO_SET_ELEMENT_UNIQUE == posix_dataset->base.ds_mode) {
-    rc = asprintf (&path, "%s/data/element_data.%s.%08d", posix_dataset->base_path, element_name,
-                   element->e_rank);
+    snprintf (name, sizeof (name), "element_data.%s.%08d", element_name, element->e_rank);
   } else {
-    rc = asprintf (&path, "%s/data/element_data.%s", posix_dataset->base_path, element_name);
-  }
-
-  if (0 > rc) {
-    return HIO_ERR_OUT_OF_RESOURCE;
-  }
-
-  if (access (path, R_OK)) {
-    /* fall back on old naming scheme */
-    if (HIO_SET_ELEMENT_UNIQUE == posix_dataset->base.ds_mode) {
-      rc = asprintf (&path, "%s/element_data.%s.%08d", posix_dataset->base_path, element_name,
-                     element->e_rank);
-    } else {
-      rc = asprintf (&path, "%s/element_data.%s", posix_dataset->base_path, element_name);
-    }
-
-    if (0 > rc) {
-      return hioi_err_errno (errno);
-    }
+    snprintf (name, sizeof (name), "element_data.%s", element_name);
   }
 
-  POSIX_TRACE_CALL(posix_dataset, rc = builtin_posix_open_file (posix_module, posix_dataset, path, &element->e_file),
+  POSIX_TRACE_CALL(posix_dataset, rc = builtin_posix_open_file (posix_module, posix_dataset, name, &element->e_file),
                    "file_open", 0, 0);
-  free (path);
   if (HIO_SUCCESS != rc) {
     return rc;
   }
@@ -973,15 +1761,71 @@ static int builtin_posix_module_element_open (hio_dataset_t dataset, hio_element
 }
 
 static int builtin_posix_module_element_close (hio_element_t element) {
+  /* drop the cached decompressed segment */
+  hioi_object_lock (&element->e_object);
+  free (element->e_zbuf);
+  element->e_zbuf = NULL;
+  hioi_object_unlock (&element->e_object);
+
   return HIO_SUCCESS;
 }
 
-/* reserve space in the local shared file for this rank's data */
-static unsigned long builtin_posix_reserve (builtin_posix_module_dataset_t *posix_dataset, size_t *requested) {
-  /* NTH: this value should be changed to be non-0 if stripe exclusivity is re-enabled */
-  uint32_t stripe_count = 1;
+/* grab nblocks consecutive blocks from this rank's stripe lane in the local shared file */
+static unsigned long builtin_posix_reserve_blocks (builtin_posix_module_dataset_t *posix_dataset, int nblocks) {
+  uint32_t stripe_count = posix_dataset->ds_stripe_count;
   uint64_t block_size = posix_dataset->ds_bs;
   const int stripe = posix_dataset->my_stripe;
+
+  unsigned long s_index = atomic_fetch_add (&posix_dataset->base.ds_shared_control->s_stripes[stripe].s_index, nblocks);
+  return (s_index * stripe_count * block_size) + stripe * block_size;
+}
+
+/**
+ * Reserve space for a small write in a block shared by all ranks on the node
+ *
+ * Reservations are rounded up to the pack alignment and bump allocated from the
+ * current block of their size class. Keeping similarly sized reservations together
+ * limits the space lost at the end of each block to less than the class size.
+ */
+static unsigned long builtin_posix_reserve_packed (builtin_posix_module_dataset_t *posix_dataset, size_t size,
+                                                  size_t *grabbed) {
+  hio_shared_control_t *control = posix_dataset->base.ds_shared_control;
+  uint64_t align = posix_dataset->ds_pack_align;
+  unsigned long new_offset;
+  int pack_class = 0;
+
+  size = (size + align - 1) & ~(align - 1);
+
+  while (pack_class < HIO_SHARED_PACK_CLASSES - 1 && size > ((size_t) HIO_SHARED_PACK_MIN << pack_class)) {
+    ++pack_class;
+  }
+
+  *grabbed = 0;
+
+  pthread_mutex_lock (&control->s_pack[pack_class].p_mutex);
+  if (control->s_pack[pack_class].p_remaining < size) {
+    /* start a new shared block. the space left in the old block is lost */
+    control->s_pack[pack_class].p_offset = builtin_posix_reserve_blocks (posix_dataset, 1);
+    control->s_pack[pack_class].p_remaining = posix_dataset->ds_bs;
+    *grabbed = posix_dataset->ds_bs;
+  }
+
+  new_offset = control->s_pack[pack_class].p_offset;
+  control->s_pack[pack_class].p_offset += size;
+  control->s_pack[pack_class].p_remaining -= size;
+  pthread_mutex_unlock (&control->s_pack[pack_class].p_mutex);
+
+  ++posix_dataset->ds_pack_count;
+
+  return new_offset;
+}
+
+/* reserve space in the local shared file for this rank's data. if new blocks were
+ * grabbed from the shared file the number of bytes grabbed is returned in grabbed.
+ * grabbed space always starts at the returned offset */
+static unsigned long builtin_posix_reserve (builtin_posix_module_dataset_t *posix_dataset, size_t *requested,
+                                           size_t *grabbed) {
+  uint32_t stripe_count = posix_dataset->ds_stripe_count;
   unsigned long new_offset, to_use, space;
   int nstripes;
 
@@ -994,9 +1838,14 @@ static unsigned long builtin_posix_reserve (builtin_posix_module_dataset_t *posi
     posix_dataset->reserved_remaining -= to_use;
 
     *requested = to_use;
+    *grabbed = 0;
     return new_offset;
   }
 
+  if (*requested < posix_dataset->ds_pack_threshold) {
+    return builtin_posix_reserve_packed (posix_dataset, *requested, grabbed);
+  }
+
   space = *requested;
 
   if (space % posix_dataset->ds_bs) {
@@ -1010,23 +1859,195 @@ static unsigned long builtin_posix_reserve (builtin_posix_module_dataset_t *posi
     nstripes = space / posix_dataset->ds_bs;
   }
 
-  unsigned long s_index = atomic_fetch_add (&posix_dataset->base.ds_shared_control->s_stripes[stripe].s_index, nstripes);
-  new_offset = (s_index * stripe_count * block_size) + stripe * block_size;
+  new_offset = builtin_posix_reserve_blocks (posix_dataset, nstripes);
 
   posix_dataset->reserved_offset = new_offset + *requested;
   posix_dataset->reserved_remaining = space - *requested;
+  *grabbed = space;
 
   return new_offset;
 }
 
+/**
+ * Preallocate space in a data file open for writing
+ *
+ * The first time a file is touched the expected size of the file is allocated
+ * along with the requested region. Must be called with the dataset lock held.
+ * Failures are not fatal.
+ */
+static void builtin_posix_preallocate (builtin_posix_module_dataset_t *posix_dataset, hio_file_t *file,
+                                       uint64_t offset, uint64_t length) {
+  hio_context_t context = hioi_object_context ((hio_object_t) posix_dataset);
+  uint64_t end = offset + length;
+  int rc;
+
+  if (!posix_dataset->ds_preallocate) {
+    return;
+  }
+
+  if (file->f_prealloc < posix_dataset->ds_prealloc_size) {
+    offset = file->f_prealloc;
+    end = max(end, posix_dataset->ds_prealloc_size);
+  }
+
+  if (end <= offset) {
+    return;
+  }
+
+  POSIX_TRACE_CALL(posix_dataset, rc = hioi_file_preallocate (file, offset, end - offset),
+                   "file_preallocate", offset, end - offset);
+  if (HIO_ERR_NOT_AVAILABLE == rc) {
+    hioi_log (context, HIO_VERBOSE_DEBUG_LOW, "posix: filesystem does not support preallocation. disabling "
+              "preallocation for dataset %s", hioi_object_identifier (posix_dataset));
+    posix_dataset->ds_preallocate = false;
+  } else if (HIO_SUCCESS != rc) {
+    hioi_log (context, HIO_VERBOSE_WARN, "posix: could not preallocate %" PRIu64 " bytes at offset %"
+              PRIu64 " in data file %d. rc: %d", end - offset, offset, file->f_bid, rc);
+  }
+}
+
+/**
+ * Get an open data file from the open file cache
+ *
+ * Files are identified by the owning element (NULL if the file is shared by all
+ * elements), the dataset that wrote the file, and a file id. If the file is not
+ * open the least recently used entry is closed and reused. The file name is only
+ * generated on a miss. Must be called with the dataset lock held. On success the
+ * file is returned read-locked.
+ *
+ * @param[in]  posix_module  posix module
+ * @param[in]  posix_dataset posix dataset
+ * @param[in]  element       element the file belongs to
+ * @param[in]  dataset_id    dataset the file belongs to. files of older datasets hold
+ *                           data referenced by incremental datasets
+ * @param[in]  file_id       file identifier
+ * @param[out] file_out      open file
+ */
+static int builtin_posix_file_cache_get (builtin_posix_module_t *posix_module, builtin_posix_module_dataset_t *posix_dataset,
+                                         hio_element_t element, int64_t dataset_id, int file_id, hio_file_t **file_out) {
+  unsigned long bucket = builtin_posix_file_hash (posix_dataset, element, dataset_id, file_id);
+  char name[HIO_POSIX_NAME_MAX];
+  hio_file_t *file;
+  int rc;
+
+  hioi_list_foreach (file, posix_dataset->ds_file_buckets[bucket], hio_file_t, f_hash) {
+    if (file->f_bid == file_id && file->f_element == element && file->f_dsid == dataset_id) {
+      ++posix_dataset->ds_file_cache_hits;
+
+      /* move to the front of the lru list */
+      hioi_list_remove (file, f_lru);
+      hioi_list_prepend (file, posix_dataset->ds_file_lru, f_lru);
+
+      /* the caller holds the dataset lock so the entry can not be reused before the read lock is taken */
+      pthread_rwlock_rdlock (&file->f_lock);
+      *file_out = file;
+      return HIO_SUCCESS;
+    }
+  }
+
+  ++posix_dataset->ds_file_cache_misses;
+
+  /* reuse the least recently used entry */
+  file = hioi_list_item (posix_dataset->ds_file_lru.prev, hio_file_t, f_lru);
+
+  /* wait for any I/O in progress on this entry to finish */
+  pthread_rwlock_wrlock (&file->f_lock);
+  if (file->f_bid >= 0) {
+    ++posix_dataset->ds_file_cache_evictions;
+    builtin_posix_file_close (posix_dataset, file);
+  }
+
+  if (NULL != file->f_hash.next) {
+    hioi_list_remove (file, f_hash);
+  }
+
+  file->f_bid = -1;
+  file->f_element = element;
+  file->f_dsid = dataset_id;
+
+  builtin_posix_file_name (posix_dataset, element, dataset_id, file_id, name);
+
+  POSIX_TRACE_CALL(posix_dataset, rc = builtin_posix_open_file (posix_module, posix_dataset, name, file),
+                   "file_open", file_id, 0);
+  if (HIO_SUCCESS != rc) {
+    pthread_rwlock_unlock (&file->f_lock);
+    return rc;
+  }
+
+  file->f_bid = file_id;
+  hioi_list_prepend (file, posix_dataset->ds_file_buckets[bucket], f_hash);
+  if (posix_dataset->ds_prealloc_size) {
+    builtin_posix_preallocate (posix_dataset, file, 0, 0);
+  }
+  pthread_rwlock_unlock (&file->f_lock);
+
+  hioi_list_remove (file, f_lru);
+  hioi_list_prepend (file, posix_dataset->ds_file_lru, f_lru);
+
+  pthread_rwlock_rdlock (&file->f_lock);
+  *file_out = file;
+
+  return HIO_SUCCESS;
+}
+
+/**
+ * Claim a block of a strided data file for preallocation
+ *
+ * Returns true the first time a block is claimed after the file is opened. The caller
+ * then allocates the block without holding the dataset lock. Called with the dataset
+ * lock held.
+ */
+static bool builtin_posix_claim_block (hio_file_t *file, size_t block, uint64_t block_size) {
+  const size_t bits = 8 * sizeof (file->f_pblocks[0]);
+  unsigned long mask = 1ul << (block % bits);
+
+  if (block >= file->f_pblocks_count) {
+    size_t new_count = max(2 * file->f_pblocks_count, (block / bits + 1) * bits);
+    unsigned long *tmp = realloc (file->f_pblocks, new_count / 8);
+
+    if (NULL == tmp) {
+      return false;
+    }
+
+    memset (tmp + file->f_pblocks_count / bits, 0, (new_count - file->f_pblocks_count) / 8);
+    file->f_pblocks = tmp;
+    file->f_pblocks_count = new_count;
+  }
+
+  if (file->f_pblocks[block / bits] & mask) {
+    return false;
+  }
+
+  file->f_pblocks[block / bits] |= mask;
+  file->f_prealloc_end = max(file->f_prealloc_end, (block + 1) * block_size);
+
+  return true;
+}
+
+/* allocate a block claimed by builtin_posix_claim_block. called with the file read-locked */
+static void builtin_posix_allocate_block (builtin_posix_module_dataset_t *posix_dataset, hio_file_t *file,
+                                          uint64_t offset, uint64_t length) {
+  int rc;
+
+  POSIX_TRACE_CALL(posix_dataset, rc = hioi_file_allocate (file, offset, length), "file_preallocate", offset, length);
+  if (HIO_ERR_NOT_AVAILABLE == rc) {
+    if (!atomic_exchange (&posix_dataset->ds_prealloc_unsupported, true)) {
+      hioi_log (hioi_object_context ((hio_object_t) posix_dataset), HIO_VERBOSE_DEBUG_LOW, "posix: filesystem "
+                "does not support preallocation. disabling preallocation for dataset %s",
+                hioi_object_identifier (posix_dataset));
+    }
+  } else if (HIO_SUCCESS != rc) {
+    hioi_log (hioi_object_context ((hio_object_t) posix_dataset), HIO_VERBOSE_WARN, "posix: could not preallocate %"
+              PRIu64 " bytes at offset %" PRIu64 " in data file %d. rc: %d", length, offset, file->f_bid, rc);
+  }
+}
+
 static int builtin_posix_element_translate_strided (builtin_posix_module_t *posix_module, hio_element_t element,
-                                                    uint64_t offset, size_t *size, hio_file_t **file_out) {
+                                                    uint64_t offset, size_t *size, hio_file_t **file_out,
+                                                    uint64_t *file_offset, bool *allocate) {
   builtin_posix_module_dataset_t *posix_dataset = (builtin_posix_module_dataset_t *) hioi_element_dataset (element);
   size_t block_id, block_base, block_bound, block_offset, file_id, file_block;
   hio_context_t context = hioi_object_context (&element->e_object);
-  hio_file_t *file;
-  int32_t file_index;
-  char *path;
   int rc;
 
   block_id = offset / posix_dataset->ds_bs;
@@ -1046,62 +2067,54 @@ static int builtin_posix_element_translate_strided (builtin_posix_module_t *posi
     *size = block_bound - offset;
   }
 
-  rc = asprintf (&path, "%s/data/%s_block.%08lu", posix_dataset->base_path, hioi_object_identifier(element),
-                 (unsigned long) file_id);
-  if (0 > rc) {
-    return HIO_ERR_OUT_OF_RESOURCE;
-  }
-
-  /* use crc as a hash to pick a file index to use */
-  file_index = file_id % HIO_POSIX_MAX_OPEN_FILES;
-  file = posix_dataset->files + file_index;
-
-  if (file_id != file->f_bid || file->f_element != element) {
-    if (file->f_bid >= 0) {
-      POSIX_TRACE_CALL(posix_dataset, hioi_file_close (file), "file_close", file->f_bid, 0);
-    }
-    file->f_bid = -1;
-
-    file->f_element = element;
-
-    POSIX_TRACE_CALL(posix_dataset, rc = builtin_posix_open_file (posix_module, posix_dataset, path, file),
-                     "file_open", file_id, 0);
-    if (HIO_SUCCESS != rc) {
-      return rc;
-    }
-
-    file->f_bid = file_id;
+  rc = builtin_posix_file_cache_get (posix_module, posix_dataset, element, posix_dataset->base.ds_id, file_id,
+                                     file_out);
+  if (HIO_SUCCESS != rc) {
+    return rc;
   }
 
-  POSIX_TRACE_CALL(posix_dataset, hioi_file_seek (file, block_offset, SEEK_SET), "file_seek", file->f_bid, block_offset);
+  /* allocate the whole block in the file the first time it is touched. only datasets
+   * opened for writing preallocate */
+  *allocate = posix_dataset->ds_preallocate && !atomic_load (&posix_dataset->ds_prealloc_unsupported) &&
+    builtin_posix_claim_block (*file_out, file_block, posix_dataset->ds_bs);
 
-  *file_out = file;
+  *file_offset = block_offset;
 
   return HIO_SUCCESS;
 }
 
 static int builtin_posix_element_translate_opt (builtin_posix_module_t *posix_module, hio_element_t element,
                                                 uint64_t offset, size_t *size, hio_file_t **file_out,
-                                                bool reading) {
+                                                uint64_t *file_offset_out, bool reading,
+                                                hio_manifest_segment_t *segment) {
   builtin_posix_module_dataset_t *posix_dataset = (builtin_posix_module_dataset_t *) hioi_element_dataset (element);
   hio_context_t context = hioi_object_context (&element->e_object);
-  hio_file_t *file;
+  hio_manifest_segment_t found = {.seg_codec = HIO_CODEC_NONE};
   uint64_t file_offset;
+  size_t grabbed = 0;
   int file_index = 0;
-  char *path;
   int rc;
 
   hioi_log (context, HIO_VERBOSE_DEBUG_MED, "translating element %s offset %" PRIu64 " size %lu",
             hioi_object_identifier (&element->e_object), offset, *size);
-  POSIX_TRACE_CALL(posix_dataset, rc = hioi_element_translate_offset (element, offset, &file_index, &file_offset, size),
+  POSIX_TRACE_CALL(posix_dataset, rc = hioi_element_translate_offset (element, offset, &file_index, &file_offset, size,
+                                                                      &found),
                    "translate_offset", offset, *size);
 #if HIO_MPI_HAVE(3)
   if (HIO_SUCCESS != rc && reading) {
-    POSIX_TRACE_CALL(posix_dataset, rc = hioi_dataset_map_translate_offset (element, offset, &file_index, &file_offset, size),
+    POSIX_TRACE_CALL(posix_dataset, rc = hioi_dataset_map_translate_offset (element, offset, &file_index, &file_offset,
+                                                                            size, &found),
                      "map_translate_offset", offset, *size);
   }
 #endif
 
+  if (HIO_SUCCESS == rc && !reading && (HIO_CODEC_NONE != found.seg_codec || found.seg_is_ref)) {
+    /* referenced data belongs to an older dataset */
+    hioi_err_push (HIO_ERR_NOT_AVAILABLE, &element->e_object, "posix: can not overwrite %s element data "
+                   "at offset %" PRIu64, found.seg_is_ref ? "referenced" : "compressed", offset);
+    return HIO_ERR_NOT_AVAILABLE;
+  }
+
   if (HIO_SUCCESS != rc) {
     if (reading) {
       hioi_log (context, HIO_VERBOSE_DEBUG_MED, "offset %" PRIu64 " not found", offset);
@@ -1109,7 +2122,13 @@ static int builtin_posix_element_translate_opt (builtin_posix_module_t *posix_mo
       return rc;
     }
 
-    file_offset = builtin_posix_reserve (posix_dataset, size);
+    /* only fill the hole. data after the next segment is written in place by a later translation */
+    uint64_t next_offset = hioi_element_next_segment_offset (element, offset);
+    if (next_offset - offset < *size) {
+      *size = next_offset - offset;
+    }
+
+    file_offset = builtin_posix_reserve (posix_dataset, size, &grabbed);
 
     if (hioi_context_using_mpi (context)) {
       file_index = posix_dataset->base.ds_shared_control->s_master;
@@ -1117,163 +2136,715 @@ static int builtin_posix_element_translate_opt (builtin_posix_module_t *posix_mo
       file_index = 0;
     }
 
-    rc = asprintf (&path, "%s/data/data.%x", posix_dataset->base_path, file_index);
-    if (0 > rc) {
-      return HIO_ERR_OUT_OF_RESOURCE;
+    if (posix_dataset->ds_checksum) {
+      /* the checksum is set once all the data has been written. until then the segment is not verified */
+      hio_manifest_segment_t new_segment = {.seg_offset = offset, .seg_length = *size, .seg_foffset = file_offset,
+                                            .seg_file_index = file_index, .seg_codec = HIO_CODEC_NONE,
+                                            .seg_crc_pending = true};
+      hioi_element_insert_segment (element, &new_segment);
+    } else {
+      hioi_element_add_segment (element, file_index, file_offset, offset, *size);
     }
-
-    hioi_element_add_segment (element, file_index, file_offset, offset, *size);
   } else {
     hioi_log (context, HIO_VERBOSE_DEBUG_MED, "offset found in file @ rank %d, offset %" PRIu64
               ", size %lu", file_index, file_offset, *size);
-    rc = asprintf (&path, "%s/data/data.%x", posix_dataset->base_path, file_index);
-    if (0 > rc) {
-      return HIO_ERR_OUT_OF_RESOURCE;
-    }
-
-    if (access (path, R_OK)) {
-      free (path);
-      rc = asprintf (&path, "%s/data.%x", posix_dataset->base_path, file_index);
-      if (0 > rc) {
-        return HIO_ERR_OUT_OF_RESOURCE;
-      }
-    }
   }
 
-  /* use crc as a hash to pick a file index to use */
-  int internal_index = file_index % HIO_POSIX_MAX_OPEN_FILES;
-  file = posix_dataset->files + internal_index;
-
-  if (file_index != file->f_bid) {
-    if (file->f_bid >= 0) {
-      POSIX_TRACE_CALL(posix_dataset, hioi_file_close (file), "file_close", file->f_bid, 0);
-    }
-
-    file->f_bid = -1;
-
-    POSIX_TRACE_CALL(posix_dataset, rc = builtin_posix_open_file (posix_module, posix_dataset, path, file),
-                     "file_open", file_index, 0);
-    if (HIO_SUCCESS != rc) {
-      free (path);
-      return rc;
-    }
-
-    file->f_bid = file_index;
+  rc = builtin_posix_file_cache_get (posix_module, posix_dataset, NULL,
+                                     found.seg_is_ref ? found.seg_ref_id : (int64_t) posix_dataset->base.ds_id,
+                                     file_index, file_out);
+  if (HIO_SUCCESS != rc) {
+    return rc;
   }
 
-  free (path);
-
-  POSIX_TRACE_CALL(posix_dataset, hioi_file_seek (file, file_offset, SEEK_SET), "file_seek", file->f_bid, file_offset);
+  if (grabbed) {
+    /* allocate the new blocks before they are written */
+    builtin_posix_preallocate (posix_dataset, *file_out, file_offset, grabbed);
+  }
 
-  *file_out = file;
+  *file_offset_out = file_offset;
+  if (segment) {
+    *segment = found;
+  }
 
   return HIO_SUCCESS;
 }
 
+/**
+ * Find the backing file and file offset for an element offset
+ *
+ * On success the backing file is returned read-locked. The caller must
+ * release the file lock once the transfer is complete. If segment is not
+ * NULL the segment containing offset is returned in it. Compressed segments
+ * (optimized mode only) must be read whole from segment->seg_foffset.
+ * Referenced segments are read from the files of dataset segment->seg_ref_id.
+ */
 static int builtin_posix_element_translate (builtin_posix_module_t *posix_module, hio_element_t element,
-                                            uint64_t offset, size_t *size, hio_file_t **file_out, bool reading) {
+                                            uint64_t offset, size_t *size, hio_file_t **file_out,
+                                            uint64_t *file_offset, bool reading, hio_manifest_segment_t *segment) {
   builtin_posix_module_dataset_t *posix_dataset = (builtin_posix_module_dataset_t *) hioi_element_dataset (element);
+  bool allocate = false;
   int rc = HIO_SUCCESS;
 
-  switch (posix_dataset->ds_fmode) {
-  case HIO_FILE_MODE_BASIC:
+  if (segment) {
+    segment->seg_codec = HIO_CODEC_NONE;
+    segment->seg_has_crc = false;
+    segment->seg_is_ref = false;
+  }
+
+  if (HIO_FILE_MODE_BASIC == posix_dataset->ds_fmode) {
+    /* the element file is open for the lifetime of the element */
     *file_out = &element->e_file;
-    hioi_file_seek (&element->e_file, offset, SEEK_SET);
-    break;
+    *file_offset = offset;
+    pthread_rwlock_rdlock (&element->e_file.f_lock);
+    return HIO_SUCCESS;
+  }
+
+  /* the dataset lock protects the open file table and the space reservation */
+  hioi_object_lock (&posix_dataset->base.ds_object);
+  switch (posix_dataset->ds_fmode) {
   case HIO_FILE_MODE_STRIDED:
-    rc = builtin_posix_element_translate_strided (posix_module, element, offset, size, file_out);
+    rc = builtin_posix_element_translate_strided (posix_module, element, offset, size, file_out, file_offset,
+                                                  &allocate);
     break;
   case HIO_FILE_MODE_OPTIMIZED:
-    rc = builtin_posix_element_translate_opt (posix_module, element, offset, size, file_out, reading);
+    rc = builtin_posix_element_translate_opt (posix_module, element, offset, size, file_out, file_offset, reading,
+                                              segment);
     break;
+  default:
+    rc = HIO_ERROR;
+  }
+  hioi_object_unlock (&posix_dataset->base.ds_object);
+
+  if (allocate) {
+    /* the read lock on the file keeps it open. other threads can translate while the block is allocated */
+    builtin_posix_allocate_block (posix_dataset, *file_out, *file_offset - *file_offset % posix_dataset->ds_bs,
+                                  posix_dataset->ds_bs);
   }
 
   return rc;
 }
 
-static ssize_t builtin_posix_module_element_write_strided_internal (builtin_posix_module_t *posix_module, hio_element_t element,
-                                                                    uint64_t offset, const void *ptr, size_t count, size_t size,
-                                                                    size_t stride) {
-  builtin_posix_module_dataset_t *posix_dataset = (builtin_posix_module_dataset_t *) hioi_element_dataset (element);
-  hio_dataset_t dataset = hioi_element_dataset (element);
-  size_t bytes_written = 0, ret;
-  hio_file_t *file;
-  uint64_t stop, start;
-  int rc;
-
-  assert (dataset->ds_flags & HIO_FLAG_WRITE);
-
-  if (!(count * size)) {
-    return 0;
-  }
+/**
+ * Describe the next length bytes of a strided user buffer with an iovec array
+ *
+ * @param[in,out] ptr      start of the current block (updated)
+ * @param[in,out] boffset  offset in the current block (updated)
+ * @param[in]     size     size of each block
+ * @param[in]     stride   number of bytes between blocks
+ * @param[in]     length   number of bytes to describe
+ * @param[out]    iov      iovec array (at least BUILTIN_POSIX_IOV_MAX entries)
+ *
+ * @returns the number of entries used in iov
+ */
+static int builtin_posix_fill_iov (const void **ptr, size_t *boffset, size_t size, size_t stride,
+                                   size_t length, struct iovec *iov) {
+  int iovcnt = 0;
 
-  if (0 == stride) {
-    size *= count;
-    count = 1;
-  }
+  while (length) {
+    size_t chunk = size - *boffset;
 
-  start = hioi_gettime ();
+    if (chunk > length) {
+      chunk = length;
+    }
 
-  errno = 0;
+    iov[iovcnt].iov_base = (void *) ((intptr_t) *ptr + *boffset);
+    iov[iovcnt].iov_len = chunk;
+    ++iovcnt;
 
-  for (size_t i = 0 ; i < count ; ++i) {
-    size_t req = size, actual;
+    length -= chunk;
+    *boffset += chunk;
+    if (*boffset == size) {
+      *ptr = (const void *) ((intptr_t) *ptr + size + stride);
+      *boffset = 0;
+    }
+  }
 
-    do {
-      actual = req;
+  return iovcnt;
+}
 
-      POSIX_TRACE_CALL(posix_dataset, rc = builtin_posix_element_translate (posix_module, element, offset, &actual,
-                                                                            &file, false),
-                       "element_translate", offset, req);
-      if (HIO_SUCCESS != rc) {
-        break;
-      }
+/**
+ * Largest transfer that can be described by a single iovec array starting
+ * at offset boffset of the current block
+ */
+static inline size_t builtin_posix_iov_limit (size_t remaining, size_t boffset, size_t size) {
+  size_t limit = (size - boffset) + (BUILTIN_POSIX_IOV_MAX - 1) * size;
 
-      hioi_log (hioi_object_context (&element->e_object), HIO_VERBOSE_DEBUG_HIGH,
-                "posix: writing %lu bytes to file offset %" PRIu64, actual, file->f_offset);
+  return (remaining < limit) ? remaining : limit;
+}
 
-      POSIX_TRACE_CALL(posix_dataset, ret = hioi_file_write (file, ptr, actual), "file_write", offset, actual);
-      if (ret > 0) {
-        bytes_written += ret;
-      }
+/* crc32c of the data described by an iovec array */
+static uint32_t builtin_posix_iov_crc (const struct iovec *iov, int iovcnt) {
+  uint32_t crc = 0;
 
-      if (ret < actual) {
-        /* short write */
-        break;
-      }
+  for (int i = 0 ; i < iovcnt ; ++i) {
+    crc = hioi_crc32c (crc, iov[i].iov_base, iov[i].iov_len);
+  }
 
-      req -= actual;
-      offset += actual;
-      ptr = (void *) ((intptr_t) ptr + actual);
-    } while (req);
+  return crc;
+}
 
-    if (HIO_SUCCESS != rc || req) {
-      break;
+/**
+ * Copy the next length bytes of a strided user buffer to (gather) or from (scatter)
+ * a contiguous buffer. The user buffer position is updated as in builtin_posix_fill_iov.
+ */
+static void builtin_posix_copy_strided (const void **ptr, size_t *boffset, size_t size, size_t stride,
+                                        size_t length, void *buffer, bool gather) {
+  while (length) {
+    size_t chunk = min(size - *boffset, length);
+    void *user = (void *) ((intptr_t) *ptr + *boffset);
+
+    if (gather) {
+      memcpy (buffer, user, chunk);
+    } else {
+      memcpy (user, buffer, chunk);
     }
 
-    ptr = (void *) ((intptr_t) ptr + stride);
+    buffer = (void *) ((intptr_t) buffer + chunk);
+    length -= chunk;
+    *boffset += chunk;
+    if (*boffset == size) {
+      *ptr = (const void *) ((intptr_t) *ptr + size + stride);
+      *boffset = 0;
+    }
+  }
+}
+
+/**
+ * Describe the next length bytes of the user buffer list of a deferred write with an
+ * iovec array
+ *
+ * @param[in,out] uiov     current user buffer (updated)
+ * @param[in,out] boffset  offset in the current user buffer (updated)
+ * @param[in]     length   number of bytes to describe (see builtin_posix_iov_list_limit)
+ * @param[out]    iov      iovec array (at least BUILTIN_POSIX_IOV_MAX entries)
+ *
+ * @returns the number of entries used in iov
+ */
+static int builtin_posix_fill_iov_list (const struct iovec **uiov, size_t *boffset, size_t length,
+                                        struct iovec *iov) {
+  int iovcnt = 0;
+
+  while (length) {
+    size_t chunk = min((*uiov)->iov_len - *boffset, length);
+
+    if (chunk) {
+      iov[iovcnt].iov_base = (void *) ((intptr_t) (*uiov)->iov_base + *boffset);
+      iov[iovcnt].iov_len = chunk;
+      ++iovcnt;
+    }
+
+    length -= chunk;
+    *boffset += chunk;
+    if (*boffset == (*uiov)->iov_len) {
+      ++*uiov;
+      *boffset = 0;
+    }
+  }
+
+  return iovcnt;
+}
+
+/* skip the next length bytes of a user buffer list */
+static void builtin_posix_iov_list_advance (const struct iovec **uiov, size_t *boffset, size_t length) {
+  while (length) {
+    size_t chunk = min((*uiov)->iov_len - *boffset, length);
+
+    length -= chunk;
+    *boffset += chunk;
+    if (*boffset == (*uiov)->iov_len) {
+      ++*uiov;
+      *boffset = 0;
+    }
+  }
+}
+
+/**
+ * Largest transfer that can be described by a single iovec array starting at offset
+ * boffset of the current buffer in a user buffer list
+ */
+static size_t builtin_posix_iov_list_limit (const struct iovec *uiov, size_t boffset, size_t remaining) {
+  size_t limit = 0;
+
+  for (int i = 0 ; i < BUILTIN_POSIX_IOV_MAX && limit < remaining ; ++i, ++uiov, boffset = 0) {
+    limit += uiov->iov_len - boffset;
+  }
+
+  return (remaining < limit) ? remaining : limit;
+}
+
+/**
+ * Copy the next length bytes of a user buffer list to a contiguous buffer. The position
+ * in the list is updated as in builtin_posix_fill_iov_list.
+ */
+static void builtin_posix_copy_list (const struct iovec **uiov, size_t *boffset, size_t length, void *buffer) {
+  while (length) {
+    size_t chunk = min((*uiov)->iov_len - *boffset, length);
+
+    memcpy (buffer, (void *) ((intptr_t) (*uiov)->iov_base + *boffset), chunk);
+
+    buffer = (void *) ((intptr_t) buffer + chunk);
+    length -= chunk;
+    *boffset += chunk;
+    if (*boffset == (*uiov)->iov_len) {
+      ++*uiov;
+      *boffset = 0;
+    }
+  }
+}
+
+/**
+ * Size of the element blocks written by builtin_posix_element_write_blocks (0 if
+ * element data is not written in blocks)
+ */
+static inline uint64_t builtin_posix_write_block_size (builtin_posix_module_dataset_t *posix_dataset) {
+  if (HIO_FILE_MODE_OPTIMIZED != posix_dataset->ds_fmode) {
+    return 0;
+  }
+
+  if (posix_dataset->ds_incremental) {
+    return posix_dataset->ds_iblock_size;
+  }
+
+  return (HIO_CODEC_NONE != posix_dataset->ds_codec) ? posix_dataset->ds_cblock_size : 0;
+}
+
+/* find the element in the previous instance of the dataset that corresponds to element */
+static hio_element_t builtin_posix_prev_element (builtin_posix_module_dataset_t *posix_dataset, hio_element_t element) {
+  hio_element_t prev_element;
+
+  if (NULL == posix_dataset->ds_prev) {
+    return NULL;
+  }
+
+  hioi_list_foreach (prev_element, posix_dataset->ds_prev->ds_elist, struct hio_element, e_list) {
+    if (prev_element->e_rank == element->e_rank &&
+        0 == strcmp (hioi_object_identifier (prev_element), hioi_object_identifier (element))) {
+      return prev_element;
+    }
+  }
+
+  return NULL;
+}
+
+/* index of a dataset in the list of datasets this dataset may refer to (-1 if not found) */
+static int builtin_posix_ref_index (builtin_posix_module_dataset_t *posix_dataset, int64_t dataset_id) {
+  for (int i = 0 ; i < posix_dataset->base.ds_ref_count ; ++i) {
+    if (posix_dataset->base.ds_refs[i] == dataset_id) {
+      return i;
+    }
+  }
+
+  return -1;
+}
+
+/**
+ * Check if a block is unchanged since the previous instance of the dataset
+ *
+ * The block is unchanged if the previous instance stored exactly the same element
+ * range as one segment with the same hash. On success segment is filled in with a
+ * segment referring to the dataset that stores the data. References always point
+ * at the dataset that stores the data so they never need to be followed.
+ */
+static bool builtin_posix_block_unchanged (builtin_posix_module_dataset_t *posix_dataset, hio_element_t prev_element,
+                                           uint64_t offset, size_t length, uint64_t hash,
+                                           hio_manifest_segment_t *segment) {
+  uint64_t file_offset;
+  size_t found = length;
+  int file_index;
+
+  if (NULL == prev_element ||
+      HIO_SUCCESS != hioi_element_translate_offset (prev_element, offset, &file_index, &file_offset, &found, segment)) {
+    return false;
+  }
+
+  if (segment->seg_offset != offset || segment->seg_length != length || !segment->seg_has_hash ||
+      segment->seg_hash != hash) {
+    return false;
+  }
+
+  if (!segment->seg_is_ref) {
+    segment->seg_is_ref = true;
+    segment->seg_ref_id = (int64_t) posix_dataset->ds_prev->ds_id;
+  }
+
+  /* only datasets listed in the manifest may be referenced */
+  return -1 != builtin_posix_ref_index (posix_dataset, segment->seg_ref_id);
+}
+
+/**
+ * Write element data in independent blocks (optimized mode)
+ *
+ * Used when element data is compressed or written incrementally. The data is split
+ * at builtin_posix_write_block_size() boundaries in the element and each block is
+ * stored as its own segment. Compressed blocks that do not shrink are stored
+ * uncompressed. When writing incrementally, blocks that did not change since the
+ * previous instance of the dataset are not written. Their segments refer to the
+ * older dataset instead. These segments can not be updated in place so writes to
+ * offsets that already hold data are rejected. This runs on the thread processing
+ * the request so compression and hashing overlap with I/O issued by other threads.
+ *
+ * @param[in,out] offset         element offset (updated to the end of the data written)
+ * @param[in]     uiov           user buffer list containing ptr (deferred writes) or NULL
+ * @param[out]    bytes_written  number of element bytes written
+ */
+static int builtin_posix_element_write_blocks (builtin_posix_module_t *posix_module, hio_element_t element,
+                                               uint64_t *offset, const void *ptr, size_t size, size_t stride,
+                                               const struct iovec *uiov, size_t length, size_t *bytes_written) {
+  builtin_posix_module_dataset_t *posix_dataset = (builtin_posix_module_dataset_t *) hioi_element_dataset (element);
+  hio_context_t context = hioi_object_context (&element->e_object);
+  uint64_t block_size = builtin_posix_write_block_size (posix_dataset);
+  hio_codec_t codec = posix_dataset->ds_codec;
+  size_t cbound = 0, boffset = 0;
+  hio_element_t prev_element = NULL;
+  void *staging, *cbuf = NULL;
+  int rc = HIO_SUCCESS;
+
+  if (HIO_CODEC_NONE != codec) {
+    cbound = hioi_compress_bound (codec, block_size);
+    cbuf = malloc (cbound);
+  }
+
+  staging = malloc (block_size);
+  if (NULL == staging || (cbound && NULL == cbuf)) {
+    free (staging);
+    free (cbuf);
+    return HIO_ERR_OUT_OF_RESOURCE;
+  }
+
+  if (posix_dataset->ds_incremental) {
+    prev_element = builtin_posix_prev_element (posix_dataset, element);
+  }
+
+  if (uiov) {
+    boffset = (intptr_t) ptr - (intptr_t) uiov->iov_base;
+  }
+
+  *bytes_written = 0;
+
+  while (length) {
+    size_t chunk = min(length, block_size - *offset % block_size), clength = chunk;
+    hio_manifest_segment_t new_segment = {.seg_offset = *offset, .seg_length = chunk, .seg_codec = HIO_CODEC_NONE};
+    size_t requested, grabbed = 0, existing = chunk;
+    hio_manifest_segment_t prev_segment;
+    bool unchanged = false;
+    uint64_t file_offset;
+    const void *data = staging;
+    hio_file_t *file;
+    int file_index;
+    ssize_t ret;
+
+    if (uiov) {
+      builtin_posix_copy_list (&uiov, &boffset, chunk, staging);
+    } else {
+      builtin_posix_copy_strided (&ptr, &boffset, size, stride, chunk, staging, true);
+    }
+
+    if (posix_dataset->ds_incremental) {
+      new_segment.seg_has_hash = true;
+      POSIX_TRACE_CALL(posix_dataset, new_segment.seg_hash = hioi_hash64 (staging, chunk), "hash", *offset, chunk);
+      unchanged = builtin_posix_block_unchanged (posix_dataset, prev_element, *offset, chunk, new_segment.seg_hash,
+                                                 &prev_segment);
+      if (unchanged) {
+        new_segment = prev_segment;
+      }
+    }
+
+    if (!unchanged && HIO_CODEC_NONE != codec) {
+      clength = cbound;
+      POSIX_TRACE_CALL(posix_dataset, rc = hioi_compress (codec, staging, chunk, cbuf, &clength),
+                       "compress", *offset, chunk);
+      if (HIO_SUCCESS == rc && clength < chunk) {
+        new_segment.seg_codec = codec;
+        new_segment.seg_clength = clength;
+        data = cbuf;
+      } else {
+        /* not compressible. store the block as is */
+        clength = chunk;
+      }
+    }
+
+    if (!unchanged && posix_dataset->ds_checksum) {
+      new_segment.seg_has_crc = true;
+      new_segment.seg_crc = hioi_crc32c (0, data, clength);
+    }
+
+    hioi_object_lock (&posix_dataset->base.ds_object);
+    rc = hioi_element_translate_offset (element, *offset, &file_index, &file_offset, &existing, NULL);
+    if (HIO_SUCCESS == rc || hioi_element_next_segment_offset (element, *offset) < *offset + chunk) {
+      /* the block starts in or runs into existing data */
+      hioi_object_unlock (&posix_dataset->base.ds_object);
+      hioi_err_push (HIO_ERR_NOT_AVAILABLE, &element->e_object, "posix: can not overwrite element data at offset %"
+                     PRIu64 " when compression or incremental writes are enabled", *offset);
+      rc = HIO_ERR_NOT_AVAILABLE;
+      break;
+    }
+
+    if (unchanged) {
+      /* nothing to write */
+      rc = hioi_element_insert_segment (element, &new_segment);
+      if (HIO_SUCCESS == rc) {
+        posix_dataset->ds_ref_used[builtin_posix_ref_index (posix_dataset, new_segment.seg_ref_id)] = true;
+        posix_dataset->ds_unchanged_bytes += chunk;
+      }
+      hioi_object_unlock (&posix_dataset->base.ds_object);
+
+      if (HIO_SUCCESS != rc) {
+        break;
+      }
+
+      *bytes_written += chunk;
+      *offset += chunk;
+      length -= chunk;
+      continue;
+    }
+
+    requested = clength;
+    if (posix_dataset->ds_direct_io) {
+      /* keep unrelated segments out of the same direct I/O block */
+      requested = (requested + posix_dataset->ds_direct_align - 1) & ~(posix_dataset->ds_direct_align - 1);
+    }
+
+    if (posix_dataset->reserved_remaining < requested) {
+      /* each segment must be contiguous in the file. the rest of the current reservation is lost */
+      posix_dataset->reserved_remaining = 0;
+    }
+
+    file_offset = builtin_posix_reserve (posix_dataset, &requested, &grabbed);
+    file_index = hioi_context_using_mpi (context) ? posix_dataset->base.ds_shared_control->s_master : 0;
+
+    new_segment.seg_foffset = file_offset;
+    new_segment.seg_file_index = file_index;
+    rc = hioi_element_insert_segment (element, &new_segment);
+    if (HIO_SUCCESS == rc) {
+      rc = builtin_posix_file_cache_get (posix_module, posix_dataset, NULL, posix_dataset->base.ds_id, file_index,
+                                         &file);
+    }
+
+    if (HIO_SUCCESS == rc) {
+      if (grabbed) {
+        builtin_posix_preallocate (posix_dataset, file, file_offset, grabbed);
+      }
+
+      if (HIO_CODEC_NONE != codec) {
+        posix_dataset->ds_compressed_bytes += clength;
+      }
+    }
+    hioi_object_unlock (&posix_dataset->base.ds_object);
+
+    if (HIO_SUCCESS != rc) {
+      break;
+    }
+
+    POSIX_TRACE_CALL(posix_dataset, ret = hioi_file_pwrite (file, data, clength, file_offset), "file_write",
+                     *offset, clength);
+    pthread_rwlock_unlock (&file->f_lock);
+    if (ret < (ssize_t) clength) {
+      /* a partially written segment is not usable */
+      rc = (ret < 0) ? hioi_err_errno (errno) : HIO_ERR_TRUNCATE;
+      break;
+    }
+
+    *bytes_written += chunk;
+    *offset += chunk;
+    length -= chunk;
+  }
+
+  free (staging);
+  free (cbuf);
+
+  return rc;
+}
+
+/* record a segment whose checksum could not be recomputed after a partial overwrite */
+static void builtin_posix_crc_dropped (builtin_posix_module_dataset_t *posix_dataset, hio_element_t element,
+                                       const hio_manifest_segment_t *segment, int rc) {
+  hioi_object_lock (&posix_dataset->base.ds_object);
+  ++posix_dataset->ds_unverified_segments;
+  hioi_object_unlock (&posix_dataset->base.ds_object);
+
+  hioi_log (hioi_object_context (&element->e_object), HIO_VERBOSE_WARN, "posix: could not recompute the checksum "
+            "of element %s data at offset %" PRIu64 ", length %" PRIu64 " (rc = %d). the data will not be verified",
+            hioi_object_identifier (&element->e_object), segment->seg_offset, segment->seg_length, rc);
+
+  /* a zero length range never matches the segment so its checksum is dropped */
+  hioi_element_set_segment_crc (element, segment->seg_offset, 0, 0);
+}
+
+/**
+ * Recompute the checksum of a segment after part of it was overwritten
+ *
+ * The whole segment is read back from its file. Called without any locks held.
+ */
+static int builtin_posix_element_update_crc (builtin_posix_module_t *posix_module, hio_element_t element,
+                                             const hio_manifest_segment_t *segment) {
+  size_t length = segment->seg_length;
+  hio_manifest_segment_t current;
+  uint64_t file_offset;
+  hio_file_t *file;
+  void *data;
+  ssize_t ret;
+  int rc;
+
+  data = malloc (segment->seg_length);
+  if (NULL == data) {
+    return HIO_ERR_OUT_OF_RESOURCE;
+  }
+
+  /* the last checksum stored must cover all the partial overwrites of the segment */
+  pthread_mutex_lock (&element->e_crc_lock);
+  rc = builtin_posix_element_translate (posix_module, element, segment->seg_offset, &length, &file, &file_offset,
+                                        true, &current);
+  if (HIO_SUCCESS == rc) {
+    if (current.seg_offset == segment->seg_offset && current.seg_length == segment->seg_length &&
+        current.seg_foffset == segment->seg_foffset && current.seg_file_index == segment->seg_file_index) {
+      ret = hioi_file_pread (file, data, segment->seg_length, segment->seg_foffset);
+      if (ret < (ssize_t) segment->seg_length) {
+        rc = (ret < 0) ? hioi_err_errno (errno) : HIO_ERR_TRUNCATE;
+      }
+    } else {
+      rc = HIO_ERR_NOT_FOUND;
+    }
+    pthread_rwlock_unlock (&file->f_lock);
+  }
+
+  if (HIO_SUCCESS == rc) {
+    hioi_element_set_segment_crc (element, segment->seg_offset, segment->seg_length,
+                                  hioi_crc32c (0, data, segment->seg_length));
+  }
+  pthread_mutex_unlock (&element->e_crc_lock);
+
+  free (data);
+
+  return rc;
+}
+
+/**
+ * Write element data from a strided user buffer or, for deferred writes, from a list of
+ * user buffers (uiov). In the latter case the data is contiguous in the list starting at
+ * ptr which points into the first entry.
+ */
+static ssize_t builtin_posix_module_element_write_strided_internal (builtin_posix_module_t *posix_module, hio_element_t element,
+                                                                    uint64_t offset, const void *ptr, size_t count, size_t size,
+                                                                    size_t stride, const struct iovec *uiov) {
+  builtin_posix_module_dataset_t *posix_dataset = (builtin_posix_module_dataset_t *) hioi_element_dataset (element);
+  hio_dataset_t dataset = hioi_element_dataset (element);
+  struct iovec iov[BUILTIN_POSIX_IOV_MAX];
+  size_t bytes_written = 0, remaining, boffset = 0;
+  uint64_t stop, start, file_offset;
+  bool checksum = HIO_FILE_MODE_OPTIMIZED == posix_dataset->ds_fmode && posix_dataset->ds_checksum, partial;
+  hio_manifest_segment_t segment;
+  uint32_t crc = 0;
+  hio_file_t *file;
+  ssize_t ret;
+  int rc = HIO_SUCCESS, iovcnt;
+
+  assert (dataset->ds_flags & HIO_FLAG_WRITE);
+
+  if (!(count * size)) {
+    return 0;
+  }
+
+  if (0 == stride) {
+    size *= count;
+    count = 1;
+  }
+
+  start = hioi_gettime ();
+
+  errno = 0;
+
+  if (builtin_posix_write_block_size (posix_dataset)) {
+    rc = builtin_posix_element_write_blocks (posix_module, element, &offset, ptr, size, stride, uiov, count * size,
+                                             &bytes_written);
+    remaining = 0;
+  } else {
+    remaining = count * size;
+    if (uiov) {
+      boffset = (intptr_t) ptr - (intptr_t) uiov->iov_base;
+    }
+  }
+
+  /* consecutive blocks are contiguous in the element so each translation can cover
+   * multiple blocks. the blocks covered are written with a single vectored write. */
+  while (remaining) {
+    size_t req = uiov ? builtin_posix_iov_list_limit (uiov, boffset, remaining) :
+      builtin_posix_iov_limit (remaining, boffset, size), actual = req;
+
+    POSIX_TRACE_CALL(posix_dataset, rc = builtin_posix_element_translate (posix_module, element, offset, &actual,
+                                                                          &file, &file_offset, false, &segment),
+                     "element_translate", offset, req);
+    if (HIO_SUCCESS != rc) {
+      break;
+    }
+
+    /* part of an existing checksummed segment is overwritten */
+    partial = segment.seg_has_crc && (offset != segment.seg_offset || actual != segment.seg_length);
+
+    if (uiov) {
+      iovcnt = builtin_posix_fill_iov_list (&uiov, &boffset, actual, iov);
+    } else {
+      iovcnt = builtin_posix_fill_iov (&ptr, &boffset, size, stride, actual, iov);
+    }
+
+    hioi_log (hioi_object_context (&element->e_object), HIO_VERBOSE_DEBUG_HIGH,
+              "posix: writing %lu bytes in %d vectors to file offset %" PRIu64, actual, iovcnt, file_offset);
+
+    if (checksum && !partial) {
+      crc = builtin_posix_iov_crc (iov, iovcnt);
+    }
+
+    POSIX_TRACE_CALL(posix_dataset, ret = hioi_file_pwritev (file, iov, iovcnt, file_offset), "file_write", offset, actual);
+    pthread_rwlock_unlock (&file->f_lock);
+    if (ret > 0) {
+      bytes_written += ret;
+    }
+
+    if (ret < (ssize_t) actual) {
+      /* short write */
+      break;
+    }
+
+    if (partial) {
+      rc = builtin_posix_element_update_crc (posix_module, element, &segment);
+      if (HIO_SUCCESS != rc) {
+        /* the data was written. only the checksum is lost */
+        builtin_posix_crc_dropped (posix_dataset, element, &segment, rc);
+        rc = HIO_SUCCESS;
+      }
+    } else if (checksum) {
+      hioi_element_set_segment_crc (element, offset, actual, crc);
+    }
+
+    remaining -= actual;
+    offset += actual;
   }
 
   if (0 == bytes_written || HIO_SUCCESS != rc) {
-    if (0 == bytes_written) {
+    if (0 == bytes_written && HIO_SUCCESS == rc) {
       rc = hioi_err_errno (errno);
     }
 
+    hioi_object_lock (&dataset->ds_object);
     dataset->ds_status = rc;
+    hioi_object_unlock (&dataset->ds_object);
     return rc;
   }
 
-  if (offset + bytes_written > element->e_size) {
-    element->e_size = offset + bytes_written;
-  }
-
   stop = hioi_gettime ();
 
+  hioi_object_lock (&dataset->ds_object);
+  /* offset is now the end of the last complete transfer */
+  if (offset > element->e_size) {
+    element->e_size = offset;
+  }
+
   dataset->ds_stat.s_wtime += stop - start;
 
   if (0 < bytes_written) {
     dataset->ds_stat.s_bwritten += bytes_written;
   }
+  hioi_object_unlock (&dataset->ds_object);
 
   hioi_log (hioi_object_context (&element->e_object), HIO_VERBOSE_DEBUG_LOW,
             "posix: finished write. bytes written: %lu, time: %" PRIu64 " usec",
@@ -1282,57 +2853,274 @@ static ssize_t builtin_posix_module_element_write_strided_internal (builtin_posi
   return bytes_written;
 }
 
+/**
+ * Start reading element data that is expected to be read soon
+ *
+ * Handles HIO_REQUEST_TYPE_PREFETCH requests. Errors are ignored as the data
+ * may not exist.
+ */
+static void builtin_posix_element_prefetch (builtin_posix_module_t *posix_module, hio_element_t element, uint64_t offset,
+                                            size_t count, size_t size, size_t gap) {
+  builtin_posix_module_dataset_t *posix_dataset = (builtin_posix_module_dataset_t *) hioi_element_dataset (element);
+  hio_manifest_segment_t segment;
+  uint64_t file_offset;
+  hio_file_t *file;
+  int rc;
+
+  for (size_t i = 0 ; i < count ; ++i, offset += gap) {
+    for (size_t remaining = size ; remaining ; ) {
+      size_t actual = remaining;
+
+      POSIX_TRACE_CALL(posix_dataset, rc = builtin_posix_element_translate (posix_module, element, offset, &actual,
+                                                                            &file, &file_offset, true, &segment),
+                       "element_translate", offset, remaining);
+      if (HIO_SUCCESS != rc) {
+        return;
+      }
+
+      if (HIO_CODEC_NONE != segment.seg_codec) {
+        /* the whole segment will be read */
+        hioi_file_prefetch (file, segment.seg_foffset, segment.seg_clength);
+      } else {
+        hioi_file_prefetch (file, file_offset, actual);
+      }
+      pthread_rwlock_unlock (&file->f_lock);
+
+      remaining -= actual;
+      offset += actual;
+    }
+  }
+}
+
+/**
+ * Detect sequential or fixed-stride reads of an element and fill in a prefetch
+ * request for the next reads in the pattern. prefetch->ir_count is 0 if there is
+ * nothing to prefetch. Must be called with the dataset lock held.
+ */
+static void builtin_posix_element_read_ahead (builtin_posix_module_dataset_t *posix_dataset, hio_element_t element,
+                                              uint64_t offset, size_t length, hio_internal_request_t *prefetch) {
+  int64_t delta = (int64_t) (offset - element->e_ra_last);
+  uint64_t start, end, count;
+
+  prefetch->ir_count = 0;
+
+  if (delta == element->e_ra_delta && length == element->e_ra_size && delta >= (int64_t) length) {
+    ++element->e_ra_hits;
+  } else {
+    /* pattern changed. anything prefetched for the old pattern does not apply */
+    element->e_ra_delta = delta;
+    element->e_ra_hits = 0;
+    element->e_ra_end = 0;
+  }
+
+  element->e_ra_last = offset;
+  element->e_ra_size = length;
+
+  if (0 == element->e_ra_hits) {
+    return;
+  }
+
+  count = posix_dataset->ds_read_ahead;
+  if (element->e_size > 0) {
+    /* the element size is not always known when reading */
+    if ((uint64_t) element->e_size <= offset + delta) {
+      /* next read is past the end of the element */
+      return;
+    }
+
+    count = min(count, (element->e_size - 1 - offset) / delta);
+  }
+
+  /* keep ds_read_ahead reads in flight. skip reads that have already been prefetched */
+  start = offset + delta;
+  end = offset + count * delta;
+  while (start < element->e_ra_end && start <= end) {
+    start += delta;
+  }
+
+  if (start > end) {
+    return;
+  }
+
+  prefetch->ir_type = HIO_REQUEST_TYPE_PREFETCH;
+  prefetch->ir_element = element;
+  prefetch->ir_offset = start;
+  prefetch->ir_count = (end - start) / delta + 1;
+  prefetch->ir_size = length;
+  prefetch->ir_stride = delta - length;
+
+  element->e_ra_end = end + length;
+}
+
+/* record a segment that failed checksum verification */
+static int builtin_posix_checksum_error (builtin_posix_module_dataset_t *posix_dataset, hio_element_t element,
+                                         const hio_manifest_segment_t *segment) {
+  hioi_object_lock (&posix_dataset->base.ds_object);
+  ++posix_dataset->ds_checksum_errors;
+  hioi_object_unlock (&posix_dataset->base.ds_object);
+
+  hioi_err_push (HIO_ERR_CORRUPT, &element->e_object, "posix: checksum mismatch in element data at offset %"
+                 PRIu64 ", length %" PRIu64 " (file %d, offset %" PRIu64 ")", segment->seg_offset,
+                 segment->seg_length, segment->seg_file_index, segment->seg_foffset);
+
+  return HIO_ERR_CORRUPT;
+}
+
+/**
+ * Read part of a segment that must be read whole into a strided user buffer
+ *
+ * Used for compressed segments and for partial reads of checksummed segments.
+ * The whole segment is read, verified, and decompressed. The last segment read
+ * this way is kept on the element so a series of small reads does not read the
+ * same segment over and over. Writes to the element drop the cached segment (see
+ * hioi_element_insert_segment). Called with the file read-locked.
+ */
+static ssize_t builtin_posix_element_read_segment (builtin_posix_module_dataset_t *posix_dataset, hio_element_t element,
+                                                   hio_file_t *file, const hio_manifest_segment_t *segment,
+                                                   uint64_t offset, size_t length, const void **ptr, size_t *boffset,
+                                                   size_t size, size_t stride) {
+  size_t stored = (HIO_CODEC_NONE != segment->seg_codec) ? segment->seg_clength : segment->seg_length;
+  int64_t dataset_id = segment->seg_is_ref ? segment->seg_ref_id : (int64_t) posix_dataset->base.ds_id;
+  uint64_t seg_delta = offset - segment->seg_offset, generation;
+  void *sbuf, *data;
+  ssize_t ret;
+  int rc;
+
+  hioi_object_lock (&element->e_object);
+  generation = element->e_zgen;
+  if (element->e_zbuf && element->e_zdsid == dataset_id && element->e_zfile == segment->seg_file_index &&
+      element->e_zoffset == segment->seg_foffset) {
+    builtin_posix_copy_strided (ptr, boffset, size, stride, length, (void *) ((intptr_t) element->e_zbuf + seg_delta),
+                                false);
+    hioi_object_unlock (&element->e_object);
+    return length;
+  }
+  hioi_object_unlock (&element->e_object);
+
+  sbuf = malloc (stored);
+  if (NULL == sbuf) {
+    return HIO_ERR_OUT_OF_RESOURCE;
+  }
+
+  POSIX_TRACE_CALL(posix_dataset, ret = hioi_file_pread (file, sbuf, stored, segment->seg_foffset),
+                   "file_read", offset, stored);
+  if (ret < (ssize_t) stored) {
+    free (sbuf);
+    return (ret < 0) ? hioi_err_errno (errno) : HIO_ERR_TRUNCATE;
+  }
+
+  if (segment->seg_has_crc && hioi_crc32c (0, sbuf, stored) != segment->seg_crc) {
+    free (sbuf);
+    return builtin_posix_checksum_error (posix_dataset, element, segment);
+  }
+
+  if (HIO_CODEC_NONE != segment->seg_codec) {
+    data = malloc (segment->seg_length);
+    if (NULL == data) {
+      free (sbuf);
+      return HIO_ERR_OUT_OF_RESOURCE;
+    }
+
+    POSIX_TRACE_CALL(posix_dataset, rc = hioi_decompress (segment->seg_codec, sbuf, stored, data, segment->seg_length),
+                     "decompress", segment->seg_offset, segment->seg_length);
+    free (sbuf);
+    if (HIO_SUCCESS != rc) {
+      free (data);
+      hioi_err_push (rc, &element->e_object, "posix: could not decompress element data at offset %" PRIu64,
+                     segment->seg_offset);
+      return rc;
+    }
+  } else {
+    data = sbuf;
+  }
+
+  builtin_posix_copy_strided (ptr, boffset, size, stride, length, (void *) ((intptr_t) data + seg_delta), false);
+
+  hioi_object_lock (&element->e_object);
+  if (generation == element->e_zgen) {
+    free (element->e_zbuf);
+    element->e_zbuf = data;
+    element->e_zdsid = dataset_id;
+    element->e_zfile = segment->seg_file_index;
+    element->e_zoffset = segment->seg_foffset;
+  } else {
+    /* the element was written while the segment was read. the data may be stale */
+    free (data);
+  }
+  hioi_object_unlock (&element->e_object);
+
+  return length;
+}
+
 static ssize_t builtin_posix_module_element_read_strided_internal (builtin_posix_module_t *posix_module, hio_element_t element,
                                                                    uint64_t offset, void *ptr, size_t count, size_t size,
                                                                    size_t stride) {
   builtin_posix_module_dataset_t *posix_dataset = (builtin_posix_module_dataset_t *) hioi_element_dataset (element);
-  size_t bytes_read = 0, ret;
+  struct iovec iov[BUILTIN_POSIX_IOV_MAX];
+  size_t bytes_read = 0, remaining, boffset = 0;
+  uint64_t start, stop, file_offset;
+  hio_internal_request_t prefetch = {.ir_count = 0};
+  hio_manifest_segment_t segment;
+  uint64_t read_offset = offset;
+  const void *bptr = ptr;
   hio_file_t *file;
-  uint64_t start, stop;
-  int rc;
+  ssize_t ret;
+  int rc = HIO_SUCCESS, iovcnt;
 
   if (0 == count || 0 == size) {
     return 0;
   }
 
+  if (0 == stride) {
+    size *= count;
+    count = 1;
+  }
+
   errno = 0;
 
   start = hioi_gettime ();
 
-  for (size_t i = 0 ; i < count ; ++i) {
-    size_t req = size, actual;
-
-    do {
-      actual = req;
+  for (remaining = count * size ; remaining ; ) {
+    size_t req = builtin_posix_iov_limit (remaining, boffset, size), actual = req;
 
-      /* find out where the data lives */
-      POSIX_TRACE_CALL(posix_dataset, rc = builtin_posix_element_translate (posix_module, element, offset, &actual,
-                                                                            &file, true),
-                       "element_translate", offset, req);
-      if (HIO_SUCCESS != rc) {
-        break;
-      }
+    /* find out where the data lives */
+    POSIX_TRACE_CALL(posix_dataset, rc = builtin_posix_element_translate (posix_module, element, offset, &actual,
+                                                                          &file, &file_offset, true, &segment),
+                     "element_translate", offset, req);
+    if (HIO_SUCCESS != rc) {
+      break;
+    }
 
-      POSIX_TRACE_CALL(posix_dataset, ret = hioi_file_read (file, ptr, actual), "file_read", offset, actual);
-      if (ret > 0) {
-        bytes_read += ret;
+    if (HIO_CODEC_NONE != segment.seg_codec ||
+        (segment.seg_has_crc && (offset != segment.seg_offset || actual != segment.seg_length))) {
+      /* the whole segment is needed to decompress or verify the data */
+      ret = builtin_posix_element_read_segment (posix_dataset, element, file, &segment, offset, actual, &bptr,
+                                                &boffset, size, stride);
+      if (ret < 0) {
+        /* hio error code */
+        rc = (int) ret;
       }
+    } else {
+      iovcnt = builtin_posix_fill_iov (&bptr, &boffset, size, stride, actual, iov);
 
-      if (ret < actual) {
-        /* short read */
-        break;
+      POSIX_TRACE_CALL(posix_dataset, ret = hioi_file_preadv (file, iov, iovcnt, file_offset), "file_read", offset, actual);
+      if (segment.seg_has_crc && ret == (ssize_t) actual && builtin_posix_iov_crc (iov, iovcnt) != segment.seg_crc) {
+        rc = builtin_posix_checksum_error (posix_dataset, element, &segment);
+        ret = 0;
       }
+    }
+    pthread_rwlock_unlock (&file->f_lock);
+    if (ret > 0) {
+      bytes_read += ret;
+    }
 
-      req -= actual;
-      offset += actual;
-      ptr = (void *) ((intptr_t) ptr + actual);
-    } while (req);
-
-    if (req || HIO_SUCCESS != rc) {
+    if (ret < (ssize_t) actual) {
+      /* short read */
       break;
     }
 
-    ptr = (void *) ((intptr_t) ptr + stride);
+    remaining -= actual;
+    offset += actual;
   }
 
   if (0 == bytes_read || HIO_SUCCESS != rc) {
@@ -1344,8 +3132,20 @@ static ssize_t builtin_posix_module_element_read_strided_internal (builtin_posix
   }
 
   stop = hioi_gettime ();
+
+  hioi_object_lock (&posix_dataset->base.ds_object);
   posix_dataset->base.ds_stat.s_rtime += stop - start;
   posix_dataset->base.ds_stat.s_bread += bytes_read;
+  if (posix_dataset->ds_read_ahead > 0) {
+    builtin_posix_element_read_ahead (posix_dataset, element, read_offset, count * size, &prefetch);
+  }
+  hioi_object_unlock (&posix_dataset->base.ds_object);
+
+  if (prefetch.ir_count) {
+    /* prefetch in the background. the worker pool processes the request inline if no
+     * I/O threads are available */
+    (void) hioi_worker_submit (&posix_dataset->base, &prefetch, NULL);
+  }
 
   return bytes_read;
 }
@@ -1353,17 +3153,24 @@ static ssize_t builtin_posix_module_element_read_strided_internal (builtin_posix
 static int builtin_posix_module_process_reqs (hio_dataset_t dataset, hio_internal_request_t **reqs, int req_count) {
   builtin_posix_module_dataset_t *posix_dataset = (builtin_posix_module_dataset_t *) dataset;
   builtin_posix_module_t *posix_module = (builtin_posix_module_t *) dataset->ds_module;
-  hio_context_t context = hioi_object_context (&dataset->ds_object);
   uint64_t start, stop;
   int rc = HIO_SUCCESS;
 
   start = hioi_gettime ();
 
-  hioi_object_lock (&dataset->ds_object);
+  /* no dataset lock is held here. the translation functions lock the dataset
+   * as needed and data is transferred with positional I/O so requests on
+   * different threads can proceed in parallel */
   for (int i = 0 ; i < req_count ; ++i) {
     hio_internal_request_t *req = reqs[i];
 
-    if (HIO_REQUEST_TYPE_READ == req->ir_type) {
+    if (HIO_REQUEST_TYPE_PREFETCH == req->ir_type) {
+      POSIX_TRACE_CALL(posix_dataset,
+                       builtin_posix_element_prefetch (posix_module, req->ir_element, req->ir_offset, req->ir_count,
+                                                       req->ir_size, req->ir_stride),
+                       "element_prefetch", req->ir_offset, req->ir_count * req->ir_size);
+      req->ir_status = 0;
+    } else if (HIO_REQUEST_TYPE_READ == req->ir_type) {
       POSIX_TRACE_CALL(posix_dataset,
                        req->ir_status = builtin_posix_module_element_read_strided_internal (posix_module, req->ir_element, req->ir_offset,
                                                                                             req->ir_data.r, req->ir_count, req->ir_size,
@@ -1374,34 +3181,298 @@ static int builtin_posix_module_process_reqs (hio_dataset_t dataset, hio_interna
       POSIX_TRACE_CALL(posix_dataset,
                        req->ir_status = builtin_posix_module_element_write_strided_internal (posix_module, req->ir_element, req->ir_offset,
                                                                                              req->ir_data.w, req->ir_count, req->ir_size,
-                                                                                             req->ir_stride),
+                                                                                             req->ir_stride, req->ir_iov),
                        "element_write", req->ir_offset, req->ir_count * req->ir_size);
     }
 
-    if (req->ir_urequest && req->ir_status > 0) {
-      hio_request_t new_request = hioi_request_alloc (context);
-      if (NULL == new_request) {
-        rc = HIO_ERR_OUT_OF_RESOURCE;
-        break;
+    if (req->ir_status < 0) {
+      rc = (int) req->ir_status;
+      break;
+    }
+  }
+
+  stop = hioi_gettime ();
+
+  builtin_posix_trace (posix_dataset, "process_requests", req_count, 0, start, stop);
+
+  return rc;
+}
+
+/** smallest piece of a buffered write given to a flush thread in basic and optimized modes */
+#define BUILTIN_POSIX_FLUSH_MIN_PIECE (1ul << 16)
+
+typedef struct builtin_posix_flush_group_t {
+  hio_dataset_t           dataset;
+  hio_internal_request_t **reqs;
+  int                     count;
+  int                     rc;
+  pthread_t               thread;
+} builtin_posix_flush_group_t;
+
+static void *builtin_posix_flush_thread (void *arg) {
+  builtin_posix_flush_group_t *group = (builtin_posix_flush_group_t *) arg;
+
+  group->rc = builtin_posix_module_process_reqs (group->dataset, group->reqs, group->count);
+
+  return NULL;
+}
+
+/**
+ * Split buffered writes into pieces that can be written independently
+ *
+ * In strided mode writes are split at block boundaries and each piece is
+ * assigned a group based on the file it targets. In the other modes all writes
+ * of an element go to the same file so they are split into unit sized pieces
+ * which are spread over the groups.
+ *
+ * @returns the number of pieces. if pieces is NULL only the count is returned.
+ */
+static int builtin_posix_flush_split (builtin_posix_module_dataset_t *posix_dataset, hio_internal_request_t **reqs,
+                                      int req_count, uint64_t unit, int ngroups, hio_internal_request_t *pieces,
+                                      int *groups) {
+  int npieces = 0;
+
+  for (int i = 0 ; i < req_count ; ++i) {
+    uint64_t offset = reqs[i]->ir_offset;
+    size_t remaining = reqs[i]->ir_size, done = 0, boffset = 0;
+    const struct iovec *uiov = reqs[i]->ir_iov;
+
+    if (uiov) {
+      boffset = (intptr_t) reqs[i]->ir_data.w - (intptr_t) uiov->iov_base;
+    }
+
+    while (remaining) {
+      size_t length = min(remaining, unit - offset % unit);
+
+      if (pieces) {
+        hio_internal_request_t *piece = pieces + npieces;
+        uint64_t unit_id = offset / unit;
+
+        *piece = *reqs[i];
+        piece->ir_offset = offset;
+        piece->ir_size = length;
+        piece->ir_count = 1;
+        if (uiov) {
+          /* the piece starts in the current user buffer of the deferred write */
+          piece->ir_iov = (struct iovec *) uiov;
+          piece->ir_data.w = (const void *) ((intptr_t) uiov->iov_base + boffset);
+        } else {
+          piece->ir_data.w = (const void *) ((intptr_t) reqs[i]->ir_data.w + done);
+        }
+
+        if (HIO_FILE_MODE_STRIDED == posix_dataset->ds_fmode) {
+          /* group by file */
+          groups[npieces] = (unit_id % posix_dataset->ds_fcount) % ngroups;
+        } else {
+          groups[npieces] = unit_id % ngroups;
+        }
+
+        if (uiov) {
+          builtin_posix_iov_list_advance (&uiov, &boffset, length);
+        }
       }
 
-      req->ir_urequest[0] = new_request;
-      new_request->req_transferred = req->ir_status;
-      new_request->req_complete = true;
-      new_request->req_status = HIO_SUCCESS;
+      ++npieces;
+      offset += length;
+      done += length;
+      remaining -= length;
     }
+  }
 
-    if (req->ir_status < 0) {
-      rc = (int) req->ir_status;
+  return npieces;
+}
+
+/**
+ * Reserve file space for the pieces of a buffered write in element order
+ *
+ * In optimized mode space in the shared file is reserved the first time an element
+ * offset is translated. Translating every piece on the calling thread before the
+ * pieces are handed to the flush threads keeps the file layout independent of the
+ * order the threads run in. The threads then find the segments and write in place.
+ */
+static int builtin_posix_flush_reserve (hio_dataset_t dataset, hio_internal_request_t *pieces, int npieces) {
+  builtin_posix_module_t *posix_module = (builtin_posix_module_t *) dataset->ds_module;
+  uint64_t file_offset;
+  hio_file_t *file;
+  int rc;
+
+  for (int i = 0 ; i < npieces ; ++i) {
+    uint64_t offset = pieces[i].ir_offset;
+    size_t remaining = pieces[i].ir_size;
+
+    while (remaining) {
+      size_t actual = remaining;
+
+      rc = builtin_posix_element_translate (posix_module, pieces[i].ir_element, offset, &actual, &file,
+                                            &file_offset, false, NULL);
+      if (HIO_SUCCESS != rc) {
+        return rc;
+      }
+
+      pthread_rwlock_unlock (&file->f_lock);
+      offset += actual;
+      remaining -= actual;
+    }
+  }
+
+  return HIO_SUCCESS;
+}
+
+/**
+ * Flush the sorted requests from the aggregation buffer
+ *
+ * Buffered writes are split by target file and the resulting groups are written
+ * concurrently by ds_flush_threads threads (including the calling thread). In
+ * optimized mode space is reserved serially before the groups are written.
+ */
+static int builtin_posix_module_flush_reqs (hio_dataset_t dataset, hio_internal_request_t **reqs, int req_count) {
+  builtin_posix_module_dataset_t *posix_dataset = (builtin_posix_module_dataset_t *) dataset;
+  int ngroups = posix_dataset->ds_flush_threads, npieces, rc = HIO_SUCCESS;
+  builtin_posix_flush_group_t *groups = NULL;
+  hio_internal_request_t *pieces = NULL, **sorted = NULL;
+  size_t total = 0;
+  int *piece_group = NULL;
+  uint64_t unit;
+
+  for (int i = 0 ; i < req_count ; ++i) {
+    if (HIO_REQUEST_TYPE_WRITE != reqs[i]->ir_type || 0 != reqs[i]->ir_stride || 1 != reqs[i]->ir_count) {
+      /* only contiguous buffered writes are split */
+      ngroups = 1;
       break;
     }
+
+    total += reqs[i]->ir_size;
   }
 
-  hioi_object_unlock (&dataset->ds_object);
+  if (HIO_FILE_MODE_STRIDED == posix_dataset->ds_fmode) {
+    unit = posix_dataset->ds_bs;
+    ngroups = min(ngroups, posix_dataset->ds_fcount);
+  } else {
+    unit = max((total / ngroups + BUILTIN_POSIX_FLUSH_MIN_PIECE - 1) & ~(BUILTIN_POSIX_FLUSH_MIN_PIECE - 1),
+               BUILTIN_POSIX_FLUSH_MIN_PIECE);
+    uint64_t block_size = builtin_posix_write_block_size (posix_dataset);
+    if (block_size) {
+      if (HIO_FILE_MODE_OPTIMIZED == posix_dataset->ds_fmode) {
+        /* the space needed for a compressed or incremental block is not known until the
+         * block is written. write serially to keep the file layout deterministic */
+        ngroups = 1;
+      }
 
-  stop = hioi_gettime ();
+      /* do not split compression or incremental blocks between threads */
+      unit = ((unit + block_size - 1) / block_size) * block_size;
+    }
+  }
 
-  builtin_posix_trace (posix_dataset, "process_requests", req_count, 0, start, stop);
+  if (ngroups < 2 || total <= unit) {
+    return builtin_posix_module_process_reqs (dataset, reqs, req_count);
+  }
+
+  npieces = builtin_posix_flush_split (posix_dataset, reqs, req_count, unit, ngroups, NULL, NULL);
+
+  pieces = malloc (npieces * sizeof (pieces[0]));
+  sorted = malloc (npieces * sizeof (sorted[0]));
+  piece_group = malloc (npieces * sizeof (piece_group[0]));
+  groups = calloc (ngroups, sizeof (groups[0]));
+  if (NULL == pieces || NULL == sorted || NULL == piece_group || NULL == groups) {
+    free (pieces);
+    free (sorted);
+    free (piece_group);
+    free (groups);
+    return builtin_posix_module_process_reqs (dataset, reqs, req_count);
+  }
+
+  (void) builtin_posix_flush_split (posix_dataset, reqs, req_count, unit, ngroups, pieces, piece_group);
+
+  if (HIO_FILE_MODE_OPTIMIZED == posix_dataset->ds_fmode) {
+    /* on failure the flush threads will run into the same error and report it in the requests */
+    (void) builtin_posix_flush_reserve (dataset, pieces, npieces);
+  }
+
+  /* bucket the pieces by group. pieces keep their sorted order within each group */
+  for (int i = 0, next = 0 ; i < ngroups ; ++i) {
+    groups[i].dataset = dataset;
+    groups[i].reqs = sorted + next;
+    for (int j = 0 ; j < npieces ; ++j) {
+      if (piece_group[j] == i) {
+        groups[i].reqs[groups[i].count++] = pieces + j;
+      }
+    }
+    next += groups[i].count;
+  }
+
+  for (int i = 1 ; i < ngroups ; ++i) {
+    if (0 == groups[i].count || 0 != pthread_create (&groups[i].thread, NULL, builtin_posix_flush_thread, groups + i)) {
+      /* write this group on the calling thread */
+      groups[i].count = -groups[i].count;
+    }
+  }
+
+  groups[0].rc = builtin_posix_module_process_reqs (dataset, groups[0].reqs, groups[0].count);
+
+  for (int i = 1 ; i < ngroups ; ++i) {
+    if (groups[i].count > 0) {
+      pthread_join (groups[i].thread, NULL);
+    } else if (groups[i].count < 0) {
+      groups[i].rc = builtin_posix_module_process_reqs (dataset, groups[i].reqs, -groups[i].count);
+    }
+
+    if (HIO_SUCCESS == rc) {
+      rc = groups[i].rc;
+    }
+  }
+
+  if (HIO_SUCCESS != groups[0].rc) {
+    rc = groups[0].rc;
+  }
+
+  /* pieces were generated in request order. report their status in the requests */
+  for (int i = 0, j = 0 ; i < req_count ; ++i) {
+    size_t covered = 0;
+
+    reqs[i]->ir_status = 0;
+    for ( ; covered < reqs[i]->ir_size ; ++j) {
+      covered += pieces[j].ir_size;
+      if (reqs[i]->ir_status >= 0) {
+        reqs[i]->ir_status = (pieces[j].ir_status < 0) ? pieces[j].ir_status : reqs[i]->ir_status + pieces[j].ir_status;
+      }
+    }
+  }
+
+  free (pieces);
+  free (sorted);
+  free (piece_group);
+  free (groups);
+
+  return rc;
+}
+
+/**
+ * Sync a data file if it has been written since it was last synced
+ */
+static int builtin_posix_file_sync (builtin_posix_module_dataset_t *posix_dataset, hio_file_t *file) {
+  int rc = HIO_SUCCESS, file_id;
+  bool synced = false;
+
+  /* wait for any writes in progress and prevent the file from being closed by another
+   * thread during the sync */
+  pthread_rwlock_wrlock (&file->f_lock);
+  if (hioi_file_dirty (file)) {
+    POSIX_TRACE_CALL(posix_dataset, rc = hioi_file_flush (file), "file_sync", file->f_bid, 0);
+    synced = true;
+  }
+  file_id = file->f_bid;
+  pthread_rwlock_unlock (&file->f_lock);
+
+  /* object locks are always taken before file locks. do not take them while holding f_lock */
+  if (synced) {
+    hioi_object_lock (&posix_dataset->base.ds_object);
+    ++posix_dataset->ds_file_syncs;
+    hioi_object_unlock (&posix_dataset->base.ds_object);
+  }
+
+  if (HIO_SUCCESS != rc) {
+    hioi_err_push (rc, &posix_dataset->base.ds_object, "posix: error syncing data file %d", file_id);
+  }
 
   return rc;
 }
@@ -1409,6 +3480,7 @@ static int builtin_posix_module_process_reqs (hio_dataset_t dataset, hio_interna
 static int builtin_posix_module_element_flush (hio_element_t element, hio_flush_mode_t mode) {
   builtin_posix_module_dataset_t *posix_dataset =
     (builtin_posix_module_dataset_t *) hioi_element_dataset (element);
+  int rc = HIO_SUCCESS;
 
   if (!(posix_dataset->base.ds_flags & HIO_FLAG_WRITE)) {
     return HIO_ERR_PERM;
@@ -1420,14 +3492,22 @@ static int builtin_posix_module_element_flush (hio_element_t element, hio_flush_
   }
 
   if (HIO_FILE_MODE_BASIC != posix_dataset->ds_fmode) {
-    for (int i = 0 ; i < HIO_POSIX_MAX_OPEN_FILES ; ++i) {
-      hioi_file_flush (posix_dataset->files + i);
+    for (int i = 0 ; i < posix_dataset->ds_max_open_files && HIO_SUCCESS == rc ; ++i) {
+      hio_file_t *file = posix_dataset->files + i;
+
+      /* strided mode files belong to a single element. optimized mode files are shared
+       * by all elements and are only synced by the first element flushed after a write */
+      if (file->f_element && file->f_element != element) {
+        continue;
+      }
+
+      rc = builtin_posix_file_sync (posix_dataset, file);
     }
   } else {
-    hioi_file_flush (&element->e_file);
+    rc = builtin_posix_file_sync (posix_dataset, &element->e_file);
   }
 
-  return HIO_SUCCESS;
+  return rc;
 }
 
 static int builtin_posix_module_element_complete (hio_element_t element) {
@@ -15,8 +15,29 @@
 #include "hio_internal.h"
 #include "hio_component.h"
 
+#include <limits.h>
+#include <fcntl.h>
+
+/** maximum length of a data file name (relative to the data directory) */
+#define HIO_POSIX_NAME_MAX (HIO_ELEMENT_NAME_MAX + 32)
+
+/** default maximum number of files each dataset keeps open in optimized and strided modes */
 #define HIO_POSIX_MAX_OPEN_FILES  32
 
+/** maximum number of vectors passed to a single vectored read or write */
+#if defined(IOV_MAX) && IOV_MAX < 1024
+#define BUILTIN_POSIX_IOV_MAX IOV_MAX
+#else
+#define BUILTIN_POSIX_IOV_MAX 1024
+#endif
+
+/** direct I/O is only supported with the file descriptor interface */
+#if defined(O_DIRECT) && !BUILTIN_POSIX_USE_STDIO
+#define BUILTIN_POSIX_HAVE_DIRECT_IO 1
+#else
+#define BUILTIN_POSIX_HAVE_DIRECT_IO 0
+#endif
+
 typedef enum builtin_posix_dataset_fmode {
   /** use basic mode. unique address space results in a single file per element per rank.
    * shared address space results in a single file per element */
@@ -28,6 +49,15 @@ typedef enum builtin_posix_dataset_fmode {
 } builtin_posix_dataset_fmode_t;
 
 /* data types */
+
+/** data file with space preallocated by this process (see builtin_posix_prealloc_trim) */
+typedef struct builtin_posix_prealloc_file_t {
+  /** file name relative to the data directory */
+  char               *pf_name;
+  /** end of the space preallocated in the file */
+  uint64_t            pf_end;
+} builtin_posix_prealloc_file_t;
+
 typedef struct builtin_posix_module_t {
   hio_module_t base;
   mode_t access_mode;
@@ -38,11 +68,34 @@ typedef struct builtin_posix_module_dataset_t {
   struct hio_dataset base;
 
   /** open backing files */
-  hio_file_t files[HIO_POSIX_MAX_OPEN_FILES];
+  hio_file_t *files;
+
+  /** number of entries in the open file cache */
+  int32_t ds_max_open_files;
+
+  /** open file cache ordered from most to least recently used */
+  hio_list_t ds_file_lru;
+
+  /** open file cache hash buckets (indexed by builtin_posix_file_hash) */
+  hio_list_t *ds_file_buckets;
+  /** number of hash buckets - 1 (the bucket count is a power of two) */
+  unsigned long ds_file_bucket_mask;
+
+  /** open file cache statistics */
+  uint64_t ds_file_cache_hits;
+  uint64_t ds_file_cache_misses;
+  uint64_t ds_file_cache_evictions;
+
+  /** number of data file syncs issued by element flushes */
+  uint64_t ds_file_syncs;
 
   /** base path of this manifest */
   char *base_path;
 
+  /** open directory containing the dataset's data files. data files are opened relative
+   * to this directory */
+  int ds_data_dirfd;
+
   /** start offset of reserved file region. for peformance this
    * should be a multiple of the underlying filesystem's stripe
    * size */
@@ -54,22 +107,113 @@ typedef struct builtin_posix_module_dataset_t {
   /** stripe this rank should write */
   int my_stripe;
 
+  /** number of stripe lanes in the shared file in optimized mode. lane i holds blocks
+   * i, i + ds_stripe_count, i + 2 * ds_stripe_count, ... */
+  int ds_stripe_count;
+
+  /** reserve blocks from a lane of the shared file instead of a single node-wide counter */
+  bool ds_stripe_exclusive;
+
   /** use bzip2 to compress data manifests */
   bool                ds_use_bzip;
 
+  /** reservations smaller than this are packed into blocks shared by all ranks on a node */
+  uint64_t            ds_pack_threshold;
+
+  /** alignment of packed reservations */
+  uint64_t            ds_pack_align;
+
+  /** number of reservations packed into shared blocks */
+  uint64_t            ds_pack_count;
+
+  /** codec used to compress element data in optimized mode */
+  hio_codec_t         ds_codec;
+
+  /** element data is compressed in independent blocks of this size */
+  uint64_t            ds_cblock_size;
+
+  /** number of bytes stored by compressed writes (after compression) */
+  uint64_t            ds_compressed_bytes;
+
+  /** store a crc32c for every segment written in optimized mode */
+  bool                ds_checksum;
+
+  /** number of segments that failed checksum verification when read */
+  uint64_t            ds_checksum_errors;
+
+  /** number of segments whose checksum was dropped after a partial overwrite */
+  uint64_t            ds_unverified_segments;
+
+  /** only write blocks that changed since the previous instance of the dataset */
+  bool                ds_incremental;
+
+  /** size of the element blocks compared with the previous instance */
+  uint64_t            ds_iblock_size;
+
+  /** previous instance of the dataset (open for reading) used to find unchanged blocks */
+  hio_dataset_t       ds_prev;
+
+  /** entries of base.ds_refs actually referenced by this process */
+  bool               *ds_ref_used;
+
+  /** number of element bytes that were unchanged and not written */
+  uint64_t            ds_unchanged_bytes;
+
   /** dataset file mode */
   builtin_posix_dataset_fmode_t ds_fmode;
 
   /** block size to use for optimized and strided file modes */
   uint64_t            ds_bs;
+  /** block size was set by the user and must not be adjusted to the stripe size */
+  bool                ds_bs_user;
 
   /** number of files to use with strided mode */
   int                 ds_fcount;
 
+  /** open dataset files with O_DIRECT */
+  bool                ds_direct_io;
+
+  /** alignment required for direct I/O */
+  size_t              ds_direct_align;
+
+  /** map data files into memory when reading */
+  bool                ds_mmap_read;
+
+  /** number of reads to prefetch once a sequential or fixed-stride pattern is detected */
+  int32_t             ds_read_ahead;
+
+  /** number of threads to use when flushing the aggregation buffer */
+  int32_t             ds_flush_threads;
+
+  /** preallocate space in data files when writing */
+  bool                ds_preallocate;
+
+  /** expected size of each data file. this much space is preallocated when a file is opened */
+  uint64_t            ds_prealloc_size;
+
+  /** set without the dataset lock when a strided block could not be preallocated because the
+   * filesystem does not support it */
+  atomic_bool         ds_prealloc_unsupported;
+
+  /** files this process preallocated space in. recorded when the files are closed */
+  builtin_posix_prealloc_file_t *ds_prealloc_files;
+  int                 ds_prealloc_count;
+  int                 ds_prealloc_max;
+
+  /** start writing back data file pages after this many bytes are written to a file (0: disabled) */
+  uint64_t            ds_writeback_size;
+
   /** trace file */
   FILE               *ds_trace_fh;
 } builtin_posix_module_dataset_t;
 
 extern hio_component_t builtin_posix_component;
 
+/**
+ * Find a dataset on a posix data root that refers to the data of dataset set_id
+ *
+ * Returns the identifier of the dependent dataset or -1 if there is none.
+ */
+int64_t builtin_posix_dataset_dependent (struct hio_module_t *module, const char *name, int64_t set_id);
+
 #endif /* BUILTIN_POSIX_COMPONENT_H */
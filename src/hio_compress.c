@@ -0,0 +1,110 @@
+/* -*- Mode: C; c-basic-offset:2 ; indent-tabs-mode:nil -*- */
+/*
+ * Copyright (c) 2014-2016 Los Alamos National Security, LLC.  All rights
+ *                         reserved.
+ * $COPYRIGHT$
+ *
+ * Additional copyrights may follow
+ *
+ * $HEADER$
+ */
+
+/**
+ * @file hio_compress.c
+ * @brief dataset data compression
+ *
+ * Thin wrappers around the codecs that can be used to compress dataset
+ * data. Each call compresses or decompresses a single buffer so blocks
+ * can be processed independently (and concurrently).
+ */
+
+#include "hio_internal.h"
+
+#include <string.h>
+
+#if HIO_USE_ZLIB
+#include <zlib.h>
+#endif
+
+bool hioi_codec_available (hio_codec_t codec) {
+  switch (codec) {
+  case HIO_CODEC_NONE:
+    return true;
+#if HIO_USE_ZLIB
+  case HIO_CODEC_ZLIB:
+    return true;
+#endif
+  default:
+    return false;
+  }
+}
+
+size_t hioi_compress_bound (hio_codec_t codec, size_t length) {
+  switch (codec) {
+#if HIO_USE_ZLIB
+  case HIO_CODEC_ZLIB:
+    return compressBound (length);
+#endif
+  default:
+    return length;
+  }
+}
+
+int hioi_compress (hio_codec_t codec, const void *src, size_t length, void *dst, size_t *dst_length) {
+  switch (codec) {
+  case HIO_CODEC_NONE:
+    if (*dst_length < length) {
+      return HIO_ERR_TRUNCATE;
+    }
+
+    memcpy (dst, src, length);
+    *dst_length = length;
+    return HIO_SUCCESS;
+#if HIO_USE_ZLIB
+  case HIO_CODEC_ZLIB:
+  {
+    uLongf zlength = *dst_length;
+    int rc;
+
+    /* favor speed over compression ratio. the data is being compressed on the way to storage */
+    rc = compress2 ((Bytef *) dst, &zlength, (const Bytef *) src, length, Z_BEST_SPEED);
+    if (Z_OK != rc) {
+      return (Z_BUF_ERROR == rc) ? HIO_ERR_TRUNCATE : HIO_ERROR;
+    }
+
+    *dst_length = zlength;
+    return HIO_SUCCESS;
+  }
+#endif
+  default:
+    return HIO_ERR_NOT_AVAILABLE;
+  }
+}
+
+int hioi_decompress (hio_codec_t codec, const void *src, size_t length, void *dst, size_t dst_length) {
+  switch (codec) {
+  case HIO_CODEC_NONE:
+    if (dst_length != length) {
+      return HIO_ERROR;
+    }
+
+    memcpy (dst, src, length);
+    return HIO_SUCCESS;
+#if HIO_USE_ZLIB
+  case HIO_CODEC_ZLIB:
+  {
+    uLongf zlength = dst_length;
+    int rc;
+
+    rc = uncompress ((Bytef *) dst, &zlength, (const Bytef *) src, length);
+    if (Z_OK != rc || zlength != dst_length) {
+      return HIO_ERROR;
+    }
+
+    return HIO_SUCCESS;
+  }
+#endif
+  default:
+    return HIO_ERR_NOT_AVAILABLE;
+  }
+}
@@ -30,6 +30,9 @@ static void hioi_context_release (hio_object_t object) {
   hio_dataset_data_t *ds_data, *next;
   hio_context_t context = (hio_context_t) object;
 
+  /* stop asynchronous workers before the modules go away */
+  hioi_worker_pool_fini (context);
+
   for (int i = 0 ; i < context->c_mcount ; ++i) {
     context->c_modules[i]->fini (context->c_modules[i]);
   }
@@ -132,6 +135,7 @@ static hio_context_t hio_context_alloc (const char *identifier) {
   new_context->c_print_stats = false;
   new_context->c_rank = 0;
   new_context->c_size = 1;
+  new_context->c_io_threads = 1;
   hioi_context_msg_id(new_context, 0); 
 
 #if HIO_MPI_HAVE(3)
@@ -168,6 +172,8 @@ static hio_context_t hio_context_alloc (const char *identifier) {
 
   hioi_list_init (new_context->c_ds_data);
 
+  hioi_worker_pool_init (new_context);
+
   return new_context;
 }
 
@@ -349,6 +355,11 @@ static int hio_init_common (hio_context_t context, const char *config_file, cons
                    "print_statistics", HIO_CONFIG_TYPE_BOOL, NULL, "Print statistics "
                    "to stdout when the context is closed (default: 0)", 0);
 
+  hioi_config_add (context, &context->c_object, &context->c_io_threads,
+                   "io_threads", HIO_CONFIG_TYPE_INT32, NULL, "Number of threads used to "
+                   "process non-blocking requests. Requests are processed at submission if "
+                   "this is 0 (default: 1)", 0);
+
 #if HIO_USE_DATAWARP
   context->c_dw_root = strdup ("auto");
   hioi_config_add (context, &context->c_object, &context->c_dw_root,
@@ -442,7 +453,7 @@ int hio_init_mpi (hio_context_t *new_context, MPI_Comm *comm, const char *config
                   const char *config_file_prefix, const char *context_name) {
   hio_context_t context;
   MPI_Comm comm_in;
-  int rc, flag = 0;
+  int rc, flag = 0, thread_level;
 
   (void) MPI_Initialized (&flag);
   if (!flag) {
@@ -473,6 +484,9 @@ int hio_init_mpi (hio_context_t *new_context, MPI_Comm *comm, const char *config
 
   context->c_use_mpi = true;
 
+  (void) MPI_Query_thread (&thread_level);
+  context->c_mpi_thread_multiple = (MPI_THREAD_MULTIPLE == thread_level);
+
   MPI_Comm_rank (context->c_comm, &context->c_rank);
   MPI_Comm_size (context->c_comm, &context->c_size);
   hioi_context_msg_id(context, 1); 
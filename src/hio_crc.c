@@ -12,16 +12,107 @@
 
 #include "hio_internal.h"
 
+#include <string.h>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <nmmintrin.h>
+#define HIO_CRC32C_SSE42 1
+#elif defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#define HIO_CRC32C_ARM 1
+#endif
+
 #define CRC32POLY 0x04C11DB7l
 #define CRC64POLY 0xC96C5795D7870F42ul
+/* Castagnoli polynomial (reversed) */
+#define CRC32CPOLY 0x82F63B78u
 
 static uint32_t crc32_table[256];
 static uint64_t crc64_table[256];
+/* slicing-by-8 tables for the software crc32c */
+static uint32_t crc32c_table[8][256];
+
+typedef uint32_t (*hioi_crc32c_fn_t) (uint32_t crc, const uint8_t *buf, size_t length);
+
+static uint32_t hioi_crc32c_sw (uint32_t crc, const uint8_t *buf, size_t length);
+static hioi_crc32c_fn_t hioi_crc32c_impl = hioi_crc32c_sw;
 
 static bool crc_initialized = false;
 
 pthread_mutex_t crc_init_lock = PTHREAD_MUTEX_INITIALIZER;
 
+/* software crc32c. processes 8 bytes per step using the slicing-by-8 tables */
+static uint32_t hioi_crc32c_sw (uint32_t crc, const uint8_t *buf, size_t length) {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  while (length && ((uintptr_t) buf & 7)) {
+    crc = (crc >> 8) ^ crc32c_table[0][(crc ^ *buf++) & 0xff];
+    --length;
+  }
+
+  for ( ; length >= 8 ; length -= 8, buf += 8) {
+    uint32_t lo, hi;
+
+    memcpy (&lo, buf, 4);
+    memcpy (&hi, buf + 4, 4);
+    lo ^= crc;
+
+    crc = crc32c_table[7][lo & 0xff] ^ crc32c_table[6][(lo >> 8) & 0xff] ^
+      crc32c_table[5][(lo >> 16) & 0xff] ^ crc32c_table[4][lo >> 24] ^
+      crc32c_table[3][hi & 0xff] ^ crc32c_table[2][(hi >> 8) & 0xff] ^
+      crc32c_table[1][(hi >> 16) & 0xff] ^ crc32c_table[0][hi >> 24];
+  }
+#endif
+
+  while (length--) {
+    crc = (crc >> 8) ^ crc32c_table[0][(crc ^ *buf++) & 0xff];
+  }
+
+  return crc;
+}
+
+#if HIO_CRC32C_SSE42
+/* crc32c using the SSE 4.2 crc32 instruction. selected at runtime if the cpu supports it */
+__attribute__((target ("sse4.2")))
+static uint32_t hioi_crc32c_sse42 (uint32_t crc, const uint8_t *buf, size_t length) {
+  uint64_t crc64;
+
+  while (length && ((uintptr_t) buf & 7)) {
+    crc = _mm_crc32_u8 (crc, *buf++);
+    --length;
+  }
+
+  crc64 = crc;
+  for ( ; length >= 8 ; length -= 8, buf += 8) {
+    crc64 = _mm_crc32_u64 (crc64, *(const uint64_t *) buf);
+  }
+  crc = (uint32_t) crc64;
+
+  while (length--) {
+    crc = _mm_crc32_u8 (crc, *buf++);
+  }
+
+  return crc;
+}
+#elif HIO_CRC32C_ARM
+/* crc32c using the ARMv8 crc32 instructions */
+static uint32_t hioi_crc32c_arm (uint32_t crc, const uint8_t *buf, size_t length) {
+  while (length && ((uintptr_t) buf & 7)) {
+    crc = __crc32cb (crc, *buf++);
+    --length;
+  }
+
+  for ( ; length >= 8 ; length -= 8, buf += 8) {
+    crc = __crc32cd (crc, *(const uint64_t *) buf);
+  }
+
+  while (length--) {
+    crc = __crc32cb (crc, *buf++);
+  }
+
+  return crc;
+}
+#endif
+
 static void crc_init_tables (void) {
   pthread_mutex_lock (&crc_init_lock);
   if (crc_initialized) {
@@ -55,6 +146,34 @@ static void crc_init_tables (void) {
     crc64_table[i] = r;
   }
 
+  for (int i = 0 ; i < 256 ; i++) {
+    uint32_t r = i;
+
+    for (int j = 0; j < 8; j++)  {
+      if (r & 1)
+        r = (r >> 1) ^ CRC32CPOLY;
+      else
+        r >>= 1;
+    }
+
+    crc32c_table[0][i] = r;
+  }
+
+  for (int i = 0 ; i < 256 ; i++) {
+    for (int k = 1 ; k < 8 ; k++) {
+      uint32_t r = crc32c_table[k - 1][i];
+      crc32c_table[k][i] = (r >> 8) ^ crc32c_table[0][r & 0xff];
+    }
+  }
+
+#if HIO_CRC32C_SSE42
+  if (__builtin_cpu_supports ("sse4.2")) {
+    hioi_crc32c_impl = hioi_crc32c_sse42;
+  }
+#elif HIO_CRC32C_ARM
+  hioi_crc32c_impl = hioi_crc32c_arm;
+#endif
+
   crc_initialized = true;
   pthread_mutex_unlock (&crc_init_lock);
 }
@@ -82,3 +201,98 @@ uint64_t hioi_crc64 (uint8_t *buf, size_t length) {
 
   return crc;
 }
+
+uint32_t hioi_crc32c (uint32_t crc, const void *buf, size_t length) {
+  if (!crc_initialized)
+    crc_init_tables ();
+
+  return ~hioi_crc32c_impl (~crc, (const uint8_t *) buf, length);
+}
+
+/* xxHash64 primes */
+#define XXH_PRIME64_1 0x9E3779B185EBCA87ul
+#define XXH_PRIME64_2 0xC2B2AE3D27D4EB4Ful
+#define XXH_PRIME64_3 0x165667B19E3779F9ul
+#define XXH_PRIME64_4 0x85EBCA77C2B2AE63ul
+#define XXH_PRIME64_5 0x27D4EB2F165667C5ul
+
+static inline uint64_t xxh_rotl64 (uint64_t x, int r) {
+  return (x << r) | (x >> (64 - r));
+}
+
+static inline uint64_t xxh_read64 (const uint8_t *p) {
+  uint64_t v;
+  memcpy (&v, p, 8);
+  return v;
+}
+
+static inline uint32_t xxh_read32 (const uint8_t *p) {
+  uint32_t v;
+  memcpy (&v, p, 4);
+  return v;
+}
+
+static inline uint64_t xxh_round (uint64_t acc, uint64_t input) {
+  acc += input * XXH_PRIME64_2;
+  acc = xxh_rotl64 (acc, 31);
+  return acc * XXH_PRIME64_1;
+}
+
+static inline uint64_t xxh_merge_round (uint64_t acc, uint64_t val) {
+  acc ^= xxh_round (0, val);
+  return acc * XXH_PRIME64_1 + XXH_PRIME64_4;
+}
+
+/* xxHash64 (seed 0). the input is read as little-endian words as on the
+ * platforms hio supports */
+uint64_t hioi_hash64 (const void *buf, size_t length) {
+  const uint8_t *p = (const uint8_t *) buf, *end = p + length;
+  uint64_t h;
+
+  if (length >= 32) {
+    const uint8_t *limit = end - 32;
+    uint64_t v1 = XXH_PRIME64_1 + XXH_PRIME64_2, v2 = XXH_PRIME64_2, v3 = 0, v4 = -XXH_PRIME64_1;
+
+    do {
+      v1 = xxh_round (v1, xxh_read64 (p));
+      v2 = xxh_round (v2, xxh_read64 (p + 8));
+      v3 = xxh_round (v3, xxh_read64 (p + 16));
+      v4 = xxh_round (v4, xxh_read64 (p + 24));
+      p += 32;
+    } while (p <= limit);
+
+    h = xxh_rotl64 (v1, 1) + xxh_rotl64 (v2, 7) + xxh_rotl64 (v3, 12) + xxh_rotl64 (v4, 18);
+    h = xxh_merge_round (h, v1);
+    h = xxh_merge_round (h, v2);
+    h = xxh_merge_round (h, v3);
+    h = xxh_merge_round (h, v4);
+  } else {
+    h = XXH_PRIME64_5;
+  }
+
+  h += (uint64_t) length;
+
+  for ( ; p + 8 <= end ; p += 8) {
+    h ^= xxh_round (0, xxh_read64 (p));
+    h = xxh_rotl64 (h, 27) * XXH_PRIME64_1 + XXH_PRIME64_4;
+  }
+
+  if (p + 4 <= end) {
+    h ^= (uint64_t) xxh_read32 (p) * XXH_PRIME64_1;
+    h = xxh_rotl64 (h, 23) * XXH_PRIME64_2 + XXH_PRIME64_3;
+    p += 4;
+  }
+
+  for ( ; p < end ; ++p) {
+    h ^= (*p) * XXH_PRIME64_5;
+    h = xxh_rotl64 (h, 11) * XXH_PRIME64_1;
+  }
+
+  h ^= h >> 33;
+  h *= XXH_PRIME64_2;
+  h ^= h >> 29;
+  h *= XXH_PRIME64_3;
+  h ^= h >> 32;
+
+  return h;
+}
@@ -82,11 +82,15 @@ static void hioi_dataset_release (hio_object_t object) {
     hioi_list_remove(element, e_list);
     hioi_object_release (&element->e_object);
   }
+
+  pthread_mutex_destroy (&dataset->ds_buffer.b_lock);
+  free (dataset->ds_refs);
 }
 
 hio_dataset_t hioi_dataset_alloc (hio_context_t context, const char *name, int64_t id,
                                   int flags, hio_dataset_mode_t mode) {
   size_t dataset_size = context->c_ds_size;
+  pthread_mutexattr_t mutex_attr;
   hio_dataset_t new_dataset;
   int rc;
 
@@ -100,6 +104,11 @@ hio_dataset_t hioi_dataset_alloc (hio_context_t context, const char *name, int64
     return NULL;
   }
 
+  pthread_mutexattr_init (&mutex_attr);
+  pthread_mutexattr_settype (&mutex_attr, PTHREAD_MUTEX_RECURSIVE);
+  pthread_mutex_init (&new_dataset->ds_buffer.b_lock, &mutex_attr);
+  pthread_mutexattr_destroy (&mutex_attr);
+
   /* initialize counters */
   atomic_init (&new_dataset->ds_stat.s_wcount, 0);
   atomic_init (&new_dataset->ds_stat.s_rcount, 0);
@@ -129,9 +138,11 @@ hio_dataset_t hioi_dataset_alloc (hio_context_t context, const char *name, int64
                    "dataset_filesystem_type", HIO_CONFIG_TYPE_INT32, &hioi_dataset_fs_type_enum,
                    "Type of filesystem this dataset resides on", HIO_VAR_FLAG_READONLY);
 
-  hioi_config_add (context, &new_dataset->ds_object, &new_dataset->ds_data->dd_average_size,
+  /* an explicitly set size is never replaced by the running average (see hio_dataset_close) */
+  new_dataset->ds_expected_size = new_dataset->ds_data->dd_average_size;
+  hioi_config_add (context, &new_dataset->ds_object, &new_dataset->ds_expected_size,
                    "dataset_expected_size", HIO_CONFIG_TYPE_INT64, NULL,
-                   "Expected global size of this dataset", 0);
+                   "Expected global size of this dataset (default: average size of previous members)", 0);
 
   /* default to a megabyte for the buffer size */
   new_dataset->ds_buffer_size = 1 << 20;
@@ -139,6 +150,18 @@ hio_dataset_t hioi_dataset_alloc (hio_context_t context, const char *name, int64
                    "dataset_buffer_size", HIO_CONFIG_TYPE_INT64, NULL,
                    "Buffer size to use for aggregating read and write operations", 0);
 
+  new_dataset->ds_read_aggregate = false;
+  hioi_config_add (context, &new_dataset->ds_object, &new_dataset->ds_read_aggregate,
+                   "dataset_read_aggregate", HIO_CONFIG_TYPE_BOOL, NULL,
+                   "Queue non-blocking reads and coalesce nearby reads when they are completed", 0);
+
+  new_dataset->ds_read_gap = 16384;
+  hioi_config_add (context, &new_dataset->ds_object, &new_dataset->ds_read_gap,
+                   "dataset_read_aggregate_gap", HIO_CONFIG_TYPE_UINT64, NULL,
+                   "Largest gap in bytes between queued reads that are coalesced into one read", 0);
+
+  hioi_list_init (new_dataset->ds_rqueue);
+
   /* set up performance variables */
   hioi_perf_add (context, &new_dataset->ds_object, &new_dataset->ds_stat.s_bread, "bytes_read",
                  HIO_CONFIG_TYPE_UINT64, NULL, "Total number of bytes read in this dataset instance", 0);
@@ -146,6 +169,13 @@ hio_dataset_t hioi_dataset_alloc (hio_context_t context, const char *name, int64
   hioi_perf_add (context, &new_dataset->ds_object, &new_dataset->ds_stat.s_bwritten, "bytes_written",
                  HIO_CONFIG_TYPE_UINT64, NULL, "Total number of bytes written in this dataset instance", 0);
 
+  hioi_perf_add (context, &new_dataset->ds_object, &new_dataset->ds_reads_coalesced, "reads_coalesced",
+                 HIO_CONFIG_TYPE_UINT64, NULL, "Number of queued reads serviced by a coalesced read", 0);
+
+  hioi_perf_add (context, &new_dataset->ds_object, &new_dataset->ds_segments_merged, "segments_merged",
+                 HIO_CONFIG_TYPE_UINT64, NULL, "Number of element segments removed by merging contiguous segments "
+                 "before the manifest was written", 0);
+
   hioi_list_init (new_dataset->ds_elist);
 
   return new_dataset;
@@ -155,6 +185,30 @@ void hioi_dataset_add_element (hio_dataset_t dataset, hio_element_t element) {
   hioi_list_append (element, dataset->ds_elist, e_list);
 }
 
+int hioi_dataset_compact_segments (hio_dataset_t dataset) {
+  hio_context_t context = hioi_object_context (&dataset->ds_object);
+  uint64_t total = 0, removed = 0, merged;
+  hio_element_t element;
+  int rc;
+
+  hioi_list_foreach (element, dataset->ds_elist, struct hio_element, e_list) {
+    total += element->e_segments.si_count;
+    rc = hioi_element_compact_segments (element, &merged);
+    if (HIO_SUCCESS != rc) {
+      return rc;
+    }
+
+    removed += merged;
+  }
+
+  dataset->ds_segments_merged += removed;
+
+  hioi_log (context, HIO_VERBOSE_DEBUG_LOW, "dataset %s::%" PRIu64 ": compacted %" PRIu64 " element segments. "
+            "removed %" PRIu64, hioi_object_identifier (dataset), dataset->ds_id, total, removed);
+
+  return HIO_SUCCESS;
+}
+
 hio_dataset_backend_data_t *hioi_dbd_alloc (hio_dataset_data_t *data, const char *backend_name, size_t size) {
   hio_dataset_backend_data_t *new_backend_data;
 
@@ -446,6 +500,22 @@ int hioi_dataset_open_internal (hio_module_t *module, hio_dataset_t dataset) {
     return rc;
   }
 
+  /* the buffer arena is needed for deferred writes even if no shared buffer was allocated */
+  rc = hioi_dataset_buffer_init (dataset);
+  if (HIO_SUCCESS != rc) {
+    (void) dataset->ds_close (dataset);
+    return rc;
+  }
+
+  if (!(dataset->ds_flags & HIO_FLAG_WRITE)) {
+    hio_element_t element;
+
+    /* the segments of a read-only dataset do not change after the manifest is loaded */
+    hioi_list_foreach (element, dataset->ds_elist, struct hio_element, e_list) {
+      (void) hioi_element_freeze_segments (element);
+    }
+  }
+
   dataset->ds_rotime = rotime;
 
   return HIO_SUCCESS;
@@ -456,6 +526,9 @@ int hioi_dataset_close_internal (hio_dataset_t dataset) {
   hio_element_t element;
   int rc;
 
+  /* complete any outstanding non-blocking requests (errors are reported by the module close) */
+  (void) hioi_worker_drain (dataset);
+
   /* close any open elements */
   hioi_list_foreach(element, dataset->ds_elist, struct hio_element, e_list) {
     if (element->e_open_count) {
@@ -469,5 +542,7 @@ int hioi_dataset_close_internal (hio_dataset_t dataset) {
 
   rc = dataset->ds_close (dataset);
 
+  hioi_dataset_buffer_fini (dataset);
+
   return rc;
 }
@@ -12,62 +12,346 @@
 #include "hio_internal.h"
 #include <stdlib.h>
 #include <string.h>
+#include <sched.h>
 
-static int request_compare (const void *a, const void *b) {
-  const hio_internal_request_t **reqa = (const hio_internal_request_t **) a;
-  const hio_internal_request_t **reqb = (const hio_internal_request_t **) b;
+/* radix sort keys. requests are sorted by element then by application offset */
+static inline uint64_t hioi_request_key (const hio_internal_request_t *req, int key) {
+  return key ? (uint64_t) (intptr_t) req->ir_element : (uint64_t) req->ir_offset;
+}
+
+static bool hioi_requests_sorted (hio_internal_request_t **reqs, int count) {
+  for (int i = 1 ; i < count ; ++i) {
+    if (reqs[i]->ir_element < reqs[i - 1]->ir_element || (reqs[i]->ir_element == reqs[i - 1]->ir_element &&
+                                                          reqs[i]->ir_offset < reqs[i - 1]->ir_offset)) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+void hioi_dataset_sort_requests (hio_internal_request_t **reqs, int count, hio_internal_request_t **scratch) {
+  hio_internal_request_t **src = reqs, **dst = scratch, **tmp;
+  uint64_t varying[2];
+
+  if (hioi_requests_sorted (reqs, count)) {
+    /* common case of a single writer appending in order */
+    return;
+  }
+
+  /* find the key bytes that differ between requests. the other bytes do not need a pass */
+  for (int key = 0 ; key < 2 ; ++key) {
+    uint64_t all_or = 0, all_and = ~(uint64_t) 0;
+
+    for (int i = 0 ; i < count ; ++i) {
+      all_or |= hioi_request_key (reqs[i], key);
+      all_and &= hioi_request_key (reqs[i], key);
+    }
 
-  /* sort by element then by application offset */
-  if (reqa[0]->ir_element > reqb[0]->ir_element) {
-    return 1;
-  } else if (reqa[0]->ir_element < reqb[0]->ir_element) {
-    return -1;
+    varying[key] = all_or ^ all_and;
   }
 
-  if (reqa[0]->ir_offset > reqb[0]->ir_offset) {
-    return 1;
+  /* stable least significant digit radix sort. requests with the same element and offset
+   * stay in the order they were recorded */
+  for (int key = 0 ; key < 2 ; ++key) {
+    for (int shift = 0 ; shift < 64 ; shift += 8) {
+      int counts[256] = {0}, position = 0;
+
+      if (0 == ((varying[key] >> shift) & 0xff)) {
+        continue;
+      }
+
+      for (int i = 0 ; i < count ; ++i) {
+        ++counts[(hioi_request_key (src[i], key) >> shift) & 0xff];
+      }
+
+      for (int i = 0 ; i < 256 ; ++i) {
+        int tmp_count = counts[i];
+        counts[i] = position;
+        position += tmp_count;
+      }
+
+      for (int i = 0 ; i < count ; ++i) {
+        dst[counts[(hioi_request_key (src[i], key) >> shift) & 0xff]++] = src[i];
+      }
+
+      tmp = src;
+      src = dst;
+      dst = tmp;
+    }
+  }
+
+  if (src != reqs) {
+    memcpy (reqs, src, count * sizeof (*reqs));
+  }
+}
+
+int hioi_dataset_merge_writes (hio_internal_request_t **reqs, int count, struct iovec *iov) {
+  int nmerged = 0, iovcnt = 0;
+
+  for (int i = 0, next ; i < count ; i = next) {
+    hio_internal_request_t *req = reqs[i];
+    int first_iov = iovcnt;
+
+    for (next = i + 1 ; next < count ; ++next) {
+      hio_internal_request_t *prev = reqs[next - 1];
+
+      if (reqs[next]->ir_element != req->ir_element || reqs[next]->ir_iov || prev->ir_iov ||
+          1 != prev->ir_count || 1 != reqs[next]->ir_count ||
+          reqs[next]->ir_offset != prev->ir_offset + (off_t) prev->ir_size) {
+        break;
+      }
+    }
+
+    if (next - i > 1) {
+      size_t size = 0;
+
+      for (int j = i ; j < next ; ++j) {
+        if (iovcnt > first_iov && (intptr_t) iov[iovcnt - 1].iov_base + iov[iovcnt - 1].iov_len ==
+            (intptr_t) reqs[j]->ir_data.w) {
+          /* the data of this request directly follows the data of the previous one */
+          iov[iovcnt - 1].iov_len += reqs[j]->ir_size;
+        } else {
+          iov[iovcnt].iov_base = (void *) reqs[j]->ir_data.w;
+          iov[iovcnt++].iov_len = reqs[j]->ir_size;
+        }
+
+        size += reqs[j]->ir_size;
+      }
+
+      if (iovcnt - first_iov > 1) {
+        req->ir_iov = iov + first_iov;
+        req->ir_iovcnt = iovcnt - first_iov;
+      }
+
+      req->ir_size = size;
+    }
+
+    reqs[nmerged++] = req;
   }
 
-  return -1;
+  return nmerged;
 }
 
 int hioi_dataset_buffer_flush (hio_dataset_t dataset) {
+  hio_buffer_t *buffer = &dataset->ds_buffer;
+  hio_internal_request_t **reqs = buffer->b_sorted;
+  int rc = HIO_SUCCESS, count, nmerged;
+
+  pthread_mutex_lock (&buffer->b_lock);
+
+  /* stop new appends and wait for the appends in progress to finish */
+  atomic_store (&buffer->b_closed, 1);
+  while (atomic_load (&buffer->b_active)) {
+    sched_yield ();
+  }
+
+  count = min(atomic_load (&buffer->b_nslots), buffer->b_max_slots);
+  if (count) {
+    for (int i = 0 ; i < count ; ++i) {
+      reqs[i] = buffer->b_slots + i;
+    }
+
+    /* sort the requests and merge writes that are contiguous in the element (possibly
+     * written by different threads) before passing them off to the backend */
+    hioi_dataset_sort_requests (reqs, count, buffer->b_scratch);
+    nmerged = hioi_dataset_merge_writes (reqs, count, buffer->b_merge_iov);
+
+    if (dataset->ds_flush_reqs) {
+      rc = dataset->ds_flush_reqs (dataset, reqs, nmerged);
+    } else {
+      rc = dataset->ds_process_reqs (dataset, reqs, nmerged);
+    }
+
+    /* add buffering time to the overall write time */
+    hioi_object_lock (&dataset->ds_object);
+    dataset->ds_stat.s_wtime += atomic_load (&buffer->b_time);
+    hioi_object_unlock (&dataset->ds_object);
+  }
+
+  /* reset the arena */
+  buffer->b_deferred = NULL;
+  buffer->b_niov = 0;
+  atomic_store (&buffer->b_time, 0);
+  atomic_store (&buffer->b_reserved, 0);
+  atomic_store (&buffer->b_nslots, 0);
+  atomic_store (&buffer->b_closed, 0);
+  pthread_mutex_unlock (&buffer->b_lock);
+
+  return rc;
+}
+
+int hioi_dataset_buffer_init (hio_dataset_t dataset) {
+  hio_buffer_t *buffer = &dataset->ds_buffer;
+  unsigned long max_slots;
+  size_t arena_size;
+  void *arena;
+
+  /* one request slot for every 256 bytes of buffer. writes that find no free slot
+   * flush the buffer */
+  max_slots = max(dataset->ds_buffer_size >> 8, 64);
+  arena_size = max_slots * (sizeof (buffer->b_slots[0]) + 2 * sizeof (buffer->b_sorted[0]) +
+                            2 * sizeof (buffer->b_iov[0]));
+
+  arena = malloc (arena_size);
+  if (NULL == arena) {
+    return HIO_ERR_OUT_OF_RESOURCE;
+  }
+
+  buffer->b_slots = (hio_internal_request_t *) arena;
+  buffer->b_iov = (struct iovec *) (buffer->b_slots + max_slots);
+  buffer->b_merge_iov = buffer->b_iov + max_slots;
+  buffer->b_sorted = (hio_internal_request_t **) (buffer->b_merge_iov + max_slots);
+  buffer->b_scratch = buffer->b_sorted + max_slots;
+  buffer->b_max_slots = max_slots;
+  buffer->b_deferred = NULL;
+  buffer->b_niov = 0;
+
+  atomic_init (&buffer->b_reserved, 0);
+  atomic_init (&buffer->b_nslots, 0);
+  atomic_init (&buffer->b_active, 0);
+  atomic_init (&buffer->b_closed, 0);
+  atomic_init (&buffer->b_time, 0);
+
+  return HIO_SUCCESS;
+}
+
+void hioi_dataset_buffer_fini (hio_dataset_t dataset) {
+  free (dataset->ds_buffer.b_slots);
+  dataset->ds_buffer.b_slots = NULL;
+  dataset->ds_buffer.b_max_slots = 0;
+}
+
+/* copy the part of a coalesced read covered by req to the user buffer of req */
+static void hioi_read_scatter (hio_internal_request_t *req, const void *data) {
+  size_t step = req->ir_stride ? req->ir_size + req->ir_stride : req->ir_size;
+
+  for (size_t i = 0 ; i < req->ir_count ; ++i) {
+    memcpy ((void *)((intptr_t) req->ir_data.r + i * step), (const void *)((intptr_t) data + i * req->ir_size),
+            req->ir_size);
+  }
+}
+
+/**
+ * Service runs of sorted reads that are at most gap bytes apart with single reads
+ *
+ * If a coalesced read comes up short (holes in the element, end of the element) the
+ * run is retried with only adjacent or overlapping reads coalesced and finally with
+ * each read on its own to get the correct status for each request.
+ */
+static void hioi_dataset_read_runs (hio_dataset_t dataset, hio_internal_request_t **reqs, int count, uint64_t gap,
+                                    void *staging) {
+  uint64_t limit = dataset->ds_buffer_size;
+  hio_internal_request_t *req, merged;
+
+  for (int first = 0, last ; first < count ; first = last + 1) {
+    uint64_t start = reqs[first]->ir_offset, end = start + reqs[first]->ir_count * reqs[first]->ir_size;
+
+    /* find the reads that can be serviced by a single read of the element */
+    for (last = first ; last + 1 < count ; ++last) {
+      hio_internal_request_t *cand = reqs[last + 1];
+      uint64_t cand_end = cand->ir_offset + cand->ir_count * cand->ir_size;
+
+      if (cand->ir_element != reqs[first]->ir_element || cand->ir_offset > end + gap ||
+          max(end, cand_end) - start > limit) {
+        break;
+      }
+
+      end = max(end, cand_end);
+    }
+
+    if (first != last && NULL != staging) {
+      merged = *reqs[first];
+      merged.ir_offset = start;
+      merged.ir_data.r = staging;
+      merged.ir_count = 1;
+      merged.ir_size = end - start;
+      merged.ir_stride = 0;
+      merged.ir_urequest = NULL;
+
+      req = &merged;
+      (void) dataset->ds_process_reqs (dataset, &req, 1);
+      if (merged.ir_status == (int) (end - start)) {
+        for (int j = first ; j <= last ; ++j) {
+          hioi_read_scatter (reqs[j], (void *)((intptr_t) staging + reqs[j]->ir_offset - start));
+          reqs[j]->ir_status = reqs[j]->ir_count * reqs[j]->ir_size;
+        }
+
+        hioi_object_lock (&dataset->ds_object);
+        dataset->ds_reads_coalesced += last - first + 1;
+        hioi_object_unlock (&dataset->ds_object);
+        continue;
+      }
+
+      if (gap) {
+        hioi_dataset_read_runs (dataset, reqs + first, last - first + 1, 0, staging);
+        continue;
+      }
+    }
+
+    for (int j = first ; j <= last ; ++j) {
+      (void) dataset->ds_process_reqs (dataset, reqs + j, 1);
+    }
+  }
+}
+
+void hioi_dataset_process_reads (hio_dataset_t dataset, hio_internal_request_t **reqs, int count,
+                                 hio_internal_request_t **scratch) {
+  void *staging = NULL;
+
+  /* the backing files of an element are laid out in element offset order so this
+   * also sorts the reads by file and offset */
+  hioi_dataset_sort_requests (reqs, count, scratch);
+
+  if (count > 1) {
+    /* reads are not coalesced if the staging buffer can not be allocated */
+    staging = malloc (dataset->ds_buffer_size);
+  }
+
+  hioi_dataset_read_runs (dataset, reqs, count, dataset->ds_read_gap, staging);
+
+  free (staging);
+}
+
+int hioi_dataset_read_flush (hio_dataset_t dataset) {
   hio_internal_request_t **reqs, *req, *next;
-  int rc;
+  int count, i = 0;
 
-  if (0 == dataset->ds_buffer.b_reqcount) {
+  pthread_mutex_lock (&dataset->ds_buffer.b_lock);
+  count = dataset->ds_rqueue_count;
+  if (0 == count) {
     /* nothing to do */
+    pthread_mutex_unlock (&dataset->ds_buffer.b_lock);
     return HIO_SUCCESS;
   }
 
-  reqs = malloc (sizeof (*reqs) * dataset->ds_buffer.b_reqcount);
+  /* the second half of the array is sort scratch space */
+  reqs = malloc (2 * sizeof (*reqs) * count);
   if (NULL == reqs) {
+    pthread_mutex_unlock (&dataset->ds_buffer.b_lock);
     return HIO_ERR_OUT_OF_RESOURCE;
   }
 
-  /* sort the request list and pass it off to the backend */
-  int i = 0;
-  hioi_list_foreach_safe(req, next, dataset->ds_buffer.b_reqlist, hio_internal_request_t, ir_list) {
+  hioi_list_foreach_safe(req, next, dataset->ds_rqueue, hio_internal_request_t, ir_list) {
     reqs[i++] = req;
     hioi_list_remove (req, ir_list);
   }
 
-  qsort ((void *) reqs, dataset->ds_buffer.b_reqcount, sizeof (*reqs), request_compare);
+  dataset->ds_rqueue_count = 0;
+  /* reads are issued without the buffer lock so other threads can keep queueing */
+  pthread_mutex_unlock (&dataset->ds_buffer.b_lock);
 
-  rc = dataset->ds_process_reqs (dataset, reqs, dataset->ds_buffer.b_reqcount);
+  hioi_dataset_process_reads (dataset, reqs, count, reqs + count);
 
-  /* NTH: this is temporary code to plug a leak until better code is ready */
-  for (i = 0 ; i < dataset->ds_buffer.b_reqcount ; ++i) {
+  hioi_worker_complete_requests (dataset, reqs, count);
+
+  for (i = 0 ; i < count ; ++i) {
     free (reqs[i]);
   }
 
   free (reqs);
-  /* end temporary code */
-
-  dataset->ds_buffer.b_reqcount = 0;
-  dataset->ds_buffer.b_remaining = dataset->ds_buffer.b_size;
 
-  return rc;
+  return HIO_SUCCESS;
 }
 
 #if HIO_MPI_HAVE(3)
@@ -75,6 +359,7 @@ int hioi_dataset_buffer_flush (hio_dataset_t dataset) {
 int hioi_dataset_shared_init (hio_dataset_t dataset, int stripes) {
   hio_context_t context = hioi_object_context (&dataset->ds_object);
   size_t ds_buffer_size = dataset->ds_buffer_size;
+  size_t buffer_align = max(dataset->ds_buffer_align, 128);
   size_t control_block_size;
   MPI_Win shared_win;
   MPI_Aint data_size;
@@ -87,7 +372,14 @@ int hioi_dataset_shared_init (hio_dataset_t dataset, int stripes) {
 
   /* ensure data block starts on a cache line boundary */
   control_block_size = (sizeof (hio_shared_control_t) + stripes * sizeof (dataset->ds_shared_control->s_stripes[0]) + 127) & ~127;
+
+  /* keep the buffer a multiple of the alignment. the window base is not guaranteed to be aligned
+   * beyond a cache line so allocate enough extra space to align the start of the buffer */
+  ds_buffer_size &= ~(buffer_align - 1);
   data_size = ds_buffer_size + control_block_size * (0 == context->c_shared_rank);
+  if (ds_buffer_size && buffer_align > 128) {
+    data_size += buffer_align;
+  }
 
   rc = MPI_Win_allocate_shared (data_size, 1, MPI_INFO_NULL,
                                 context->c_shared_comm, &base, &shared_win);
@@ -113,6 +405,10 @@ int hioi_dataset_shared_init (hio_dataset_t dataset, int stripes) {
       atomic_init (&dataset->ds_shared_control->s_stripes[i].s_index, 0);
     }
 
+    for (int i = 0 ; i < HIO_SHARED_PACK_CLASSES ; ++i) {
+      pthread_mutex_init (&dataset->ds_shared_control->s_pack[i].p_mutex, &mutex_attr);
+    }
+
     pthread_mutexattr_destroy (&mutex_attr);
     /* master base follows the control block */
     dataset->ds_buffer.b_base = (void *)((intptr_t) base + control_block_size);
@@ -120,10 +416,10 @@ int hioi_dataset_shared_init (hio_dataset_t dataset, int stripes) {
     dataset->ds_buffer.b_base = base;
   }
 
+  dataset->ds_buffer.b_base = (void *)(((intptr_t) dataset->ds_buffer.b_base + buffer_align - 1) &
+                                       ~(intptr_t) (buffer_align - 1));
+
   dataset->ds_buffer.b_size = ds_buffer_size;
-  dataset->ds_buffer.b_remaining = ds_buffer_size;
-  dataset->ds_buffer.b_reqcount = 0;
-  hioi_list_init (dataset->ds_buffer.b_reqlist);
 
   rc = MPI_Win_shared_query (shared_win, 0, &data_size, &disp_unit, &base);
   if (MPI_SUCCESS != rc) {
@@ -142,6 +438,10 @@ int hioi_dataset_shared_init (hio_dataset_t dataset, int stripes) {
 
 int hioi_dataset_shared_fini (hio_dataset_t dataset) {
   hio_context_t context = hioi_object_context (&dataset->ds_object);
+
+  /* the buffer is part of the shared memory window */
+  dataset->ds_buffer.b_size = 0;
+
   if (hioi_context_using_mpi (context)) {
     if (MPI_WIN_NULL == dataset->ds_shared_win) {
       return HIO_SUCCESS;
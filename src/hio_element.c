@@ -19,7 +19,11 @@
 static void hioi_element_release (hio_object_t object) {
   hio_element_t element = (hio_element_t) object;
 
+  hioi_file_fini (&element->e_file);
+  hioi_segment_index_fini (&element->e_segments);
   free (element->e_sarray);
+  free (element->e_zbuf);
+  pthread_mutex_destroy (&element->e_crc_lock);
 }
 
 hio_element_t hioi_element_alloc (hio_dataset_t dataset, const char *name, const int rank) {
@@ -32,7 +36,9 @@ hio_element_t hioi_element_alloc (hio_dataset_t dataset, const char *name, const
   }
 
   element->e_rank = rank;
-  element->e_file.f_fd = -1;
+  hioi_file_init (&element->e_file);
+  hioi_segment_index_init (&element->e_segments);
+  pthread_mutex_init (&element->e_crc_lock, NULL);
   element->e_index = -1;
 
   return element;
@@ -94,7 +100,12 @@ int hioi_element_open_internal (hio_dataset_t dataset, hio_element_t *element_ou
 
 int hioi_element_close_internal (hio_element_t element) {
   hio_dataset_t dataset = hioi_element_dataset (element);
-  int rc = HIO_SUCCESS;
+  int rc = HIO_SUCCESS, drain_rc = HIO_SUCCESS;
+
+  if (1 == element->e_open_count) {
+    /* the element can not be closed while requests may still reference it */
+    drain_rc = hioi_worker_drain (dataset);
+  }
 
   hioi_object_lock (&dataset->ds_object);
   if (0 == --element->e_open_count && hioi_dataset_doing_io (dataset)) {
@@ -114,24 +125,7 @@ int hioi_element_close_internal (hio_element_t element) {
   }
   hioi_object_unlock (&dataset->ds_object);
 
-  return rc;
-}
-
-static int hioi_element_segment_compare (const void *key, const void *value) {
-  hio_manifest_segment_t *segment = (hio_manifest_segment_t *) value;
-  uint64_t offset = (intptr_t) key;
-  uint64_t base, bound;
-
-  base = segment->seg_offset;
-  bound = base + segment->seg_length;
-
-  if (offset < base) {
-    return -1;
-  } else if (offset > bound) {
-    return 1;
-  }
-
-  return 0;
+  return (HIO_SUCCESS == rc) ? drain_rc : rc;
 }
 
 /**
@@ -149,70 +143,251 @@ static int hioi_element_segment_compare (const void *key, const void *value) {
  */
 int hioi_element_add_segment (hio_element_t element, int file_index, uint64_t file_offset, uint64_t app_offset,
                               size_t seg_length) {
-  hio_manifest_segment_t *segment = NULL;
-  int seg_index = 0;
-  void *tmp;
+  hio_manifest_segment_t segment = {.seg_offset = app_offset, .seg_length = seg_length, .seg_foffset = file_offset,
+                                    .seg_file_index = file_index, .seg_codec = HIO_CODEC_NONE};
+
+  return hioi_element_insert_segment (element, &segment);
+}
+
+/* drop the cached segment data (see builtin_posix_element_read_segment). called with the element lock held */
+static void hioi_element_invalidate_cache (hio_element_t element) {
+  free (element->e_zbuf);
+  element->e_zbuf = NULL;
+  ++element->e_zgen;
+}
+
+/* plain segments can be merged if next continues prev in both the element and the same logical file */
+static bool hioi_element_segments_contiguous (const hio_manifest_segment_t *prev, const hio_manifest_segment_t *next) {
+  return prev->seg_offset + prev->seg_length == next->seg_offset &&
+    prev->seg_foffset + prev->seg_length == next->seg_foffset && prev->seg_file_index == next->seg_file_index &&
+    HIO_CODEC_NONE == prev->seg_codec && !prev->seg_has_crc && !prev->seg_crc_pending && !prev->seg_has_hash &&
+    !prev->seg_is_ref && HIO_CODEC_NONE == next->seg_codec && !next->seg_has_crc && !next->seg_crc_pending &&
+    !next->seg_has_hash && !next->seg_is_ref;
+}
+
+/**
+ * Add a segment descriptor with all attributes to an element
+ *
+ * @param[in] element hio element handle
+ * @param[in] new_segment segment to add (copied)
+ *
+ * Plain segments that continue an existing segment in both the element and
+ * the file are merged with it. Compressed, checksummed, hashed, or referenced
+ * segments are never merged with their neighbors as each describes a unit.
+ */
+int hioi_element_insert_segment (hio_element_t element, const hio_manifest_segment_t *new_segment) {
+  uint64_t app_offset = new_segment->seg_offset;
+  hio_manifest_segment_t segment, *prev;
+  int rc;
+
+  assert (new_segment->seg_length > 0 && !element->e_frozen);
 
   hioi_object_lock (&element->e_object);
 
-  if (element->e_sarray) {
-    unsigned long last_offset, last_file_offset;
+  element->e_sarray_valid = false;
+  hioi_element_invalidate_cache (element);
 
-    segment = (hio_manifest_segment_t *) bsearch ((void *) (intptr_t) app_offset, element->e_sarray,
-                                                  element->e_scount, sizeof (element->e_sarray[0]),
-                                                  hioi_element_segment_compare);
-    if (segment) {
-      last_offset = segment->seg_offset + segment->seg_length;
-      last_file_offset = segment->seg_foffset + segment->seg_length;
+  prev = hioi_segment_index_find (&element->e_segments, app_offset);
+  if (prev && hioi_element_segments_contiguous (prev, new_segment)) {
+    prev->seg_length += new_segment->seg_length;
+    hioi_object_unlock (&element->e_object);
+    return HIO_SUCCESS;
+  }
 
-      /* in order to match this segment must fall in the same logical file and have both file and applications
-       * offsets that immediately follow the existing segment */
-      if (last_offset == app_offset && last_file_offset == file_offset && segment->seg_file_index == file_index) {
-        segment->seg_length += seg_length;
+  segment = *new_segment;
+  if (HIO_CODEC_NONE == segment.seg_codec) {
+    segment.seg_clength = 0;
+  }
+
+  rc = hioi_segment_index_insert (&element->e_segments, &segment);
+
+  hioi_object_unlock (&element->e_object);
+
+  return rc;
+}
+
+hio_manifest_segment_t *hioi_element_segments (hio_element_t element) {
+  size_t count;
+
+  hioi_object_lock (&element->e_object);
+
+  count = element->e_segments.si_count;
+  if (!element->e_sarray_valid && count) {
+    if (count > element->e_ssize) {
+      void *tmp = realloc (element->e_sarray, count * sizeof (element->e_sarray[0]));
+      if (NULL == tmp) {
         hioi_object_unlock (&element->e_object);
-        return HIO_SUCCESS;
+        return NULL;
       }
+
+      element->e_sarray = (hio_manifest_segment_t *) tmp;
+      element->e_ssize = count;
     }
+
+    hioi_segment_index_export (&element->e_segments, element->e_sarray);
+    element->e_sarray_valid = true;
   }
 
-  assert (0 == element->e_scount || element->e_sarray);
+  hioi_object_unlock (&element->e_object);
 
-  for (seg_index = 0 ; seg_index < element->e_scount ; ++seg_index) {
-    segment = element->e_sarray + seg_index;
-    if (segment->seg_offset > app_offset) {
-      break;
+  return element->e_sarray;
+}
+
+/**
+ * Merge neighboring element segments
+ *
+ * @param[in]  element hio element handle
+ * @param[out] merged  number of segments removed
+ *
+ * Segments are only merged as they are added if they continue the segment
+ * before them. Segments that fill a hole are not merged with the segment
+ * that follows. This pass merges every pair of plain segments that is
+ * contiguous in both the element and the file and rebuilds the index.
+ */
+int hioi_element_compact_segments (hio_element_t element, uint64_t *merged) {
+  hio_manifest_segment_t *segments;
+  size_t count, new_count = 0;
+  int rc = HIO_SUCCESS;
+
+  *merged = 0;
+
+  hioi_object_lock (&element->e_object);
+
+  count = element->e_segments.si_count;
+  if (count < 2) {
+    hioi_object_unlock (&element->e_object);
+    return HIO_SUCCESS;
+  }
+
+  segments = hioi_element_segments (element);
+  if (NULL == segments) {
+    hioi_object_unlock (&element->e_object);
+    return HIO_ERR_OUT_OF_RESOURCE;
+  }
+
+  for (size_t i = 1 ; i < count ; ++i) {
+    if (hioi_element_segments_contiguous (segments + new_count, segments + i)) {
+      segments[new_count].seg_length += segments[i].seg_length;
+    } else {
+      segments[++new_count] = segments[i];
     }
   }
 
-  if (element->e_scount == element->e_ssize) {
-    element->e_ssize += 32;
-    tmp = realloc (element->e_sarray, element->e_ssize * sizeof (element->e_sarray[0]));
-    if (NULL == tmp) {
-      return HIO_ERR_OUT_OF_RESOURCE;
+  ++new_count;
+
+  if (new_count < count) {
+    /* segments are reinserted in order so the leaves of the new index are full */
+    hioi_segment_index_fini (&element->e_segments);
+    for (size_t i = 0 ; i < new_count && HIO_SUCCESS == rc ; ++i) {
+      rc = hioi_segment_index_insert (&element->e_segments, segments + i);
     }
 
-    element->e_sarray = (hio_manifest_segment_t *) tmp;
+    /* the cached array now matches the index */
+    element->e_sarray_valid = HIO_SUCCESS == rc;
+    *merged = count - new_count;
   }
 
-  assert (element->e_sarray);
+  hioi_object_unlock (&element->e_object);
+
+  return rc;
+}
 
-  segment = element->e_sarray + seg_index;
-  if (element->e_scount != seg_index) {
-    memmove (element->e_sarray + seg_index + 1, segment, sizeof (element->e_sarray[0]) * (element->e_scount - seg_index));
+int hioi_element_freeze_segments (hio_element_t element) {
+  if (element->e_segments.si_count && NULL == hioi_element_segments (element)) {
+    /* lookups will continue to use the segment index */
+    return HIO_ERR_OUT_OF_RESOURCE;
   }
 
-  segment->seg_foffset = (uint64_t) file_offset;
-  segment->seg_offset = app_offset;
-  segment->seg_length = seg_length;
-  segment->seg_file_index = file_index;
+  element->e_frozen = true;
+
+  return HIO_SUCCESS;
+}
+
+/* last frozen segment found by this thread. sequential readers usually need the same
+ * segment or the one after it again */
+static __thread struct {
+  hio_element_t element;
+  size_t index;
+} hioi_element_last_hit;
+
+/* lock-free equivalent of hioi_segment_index_find() for frozen elements */
+static hio_manifest_segment_t *hioi_element_frozen_find (hio_element_t element, uint64_t app_offset) {
+  hio_manifest_segment_t *segments = element->e_sarray;
+  size_t count = element->e_segments.si_count, low = 0, high = count;
+
+  if (hioi_element_last_hit.element == element) {
+    for (size_t i = hioi_element_last_hit.index ; i < count && i <= hioi_element_last_hit.index + 1 ; ++i) {
+      if (segments[i].seg_offset <= app_offset && (i + 1 == count || segments[i + 1].seg_offset > app_offset)) {
+        hioi_element_last_hit.index = i;
+        return segments + i;
+      }
+    }
+  }
+
+  while (low < high) {
+    size_t mid = (low + high) / 2;
+
+    if (segments[mid].seg_offset > app_offset) {
+      high = mid;
+    } else {
+      low = mid + 1;
+    }
+  }
+
+  if (0 == low) {
+    return NULL;
+  }
+
+  hioi_element_last_hit.element = element;
+  hioi_element_last_hit.index = low - 1;
+
+  return segments + low - 1;
+}
+
+/**
+ * Set the checksum of the data written to an element range
+ *
+ * @param[in] element hio element handle
+ * @param[in] app_offset application offset of the data
+ * @param[in] length length of the data
+ * @param[in] crc crc32c of the data
+ *
+ * If the range is exactly a segment its checksum is set and the segment is
+ * verified when read. Otherwise the range only covers part of a segment
+ * (partial overwrite) and the checksum of that segment is dropped. Callers
+ * that overwrite part of a checksummed segment should set the checksum of
+ * the whole segment instead.
+ */
+void hioi_element_set_segment_crc (hio_element_t element, uint64_t app_offset, size_t length, uint32_t crc) {
+  hio_manifest_segment_t *segment;
 
-  assert (seg_length > 0);
+  hioi_object_lock (&element->e_object);
+  element->e_sarray_valid = false;
+  /* the segment data was just rewritten in place */
+  hioi_element_invalidate_cache (element);
+  segment = hioi_segment_index_find (&element->e_segments, app_offset);
+  if (segment && app_offset >= segment->seg_offset && app_offset < segment->seg_offset + segment->seg_length) {
+    if (segment->seg_offset == app_offset && segment->seg_length == length) {
+      segment->seg_crc = crc;
+      segment->seg_has_crc = true;
+      segment->seg_crc_pending = false;
+    } else {
+      segment->seg_has_crc = false;
+    }
+  }
+  hioi_object_unlock (&element->e_object);
+}
 
-  ++element->e_scount;
+uint64_t hioi_element_next_segment_offset (hio_element_t element, uint64_t app_offset) {
+  hio_manifest_segment_t *segment;
+  uint64_t next_offset;
 
+  hioi_object_lock (&element->e_object);
+  segment = hioi_segment_index_next (&element->e_segments, app_offset);
+  next_offset = segment ? segment->seg_offset : UINT64_MAX;
   hioi_object_unlock (&element->e_object);
 
-  return HIO_SUCCESS;
+  return next_offset;
 }
 
 /**
@@ -223,41 +398,42 @@ int hioi_element_add_segment (hio_element_t element, int file_index, uint64_t fi
  * @param[out] file_index logical file index
  * @param[out] offset logical file offset
  * @param[inout] length length of application segment
+ * @param[out] segment_out copy of the matching segment (may be NULL)
  *
  * This function translates an application block into a logical file
  * segment. If a segment exists that matches the beginning of the
  * segment the index and offset are returned. If the application
  * block extends past the end of the segment the length is adjusted
- * to the end of the file segment.
+ * to the end of the file segment. The file offset is not meaningful
+ * for compressed segments. Use the segment descriptor instead.
  */
 int hioi_element_translate_offset (hio_element_t element, uint64_t app_offset, int *file_index,
-                                   uint64_t *offset, size_t *length) {
+                                   uint64_t *offset, size_t *length, hio_manifest_segment_t *segment_out) {
+  /* frozen segments never change so no lock is needed to search them */
+  bool frozen = element->e_frozen;
   hio_manifest_segment_t *segment;
   uint64_t base, bound, remaining;
   int rc = HIO_ERR_NOT_FOUND;
 
-  hioi_object_lock (&element->e_object);
+  /* a segment that ends at app_offset is never returned as the last segment to start at or before
+   * app_offset if another segment starts at app_offset */
+  if (frozen) {
+    segment = hioi_element_frozen_find (element, app_offset);
+  } else {
+    hioi_object_lock (&element->e_object);
+    segment = hioi_segment_index_find (&element->e_segments, app_offset);
+  }
 
-  segment = (hio_manifest_segment_t *) bsearch ((void *) (intptr_t) app_offset, element->e_sarray,
-                                                element->e_scount, sizeof (element->e_sarray[0]),
-                                                hioi_element_segment_compare);
   if (NULL == segment) {
-    hioi_object_unlock (&element->e_object);
+    if (!frozen) {
+      hioi_object_unlock (&element->e_object);
+    }
     return HIO_ERR_NOT_FOUND;
   }
 
   base = segment->seg_offset;
   bound = base + segment->seg_length;
 
-  if (app_offset == bound) {
-    int seg_index = ((intptr_t) segment - (intptr_t) element->e_sarray) / sizeof (*segment);
-    if (seg_index != element->e_scount - 1) {
-      ++segment;
-      base = segment->seg_offset;
-      bound = base + segment->seg_length;
-    }
-  }
-
   /* check if the base falls in the file segment */
   if (app_offset >= base && app_offset < bound) {
     /* fill in return values */
@@ -270,10 +446,16 @@ int hioi_element_translate_offset (hio_element_t element, uint64_t app_offset, i
       *length = remaining;
     }
 
+    if (segment_out) {
+      *segment_out = *segment;
+    }
+
     rc = HIO_SUCCESS;
   }
 
-  hioi_object_unlock (&element->e_object);
+  if (!frozen) {
+    hioi_object_unlock (&element->e_object);
+  }
 
   return rc;
 }
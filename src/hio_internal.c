@@ -23,6 +23,11 @@
 #include <string.h>
 #include <sys/stat.h>
 #include <ctype.h>
+#include <fcntl.h>
+
+#if defined(HAVE_SYS_MMAN_H)
+#include <sys/mman.h>
+#endif
 
 typedef struct hio_error_stack_item_t {
   struct hio_error_stack_item_t *next;
@@ -494,9 +499,50 @@ int hioi_string_scatter (hio_context_t context, char **string) {
   return HIO_SUCCESS;
 }
 
+void hioi_file_init (hio_file_t *file) {
+  file->f_hndl = NULL;
+  file->f_fd = -1;
+  file->f_bid = -1;
+  file->f_dsid = -1;
+  file->f_element = NULL;
+  file->f_align = 0;
+  file->f_size = 0;
+  file->f_extended = false;
+  file->f_map = NULL;
+  file->f_map_size = 0;
+  file->f_prealloc = 0;
+  file->f_prealloc_end = 0;
+  file->f_pblocks = NULL;
+  file->f_pblocks_count = 0;
+  atomic_init (&file->f_dirty, 0);
+  file->f_wb_size = 0;
+  pthread_rwlock_init (&file->f_lock, NULL);
+  pthread_mutex_init (&file->f_rmw_lock, NULL);
+}
+
+void hioi_file_fini (hio_file_t *file) {
+  free (file->f_pblocks);
+  pthread_mutex_destroy (&file->f_rmw_lock);
+  pthread_rwlock_destroy (&file->f_lock);
+}
+
 int hioi_file_close (hio_file_t *file) {
   int rc = 0;
 
+  if (file->f_extended && -1 != file->f_fd) {
+    /* direct writes are padded to the alignment. remove any padding at the end of the file. files
+     * written directly have a single writer so f_size is the size of the file's data */
+    (void) ftruncate (file->f_fd, file->f_size);
+  }
+
+#if defined(HAVE_SYS_MMAN_H)
+  if (file->f_map) {
+    (void) munmap (file->f_map, file->f_map_size);
+    file->f_map = NULL;
+    file->f_map_size = 0;
+  }
+#endif
+
   if (file->f_hndl) {
     rc = fclose (file->f_hndl);
   } else if (-1 != file->f_fd) {
@@ -509,31 +555,109 @@ int hioi_file_close (hio_file_t *file) {
 
   file->f_fd = -1;
   file->f_hndl = NULL;
+  file->f_align = 0;
+  file->f_extended = false;
+  file->f_prealloc = 0;
+  file->f_prealloc_end = 0;
+  free (file->f_pblocks);
+  file->f_pblocks = NULL;
+  file->f_pblocks_count = 0;
+  atomic_init (&file->f_dirty, 0);
+  file->f_wb_size = 0;
 
   return rc;
 }
 
-int64_t hioi_file_seek (hio_file_t *file, int64_t offset, int whence) {
-  if (SEEK_SET == whence && offset == file->f_offset) {
-    return file->f_offset;
+/** reads from a mapped file at least this large ask the kernel to read the range ahead */
+#define HIO_FILE_MAP_WILLNEED_MIN (1 << 17)
+
+int hioi_file_map (hio_file_t *file) {
+#if defined(HAVE_SYS_MMAN_H)
+  int fd = file->f_hndl ? fileno (file->f_hndl) : file->f_fd;
+  struct stat statinfo;
+  void *map;
+
+  if (-1 == fd || 0 != fstat (fd, &statinfo)) {
+    return HIO_ERROR;
   }
 
-  if (-1 != file->f_fd) {
-    file->f_offset = lseek (file->f_fd, offset, whence);
-  } else {
-    (void) fseek (file->f_hndl, offset, whence);
-    file->f_offset = ftell (file->f_hndl);
+  if (0 == statinfo.st_size) {
+    /* nothing to map. reads will hit end of file */
+    return HIO_ERR_NOT_AVAILABLE;
+  }
+
+  map = mmap (NULL, statinfo.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  if (MAP_FAILED == map) {
+    return hioi_err_errno (errno);
+  }
+
+  /* restart reads tend to be small and scattered. large reads are explicitly read ahead
+   * (see hioi_file_map_read) */
+  (void) madvise (map, statinfo.st_size, MADV_RANDOM);
+
+  file->f_map = map;
+  file->f_map_size = statinfo.st_size;
+
+  return HIO_SUCCESS;
+#else
+  return HIO_ERR_NOT_AVAILABLE;
+#endif
+}
+
+/**
+ * Copy data from a mapped file into a vector of buffers
+ */
+static ssize_t hioi_file_map_read (hio_file_t *file, const struct iovec *iov, int iovcnt, uint64_t offset) {
+  size_t length = 0, total = 0;
+
+  if (offset >= file->f_map_size) {
+    return 0;
+  }
+
+  for (int i = 0 ; i < iovcnt ; ++i) {
+    length += iov[i].iov_len;
   }
 
-  return file->f_offset;
+  length = min(length, file->f_map_size - offset);
+
+#if defined(HAVE_SYS_MMAN_H)
+  if (length >= HIO_FILE_MAP_WILLNEED_MIN) {
+    /* start paging in the whole range instead of faulting in one page at a time */
+    intptr_t page_mask = sysconf (_SC_PAGESIZE) - 1;
+    intptr_t start = ((intptr_t) file->f_map + offset) & ~page_mask;
+
+    (void) madvise ((void *) start, (intptr_t) file->f_map + offset + length - start, MADV_WILLNEED);
+  }
+#endif
+
+  for (int i = 0 ; i < iovcnt && total < length ; ++i) {
+    size_t chunk = min(iov[i].iov_len, length - total);
+
+    memcpy (iov[i].iov_base, (void *) ((intptr_t) file->f_map + offset + total), chunk);
+    total += chunk;
+  }
+
+  return total;
 }
 
-ssize_t hioi_file_write (hio_file_t *file, const void *ptr, size_t count) {
+/** maximum size of the bounce buffer used for unaligned direct I/O */
+#define HIO_FILE_BOUNCE_SIZE (1 << 20)
+
+static ssize_t hioi_file_pwrite_internal (hio_file_t *file, const void *ptr, size_t count, uint64_t offset) {
   ssize_t actual, total = 0;
 
+  if (-1 == file->f_fd) {
+    /* stdio streams have a single file position. hold the stream lock across the seek and write */
+    flockfile (file->f_hndl);
+    if (0 != fseek (file->f_hndl, offset, SEEK_SET)) {
+      funlockfile (file->f_hndl);
+      return -1;
+    }
+  }
+
   do {
     if (-1 != file->f_fd) {
-      actual = write (file->f_fd, ptr, count);
+      actual = pwrite (file->f_fd, ptr, count, offset + total);
     } else {
       actual = fwrite (ptr, 1, count, file->f_hndl);
     }
@@ -545,19 +669,27 @@ ssize_t hioi_file_write (hio_file_t *file, const void *ptr, size_t count) {
     }
   } while (count > 0 && (actual > 0 || (-1 == actual && EINTR == errno)) );
 
-  if (total > 0) {
-    file->f_offset += total;
+  if (-1 == file->f_fd) {
+    funlockfile (file->f_hndl);
   }
 
   return (actual < 0) ? actual: total;
 }
 
-ssize_t hioi_file_read (hio_file_t *file, void *ptr, size_t count) {
+static ssize_t hioi_file_pread_internal (hio_file_t *file, void *ptr, size_t count, uint64_t offset) {
   ssize_t actual, total = 0;
 
+  if (-1 == file->f_fd) {
+    flockfile (file->f_hndl);
+    if (0 != fseek (file->f_hndl, offset, SEEK_SET)) {
+      funlockfile (file->f_hndl);
+      return -1;
+    }
+  }
+
   do {
     if (-1 != file->f_fd) {
-      actual = read (file->f_fd, ptr, count);
+      actual = pread (file->f_fd, ptr, count, offset + total);
     } else {
       actual = fread (ptr, 1, count, file->f_hndl);
     }
@@ -569,18 +701,406 @@ ssize_t hioi_file_read (hio_file_t *file, void *ptr, size_t count) {
     }
   } while (count > 0 && (actual > 0 || (-1 == actual && EINTR == errno)) );
 
-  if (total > 0) {
-    file->f_offset += total;
+  if (-1 == file->f_fd) {
+    funlockfile (file->f_hndl);
+  }
+
+  return (actual < 0) ? actual: total;
+}
+
+/**
+ * Skip over the first count bytes of an iovec array
+ */
+static void hioi_iov_advance (struct iovec **iov, int *iovcnt, size_t count) {
+  while (*iovcnt && count >= (*iov)->iov_len) {
+    count -= (*iov)->iov_len;
+    ++(*iov);
+    --(*iovcnt);
+  }
+
+  if (*iovcnt) {
+    (*iov)->iov_base = (void *) ((intptr_t) (*iov)->iov_base + count);
+    (*iov)->iov_len -= count;
+  }
+}
+
+/**
+ * Copy count bytes between the start of an iovec array and a buffer then
+ * advance the iovec array past the copied data
+ */
+static void hioi_iov_copy (struct iovec **iov, int *iovcnt, void *buffer, size_t count, bool to_iov) {
+  while (count && *iovcnt) {
+    size_t chunk = min((*iov)->iov_len, count);
+
+    if (to_iov) {
+      memcpy ((*iov)->iov_base, buffer, chunk);
+    } else {
+      memcpy (buffer, (*iov)->iov_base, chunk);
+    }
+
+    buffer = (void *) ((intptr_t) buffer + chunk);
+    count -= chunk;
+    hioi_iov_advance (iov, iovcnt, chunk);
+  }
+}
+
+static bool hioi_file_iov_aligned (hio_file_t *file, const struct iovec *iov, int iovcnt, uint64_t offset) {
+  const uint64_t mask = file->f_align - 1;
+
+  if (offset & mask) {
+    return false;
+  }
+
+  for (int i = 0 ; i < iovcnt ; ++i) {
+    if (((uint64_t) (intptr_t) iov[i].iov_base | iov[i].iov_len) & mask) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+/**
+ * Record the end of a direct write. padded_end is the end of the data actually
+ * written to the file (including alignment padding).
+ */
+static void hioi_file_direct_extend (hio_file_t *file, uint64_t end, uint64_t padded_end) {
+  pthread_mutex_lock (&file->f_rmw_lock);
+  if (end > file->f_size) {
+    file->f_size = end;
+  }
+
+  if (padded_end > file->f_size) {
+    file->f_extended = true;
+  }
+  pthread_mutex_unlock (&file->f_rmw_lock);
+}
+
+/**
+ * Transfer unaligned data to/from a file opened with O_DIRECT
+ *
+ * Data is staged through an aligned bounce buffer. When writing, partially
+ * covered blocks at the head and tail of each chunk are read back from the
+ * file first. These read-modify-write cycles are serialized on the file's
+ * rmw lock. The lock is local to the process so a file must not be written
+ * directly by more than one process.
+ */
+static ssize_t hioi_file_direct_transfer (hio_file_t *file, struct iovec *iov, int iovcnt, uint64_t offset,
+                                          bool writing) {
+  const uint64_t align = file->f_align, mask = align - 1;
+  size_t length = 0, total = 0, bounce_size;
+  uint64_t bound;
+  ssize_t actual = 0;
+  void *bounce;
+
+  for (int i = 0 ; i < iovcnt ; ++i) {
+    length += iov[i].iov_len;
+  }
+
+  if (0 == length) {
+    return 0;
+  }
+
+  bound = (offset + length + mask) & ~mask;
+  bounce_size = min(bound - (offset & ~mask), (HIO_FILE_BOUNCE_SIZE + mask) & ~mask);
+
+  if (0 != posix_memalign (&bounce, align, bounce_size)) {
+    errno = ENOMEM;
+    return -1;
+  }
+
+  while (total < length) {
+    uint64_t pos = offset + total, chunk_base = pos & ~mask;
+    uint64_t chunk_bound = min(chunk_base + bounce_size, bound);
+    size_t span = chunk_bound - chunk_base, head = pos - chunk_base;
+    size_t chunk = min(span - head, length - total);
+    bool partial = head || (head + chunk) < span;
+
+    if (writing) {
+      if (partial) {
+        pthread_mutex_lock (&file->f_rmw_lock);
+
+        /* read back the blocks that are not completely overwritten */
+        if (head) {
+          actual = hioi_file_pread_internal (file, bounce, align, chunk_base);
+          memset ((void *) ((intptr_t) bounce + max(actual, 0)), 0, align - max(actual, 0));
+        }
+
+        if ((head + chunk) < span && (span > align || !head)) {
+          void *tail = (void *) ((intptr_t) bounce + span - align);
+          actual = hioi_file_pread_internal (file, tail, align, chunk_bound - align);
+          memset ((void *) ((intptr_t) tail + max(actual, 0)), 0, align - max(actual, 0));
+        }
+      }
+
+      hioi_iov_copy (&iov, &iovcnt, (void *) ((intptr_t) bounce + head), chunk, false);
+      actual = hioi_file_pwrite_internal (file, bounce, span, chunk_base);
+
+      if (partial) {
+        pthread_mutex_unlock (&file->f_rmw_lock);
+      }
+
+      if (actual < (ssize_t) span) {
+        break;
+      }
+
+      hioi_file_direct_extend (file, pos + chunk, chunk_bound);
+    } else {
+      actual = hioi_file_pread_internal (file, bounce, span, chunk_base);
+      if (actual <= (ssize_t) head) {
+        break;
+      }
+
+      chunk = min(chunk, (size_t) actual - head);
+      hioi_iov_copy (&iov, &iovcnt, (void *) ((intptr_t) bounce + head), chunk, true);
+      if (actual < (ssize_t) span) {
+        /* end of file */
+        total += chunk;
+        break;
+      }
+    }
+
+    total += chunk;
+  }
+
+  free (bounce);
+
+  return (total || actual >= 0) ? (ssize_t) total : actual;
+}
+
+/**
+ * Account for data written to a file
+ *
+ * Marks the file dirty and, if early writeback is enabled, starts writeback of
+ * the file's dirty pages each time another f_wb_size bytes have been written.
+ * Writeback runs behind the writers so a later sync has less to do.
+ */
+static void hioi_file_written (hio_file_t *file, ssize_t bytes) {
+  unsigned long dirty;
+
+  if (bytes <= 0) {
+    return;
+  }
+
+  dirty = atomic_fetch_add (&file->f_dirty, (unsigned long) bytes) + bytes;
+
+#if defined(HAVE_SYNC_FILE_RANGE)
+  if (file->f_wb_size && dirty / file->f_wb_size != (dirty - bytes) / file->f_wb_size) {
+    int fd = file->f_hndl ? fileno (file->f_hndl) : file->f_fd;
+
+    (void) sync_file_range (fd, 0, 0, SYNC_FILE_RANGE_WRITE);
+  }
+#else
+  (void) dirty;
+#endif
+}
+
+ssize_t hioi_file_pwrite (hio_file_t *file, const void *ptr, size_t count, uint64_t offset) {
+  ssize_t ret;
+
+  if (file->f_align) {
+    struct iovec iov = {.iov_base = (void *) ptr, .iov_len = count};
+    return hioi_file_pwritev (file, &iov, 1, offset);
+  }
+
+  ret = hioi_file_pwrite_internal (file, ptr, count, offset);
+  hioi_file_written (file, ret);
+
+  return ret;
+}
+
+ssize_t hioi_file_pread (hio_file_t *file, void *ptr, size_t count, uint64_t offset) {
+  if (file->f_map) {
+    struct iovec iov = {.iov_base = ptr, .iov_len = count};
+    return hioi_file_map_read (file, &iov, 1, offset);
+  }
+
+  if (file->f_align) {
+    struct iovec iov = {.iov_base = ptr, .iov_len = count};
+    return hioi_file_preadv (file, &iov, 1, offset);
+  }
+
+  return hioi_file_pread_internal (file, ptr, count, offset);
+}
+
+static ssize_t hioi_file_pwritev_internal (hio_file_t *file, struct iovec *iov, int iovcnt, uint64_t offset) {
+  ssize_t actual = 0, total = 0;
+
+#if defined(HAVE_PWRITEV)
+  if (-1 != file->f_fd) {
+    do {
+      actual = pwritev (file->f_fd, iov, iovcnt, offset + total);
+      if (actual > 0) {
+        total += actual;
+        hioi_iov_advance (&iov, &iovcnt, actual);
+      }
+    } while (iovcnt > 0 && (actual > 0 || (-1 == actual && EINTR == errno)) );
+
+    return (actual < 0) ? actual: total;
+  }
+#endif
+
+  for (int i = 0 ; i < iovcnt ; ++i) {
+    actual = hioi_file_pwrite_internal (file, iov[i].iov_base, iov[i].iov_len, offset + total);
+    if (actual > 0) {
+      total += actual;
+    }
+
+    if (actual < (ssize_t) iov[i].iov_len) {
+      break;
+    }
   }
 
   return (actual < 0) ? actual: total;
 }
 
-void hioi_file_flush (hio_file_t *file) {
+ssize_t hioi_file_pwritev (hio_file_t *file, struct iovec *iov, int iovcnt, uint64_t offset) {
+  ssize_t ret;
+
+  if (file->f_align) {
+    if (!hioi_file_iov_aligned (file, iov, iovcnt, offset)) {
+      ret = hioi_file_direct_transfer (file, iov, iovcnt, offset, true);
+      hioi_file_written (file, ret);
+      return ret;
+    }
+
+    ret = hioi_file_pwritev_internal (file, iov, iovcnt, offset);
+    if (ret > 0) {
+      hioi_file_direct_extend (file, offset + ret, offset + ret);
+    }
+  } else {
+    ret = hioi_file_pwritev_internal (file, iov, iovcnt, offset);
+  }
+
+  hioi_file_written (file, ret);
+
+  return ret;
+}
+
+static ssize_t hioi_file_preadv_internal (hio_file_t *file, struct iovec *iov, int iovcnt, uint64_t offset) {
+  ssize_t actual = 0, total = 0;
+
+#if defined(HAVE_PREADV)
   if (-1 != file->f_fd) {
-    fsync (file->f_fd);
+    do {
+      actual = preadv (file->f_fd, iov, iovcnt, offset + total);
+      if (actual > 0) {
+        total += actual;
+        hioi_iov_advance (&iov, &iovcnt, actual);
+      }
+    } while (iovcnt > 0 && (actual > 0 || (-1 == actual && EINTR == errno)) );
+
+    return (actual < 0) ? actual: total;
+  }
+#endif
+
+  for (int i = 0 ; i < iovcnt ; ++i) {
+    actual = hioi_file_pread_internal (file, iov[i].iov_base, iov[i].iov_len, offset + total);
+    if (actual > 0) {
+      total += actual;
+    }
+
+    if (actual < (ssize_t) iov[i].iov_len) {
+      break;
+    }
+  }
+
+  return (actual < 0) ? actual: total;
+}
+
+ssize_t hioi_file_preadv (hio_file_t *file, struct iovec *iov, int iovcnt, uint64_t offset) {
+  if (file->f_map) {
+    return hioi_file_map_read (file, iov, iovcnt, offset);
+  }
+
+  if (file->f_align && !hioi_file_iov_aligned (file, iov, iovcnt, offset)) {
+    return hioi_file_direct_transfer (file, iov, iovcnt, offset, false);
+  }
+
+  return hioi_file_preadv_internal (file, iov, iovcnt, offset);
+}
+
+void hioi_file_prefetch (hio_file_t *file, uint64_t offset, size_t length) {
+#if defined(HAVE_POSIX_FADVISE)
+  int fd = file->f_hndl ? fileno (file->f_hndl) : file->f_fd;
+
+  if (-1 != fd) {
+    (void) posix_fadvise (fd, offset, length, POSIX_FADV_WILLNEED);
+  }
+#endif
+}
+
+int hioi_file_allocate (hio_file_t *file, uint64_t offset, uint64_t length) {
+#if defined(HAVE_FALLOCATE)
+  int fd = file->f_hndl ? fileno (file->f_hndl) : file->f_fd;
+
+  if (-1 == fd || 0 == length) {
+    return HIO_SUCCESS;
+  }
+
+  if (0 != fallocate (fd, FALLOC_FL_KEEP_SIZE, offset, length)) {
+    if (EOPNOTSUPP == errno || ENOSYS == errno) {
+      return HIO_ERR_NOT_AVAILABLE;
+    }
+
+    return hioi_err_errno (errno);
+  }
+
+  return HIO_SUCCESS;
+#else
+  return HIO_ERR_NOT_AVAILABLE;
+#endif
+}
+
+int hioi_file_preallocate (hio_file_t *file, uint64_t offset, uint64_t length) {
+  uint64_t end = offset + length;
+  int rc;
+
+  if (end <= file->f_prealloc) {
+    return HIO_SUCCESS;
+  }
+
+  if (offset < file->f_prealloc) {
+    offset = file->f_prealloc;
+  }
+
+  rc = hioi_file_allocate (file, offset, end - offset);
+  if (HIO_SUCCESS != rc) {
+    return rc;
+  }
+
+  /* f_prealloc only covers contiguously allocated space starting at the beginning of the file */
+  if (offset == file->f_prealloc) {
+    file->f_prealloc = end;
+  }
+
+  if (end > file->f_prealloc_end) {
+    file->f_prealloc_end = end;
+  }
+
+  return HIO_SUCCESS;
+}
+
+int hioi_file_flush (hio_file_t *file) {
+  unsigned long dirty;
+  int rc = 0;
+
+  /* clear the dirty count before syncing so bytes written by other threads during the sync
+   * keep the file dirty */
+  dirty = atomic_exchange (&file->f_dirty, 0);
+
+  if (-1 != file->f_fd) {
+    rc = fsync (file->f_fd);
   } else if (NULL != file->f_hndl) {
     fflush (file->f_hndl);
-    fsync (fileno (file->f_hndl));
+    rc = fsync (fileno (file->f_hndl));
   }
+
+  if (0 != rc) {
+    rc = hioi_err_errno (errno);
+    atomic_fetch_add (&file->f_dirty, dirty);
+    return rc;
+  }
+
+  return HIO_SUCCESS;
 }
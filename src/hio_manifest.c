@@ -27,8 +27,12 @@
 
 #include <json.h>
 
-#define HIO_MANIFEST_VERSION "3.0"
-#define HIO_MANIFEST_COMPAT  "3.0"
+/* 3.1 adds compressed, checksummed, hashed, and referenced segments and dataset references.
+ * older readers would silently misread these so manifests that use them are written with
+ * compatibility version 3.1. all other manifests can still be read by 3.0 readers */
+#define HIO_MANIFEST_VERSION    "3.1"
+#define HIO_MANIFEST_COMPAT     "3.0"
+#define HIO_MANIFEST_COMPAT_3_1 "3.1"
 
 #define HIO_MANIFEST_PROP_VERSION     "hio_manifest_version"
 #define HIO_MANIFEST_PROP_COMPAT      "hio_manifest_compat"
@@ -45,10 +49,16 @@
 #define HIO_MANIFEST_KEY_MTIME        "hio_mtime"
 #define HIO_MANIFEST_KEY_COMM_SIZE    "hio_comm_size"
 #define HIO_MANIFEST_KEY_STATUS       "hio_status"
+#define HIO_MANIFEST_KEY_REFERENCES   "hio_references"
 #define HIO_SEGMENT_KEY_FILE_OFFSET   "loff"
 #define HIO_SEGMENT_KEY_APP_OFFSET0   "off"
 #define HIO_SEGMENT_KEY_LENGTH        "len"
 #define HIO_SEGMENT_KEY_FILE_INDEX    "findex"
+#define HIO_SEGMENT_KEY_CLENGTH       "clen"
+#define HIO_SEGMENT_KEY_CODEC         "codec"
+#define HIO_SEGMENT_KEY_CRC           "crc"
+#define HIO_SEGMENT_KEY_HASH          "hash"
+#define HIO_SEGMENT_KEY_REF           "ref"
 
 /* manifest helper functions */
 static void hioi_manifest_set_number (json_object *parent, const char *name, unsigned long value) {
@@ -207,6 +217,21 @@ static json_object *hio_manifest_generate_simple_3_0 (hio_dataset_t dataset) {
   hioi_manifest_set_signed_number (top, HIO_MANIFEST_KEY_STATUS, (long) dataset->ds_status);
   hioi_manifest_set_number (top, HIO_MANIFEST_KEY_MTIME, (unsigned long) time (NULL));
 
+  if (dataset->ds_ref_count) {
+    /* datasets this dataset depends on. they must not be unlinked before this one */
+    json_object *references = hio_manifest_new_array (top, HIO_MANIFEST_KEY_REFERENCES);
+    if (NULL == references) {
+      json_object_put (top);
+      return NULL;
+    }
+
+    hioi_manifest_set_string (top, HIO_MANIFEST_PROP_COMPAT, HIO_MANIFEST_COMPAT_3_1);
+
+    for (int i = 0 ; i < dataset->ds_ref_count ; ++i) {
+      json_object_array_add (references, json_object_new_int64 (dataset->ds_refs[i]));
+    }
+  }
+
   return top;
 }
 
@@ -220,6 +245,7 @@ static json_object *hio_manifest_generate_simple_3_0 (hio_dataset_t dataset) {
 static json_object *hio_manifest_generate_3_0 (hio_dataset_t dataset) {
   json_object *elements, *top;
   hio_element_t element;
+  bool compat_3_1 = false;
 
   top = hio_manifest_generate_simple_3_0 (dataset);
   if (NULL == top || 0 == hioi_list_length (&dataset->ds_elist)) {
@@ -248,16 +274,17 @@ static json_object *hio_manifest_generate_3_0 (hio_dataset_t dataset) {
 
     json_object_array_add (elements, element_object);
 
-    if (element->e_scount) {
+    if (element->e_segments.si_count) {
+      hio_manifest_segment_t *segments = hioi_element_segments (element);
       json_object *segments_object = hio_manifest_new_array (element_object, "segments");
-      if (NULL == segments_object) {
+      if (NULL == segments_object || NULL == segments) {
         json_object_put (top);
         return NULL;
       }
 
-      for (int i = 0 ; i < element->e_scount ; ++i) {
+      for (int i = 0 ; i < element->e_segments.si_count ; ++i) {
         json_object *segment_object = json_object_new_object ();
-        hio_manifest_segment_t *segment = element->e_sarray + i;
+        hio_manifest_segment_t *segment = segments + i;
         if (NULL == segment_object) {
           json_object_put (top);
           return NULL;
@@ -271,11 +298,33 @@ static json_object *hio_manifest_generate_3_0 (hio_dataset_t dataset) {
                                   (unsigned long) segment->seg_length);
         hioi_manifest_set_number (segment_object, HIO_SEGMENT_KEY_FILE_INDEX,
                                   (unsigned long) segment->seg_file_index);
+        compat_3_1 |= HIO_CODEC_NONE != segment->seg_codec || segment->seg_has_crc || segment->seg_has_hash ||
+          segment->seg_is_ref;
+
+        if (HIO_CODEC_NONE != segment->seg_codec) {
+          hioi_manifest_set_number (segment_object, HIO_SEGMENT_KEY_CLENGTH,
+                                    (unsigned long) segment->seg_clength);
+          hioi_manifest_set_number (segment_object, HIO_SEGMENT_KEY_CODEC,
+                                    (unsigned long) segment->seg_codec);
+        }
+        if (segment->seg_has_crc) {
+          hioi_manifest_set_number (segment_object, HIO_SEGMENT_KEY_CRC, (unsigned long) segment->seg_crc);
+        }
+        if (segment->seg_has_hash) {
+          hioi_manifest_set_number (segment_object, HIO_SEGMENT_KEY_HASH, (unsigned long) segment->seg_hash);
+        }
+        if (segment->seg_is_ref) {
+          hioi_manifest_set_signed_number (segment_object, HIO_SEGMENT_KEY_REF, (long) segment->seg_ref_id);
+        }
         json_object_array_add (segments_object, segment_object);
       }
     }
   }
 
+  if (compat_3_1) {
+    hioi_manifest_set_string (top, HIO_MANIFEST_PROP_COMPAT, HIO_MANIFEST_COMPAT_3_1);
+  }
+
   return top;
 }
 
@@ -375,7 +424,9 @@ int hioi_manifest_save (hio_dataset_t dataset, const unsigned char *manifest_dat
 }
 
 static int hioi_manifest_parse_segment_2_1 (hio_element_t element, json_object *segment_object) {
-  unsigned long file_offset, app_offset0, length, file_index;
+  unsigned long file_offset, app_offset0, length, file_index, clength = 0, codec = HIO_CODEC_NONE, crc, hash;
+  hio_manifest_segment_t segment;
+  long ref_id;
   int rc;
 
   rc = hioi_manifest_get_number (segment_object, HIO_SEGMENT_KEY_FILE_OFFSET, &file_offset);
@@ -399,7 +450,38 @@ static int hioi_manifest_parse_segment_2_1 (hio_element_t element, json_object *
     return rc;
   }
 
-  return hioi_element_add_segment (element, file_index, file_offset, app_offset0, length);
+  /* segments are only compressed if a codec is listed */
+  (void) hioi_manifest_get_number (segment_object, HIO_SEGMENT_KEY_CODEC, &codec);
+  if (HIO_CODEC_NONE != codec) {
+    rc = hioi_manifest_get_number (segment_object, HIO_SEGMENT_KEY_CLENGTH, &clength);
+    if (HIO_SUCCESS != rc) {
+      hioi_err_push (HIO_ERROR, &element->e_object, "Manfest compressed segment missing clen property");
+      return rc;
+    }
+  }
+
+  /* segments written without checksums have no crc */
+  rc = hioi_manifest_get_number (segment_object, HIO_SEGMENT_KEY_CRC, &crc);
+
+  segment.seg_offset = app_offset0;
+  segment.seg_length = length;
+  segment.seg_foffset = file_offset;
+  segment.seg_file_index = file_index;
+  segment.seg_codec = (hio_codec_t) codec;
+  segment.seg_clength = clength;
+  segment.seg_has_crc = (HIO_SUCCESS == rc);
+  segment.seg_crc = segment.seg_has_crc ? (uint32_t) crc : 0;
+
+  /* segments written by incremental datasets may be hashed and may refer to the data of an older dataset */
+  rc = hioi_manifest_get_number (segment_object, HIO_SEGMENT_KEY_HASH, &hash);
+  segment.seg_has_hash = (HIO_SUCCESS == rc);
+  segment.seg_hash = segment.seg_has_hash ? (uint64_t) hash : 0;
+
+  rc = hioi_manifest_get_signed_number (segment_object, HIO_SEGMENT_KEY_REF, &ref_id);
+  segment.seg_is_ref = (HIO_SUCCESS == rc);
+  segment.seg_ref_id = segment.seg_is_ref ? (int64_t) ref_id : -1;
+
+  return hioi_element_insert_segment (element, &segment);
 }
 
 static int hioi_manifest_parse_segments_2_1 (hio_element_t element, json_object *object) {
@@ -606,9 +688,31 @@ static int hioi_manifest_parse_2_0 (hio_dataset_t dataset, json_object *object)
   return hioi_manifest_parse_elements_2_0 (dataset, elements_object);
 }
 
+static int hioi_manifest_parse_references (json_object *references, int64_t **refs, int *ref_count) {
+  int count = json_object_array_length (references);
+  int64_t *tmp = NULL;
+
+  if (count > 0) {
+    tmp = (int64_t *) calloc (count, sizeof (*tmp));
+    if (NULL == tmp) {
+      return HIO_ERR_OUT_OF_RESOURCE;
+    }
+
+    for (int i = 0 ; i < count ; ++i) {
+      tmp[i] = json_object_get_int64 (json_object_array_get_idx (references, i));
+    }
+  }
+
+  free (*refs);
+  *refs = tmp;
+  *ref_count = count;
+
+  return HIO_SUCCESS;
+}
+
 static int hioi_manifest_parse_3_0 (hio_dataset_t dataset, json_object *object) {
   hio_context_t context = hioi_object_context (&dataset->ds_object);
-  json_object *elements_object, *config;
+  json_object *elements_object, *config, *references;
   unsigned long mode = 0, size;
   const char *tmp_string;
   long status;
@@ -622,7 +726,8 @@ static int hioi_manifest_parse_3_0 (hio_dataset_t dataset, json_object *object)
     return rc;
   }
 
-  if (strcmp ((char *) tmp_string, "3.0")) {
+  if (strcmp ((char *) tmp_string, HIO_MANIFEST_COMPAT) &&
+      strcmp ((char *) tmp_string, HIO_MANIFEST_COMPAT_3_1)) {
     /* incompatible version */
     return hioi_manifest_parse_2_0 (dataset, object);
   }
@@ -690,6 +795,15 @@ static int hioi_manifest_parse_3_0 (hio_dataset_t dataset, json_object *object)
 
   dataset->ds_status = status;
 
+  /* older datasets holding data referenced by this one (incremental datasets) */
+  references = hioi_manifest_find_object (object, HIO_MANIFEST_KEY_REFERENCES);
+  if (NULL != references) {
+    rc = hioi_manifest_parse_references (references, &dataset->ds_refs, &dataset->ds_ref_count);
+    if (HIO_SUCCESS != rc) {
+      return rc;
+    }
+  }
+
   /* find and parse all elements covered by this manifest */
   elements_object = hioi_manifest_find_object (object, "elements");
   if (NULL == elements_object) {
@@ -714,7 +828,8 @@ static int hioi_manifest_parse_header_2_0 (hio_context_t context, hio_dataset_he
 
   hioi_log (context, HIO_VERBOSE_DEBUG_LOW, "compatibility version of manifest: %s", (char *) tmp_string);
 
-  if (strcmp (tmp_string, "2.0") && strcmp (tmp_string, "3.0")) {
+  if (strcmp (tmp_string, "2.0") && strcmp (tmp_string, HIO_MANIFEST_COMPAT) &&
+      strcmp (tmp_string, HIO_MANIFEST_COMPAT_3_1)) {
     /* incompatible version */
     return HIO_ERROR;
   }
@@ -1016,6 +1131,12 @@ static int hioi_manifest_merge_internal (json_object *object1, json_object *obje
     return HIO_ERR_BAD_PARAM;
   }
 
+  /* the merged manifest needs the newer compatibility version if either manifest does */
+  rc = hioi_manifest_get_string (object2, HIO_MANIFEST_PROP_COMPAT, &tmp_string);
+  if (HIO_SUCCESS == rc && 0 == strcmp (tmp_string, HIO_MANIFEST_COMPAT_3_1)) {
+    hioi_manifest_set_string (object1, HIO_MANIFEST_PROP_COMPAT, HIO_MANIFEST_COMPAT_3_1);
+  }
+
   elements1 = hioi_manifest_find_object (object1, "elements");
   elements2 = hioi_manifest_find_object (object2, "elements");
 
@@ -1291,6 +1412,49 @@ int hioi_manifest_ranks (const unsigned char *manifest, size_t manifest_size, in
   return rc;
 }
 
+int hioi_manifest_read_references (hio_context_t context, const char *path, int64_t **refs, int *ref_count) {
+  unsigned char *manifest = NULL;
+  json_object *object, *references;
+  size_t manifest_size;
+  int rc = HIO_SUCCESS;
+
+  *refs = NULL;
+  *ref_count = 0;
+
+  rc = hioi_manifest_read (path, &manifest, &manifest_size);
+  if (HIO_SUCCESS != rc || NULL == manifest) {
+    return rc;
+  }
+
+  if ('B' == manifest[0] && 'Z' == manifest[1]) {
+    unsigned char *data = manifest;
+    rc = hioi_manifest_decompress ((unsigned char **) &data, manifest_size);
+    if (HIO_SUCCESS != rc) {
+      free (manifest);
+      return rc;
+    }
+    free (manifest);
+    manifest = data;
+  }
+
+  object = json_tokener_parse ((char *) manifest);
+  free (manifest);
+  if (NULL == object) {
+    return HIO_ERROR;
+  }
+
+  references = hioi_manifest_find_object (object, HIO_MANIFEST_KEY_REFERENCES);
+  if (NULL != references) {
+    rc = hioi_manifest_parse_references (references, refs, ref_count);
+  }
+
+  hioi_log (context, HIO_VERBOSE_DEBUG_MED, "found %d dataset references in manifest %s", *ref_count, path);
+
+  json_object_put (object);
+
+  return rc;
+}
+
 int hioi_manifest_read_header (hio_context_t context, hio_dataset_header_t *header, const char *path) {
   unsigned char *manifest = NULL;
   size_t manifest_size;
@@ -63,12 +63,23 @@ typedef struct hio_map_segment_t {
 
   struct hio_map_segment_value_t {
     /* file address */
-    /** reserved for future use (padding) */
-    uint32_t ms_resv1;
+    /** codec used to compress the segment (hio_codec_t) */
+    uint32_t ms_codec;
     /** index of file holding the segment */
     uint32_t ms_findex;
     /** offset of segment within the file */
     uint64_t ms_foff;
+    /** compressed length of the segment (0 if not compressed) */
+    uint64_t ms_clen;
+    /** offset of this entry within the segment. entries past a hash block boundary
+     * keep the segment's ms_foff so the whole segment can be reconstructed */
+    uint64_t ms_coff;
+    /** crc32c of the segment data */
+    uint32_t ms_crc;
+    /** ms_crc is valid */
+    uint32_t ms_has_crc;
+    /** identifier of the dataset holding the segment data (-1: this dataset) */
+    int64_t  ms_ref_id;
   } value;
 } hio_map_segment_t;
 
@@ -450,8 +461,14 @@ int hioi_dataset_map_insert_segment (hio_element_t element, hio_manifest_segment
                                       .ms_aoff = segment->seg_offset,
                                       .ms_size = segment->seg_length};
   struct hio_map_segment_key_t bound_key = {.ms_aoff = segment->seg_offset + segment->seg_length - 1};
-  struct hio_map_segment_value_t value = {.ms_findex = segment->seg_file_index,
-                                          .ms_foff = segment->seg_foffset};
+  struct hio_map_segment_value_t value = {.ms_codec = segment->seg_codec,
+                                          .ms_findex = segment->seg_file_index,
+                                          .ms_foff = segment->seg_foffset,
+                                          .ms_clen = segment->seg_clength,
+                                          .ms_coff = 0,
+                                          .ms_crc = segment->seg_crc,
+                                          .ms_has_crc = segment->seg_has_crc,
+                                          .ms_ref_id = segment->seg_is_ref ? segment->seg_ref_id : -1};
   int rc;
 
   for (int i = 0 ; i < hio_segment_hash_count ; ++i) {
@@ -474,7 +491,7 @@ int hioi_dataset_map_insert_segment (hio_element_t element, hio_manifest_segment
 
       key.ms_aoff = next_block;
       key.ms_size -= block_offset;
-      value.ms_foff += block_offset;
+      value.ms_coff = block_offset;
 
       rc = hioi_dataset_map_insert (&map->map_segments, context->c_node_leaders, &key, sizeof (key),
                                         &value, NULL, hio_segment_hashes[i].sh_fn, hioi_map_compare_segment,
@@ -503,8 +520,14 @@ static int hioi_dataset_map_generate_segment_map (hio_dataset_t dataset, uint64_
     hio_element_t element;
 
     hioi_list_foreach (element, dataset->ds_elist, struct hio_element, e_list) {
-      for (int i = 0 ; i < element->e_scount ; ++i) {
-        rc = hioi_dataset_map_insert_segment (element, element->e_sarray + i);
+      hio_manifest_segment_t *segments = hioi_element_segments (element);
+
+      if (NULL == segments && element->e_segments.si_count) {
+        return HIO_ERR_OUT_OF_RESOURCE;
+      }
+
+      for (int i = 0 ; i < element->e_segments.si_count ; ++i) {
+        rc = hioi_dataset_map_insert_segment (element, segments + i);
         if (HIO_SUCCESS != rc) {
           return rc;
         }
@@ -543,7 +566,7 @@ int hioi_dataset_generate_map (hio_dataset_t dataset) {
       /* determine the number of elements and segments in the dataset */
       hioi_list_foreach (element, dataset->ds_elist, struct hio_element, e_list) {
         ++counts[0];
-        counts[1] += element->e_scount;
+        counts[1] += element->e_segments.si_count;
       }
 
       rc = MPI_Allreduce (MPI_IN_PLACE, counts, 2, MPI_INT64_T, MPI_SUM,
@@ -639,7 +662,8 @@ static int hioi_dataset_map_lookup_segment (hio_element_t element, int64_t app_o
 }
 
 int hioi_dataset_map_translate_offset (hio_element_t element, uint64_t app_offset,
-                                       int *file_index, uint64_t *offset, size_t *length) {
+                                       int *file_index, uint64_t *offset, size_t *length,
+                                       hio_manifest_segment_t *segment_out) {
   hio_map_segment_t segment = {.key = {.ms_aoff = 0, .ms_size = 0}, .value = {.ms_findex = -1, .ms_foff = -1}};
   uint64_t base, bound;
   int rc;
@@ -660,11 +684,26 @@ int hioi_dataset_map_translate_offset (hio_element_t element, uint64_t app_offse
   bound = base + segment.key.ms_size;
 
   *file_index = segment.value.ms_findex;
-  *offset = segment.value.ms_foff + app_offset - base;
+  *offset = segment.value.ms_foff + segment.value.ms_coff + app_offset - base;
   if (app_offset + *length > bound) {
     *length = bound - app_offset;
   }
 
+  if (segment_out) {
+    /* reconstruct the full segment from this entry */
+    segment_out->seg_offset = base - segment.value.ms_coff;
+    segment_out->seg_length = segment.key.ms_size + segment.value.ms_coff;
+    segment_out->seg_foffset = segment.value.ms_foff;
+    segment_out->seg_file_index = segment.value.ms_findex;
+    segment_out->seg_codec = (hio_codec_t) segment.value.ms_codec;
+    segment_out->seg_clength = segment.value.ms_clen;
+    segment_out->seg_crc = segment.value.ms_crc;
+    segment_out->seg_has_crc = !!segment.value.ms_has_crc;
+    segment_out->seg_has_hash = false;
+    segment_out->seg_is_ref = segment.value.ms_ref_id >= 0;
+    segment_out->seg_ref_id = segment.value.ms_ref_id;
+  }
+
   return HIO_SUCCESS;
 }
 
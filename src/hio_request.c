@@ -12,26 +12,70 @@
 #include "hio_internal.h"
 
 #include <stdlib.h>
+#include <string.h>
 
-#include <sys/time.h>
+/** number of user requests allocated at a time */
+#define HIO_REQUEST_SLAB_COUNT 64
+
+/**
+ * Block of user requests. Slabs are only released when the context is
+ * finalized.
+ */
+typedef struct hio_request_slab_t {
+  hio_list_t         rs_list;
+  struct hio_request rs_requests[HIO_REQUEST_SLAB_COUNT];
+} hio_request_slab_t;
 
 hio_request_t hioi_request_alloc (hio_context_t context) {
+  hio_worker_pool_t *pool = &context->c_workers;
   hio_request_t request;
 
-  request = (hio_request_t) calloc (1, sizeof (*request));
-  if (NULL == request) {
-    return NULL;
+  pthread_mutex_lock (&pool->wp_lock);
+  if (pool->wp_free.next == &pool->wp_free) {
+    hio_request_slab_t *slab = malloc (sizeof (*slab));
+    if (NULL == slab) {
+      pthread_mutex_unlock (&pool->wp_lock);
+      return NULL;
+    }
+
+    hioi_list_append (slab, pool->wp_slabs, rs_list);
+    for (int i = 0 ; i < HIO_REQUEST_SLAB_COUNT ; ++i) {
+      hioi_list_append (slab->rs_requests + i, pool->wp_free, req_list);
+    }
   }
 
+  request = hioi_list_item (pool->wp_free.next, struct hio_request, req_list);
+  hioi_list_remove (request, req_list);
+  pthread_mutex_unlock (&pool->wp_lock);
+
+  memset (request, 0, sizeof (*request));
   request->req_object.type = HIO_OBJECT_TYPE_REQUEST;
+  request->req_object.parent = &context->c_object;
 
   return request;
 }
 
 void hioi_request_release (hio_request_t request) {
   if (HIO_OBJECT_NULL != request) {
-    free (request);
+    hio_worker_pool_t *pool = &((hio_context_t) request->req_object.parent)->c_workers;
+
+    pthread_mutex_lock (&pool->wp_lock);
+    /* reuse the most recently released request first */
+    hioi_list_prepend (request, pool->wp_free, req_list);
+    pthread_mutex_unlock (&pool->wp_lock);
+  }
+}
+
+void hioi_request_pool_fini (hio_context_t context) {
+  hio_worker_pool_t *pool = &context->c_workers;
+  hio_request_slab_t *slab, *next;
+
+  hioi_list_foreach_safe(slab, next, pool->wp_slabs, hio_request_slab_t, rs_list) {
+    hioi_list_remove (slab, rs_list);
+    free (slab);
   }
+
+  hioi_list_init (pool->wp_free);
 }
 
 static int hioi_request_test_internal (hio_request_t *requests, int nrequests, ssize_t *bytes_transferred,
@@ -51,13 +95,28 @@ static int hioi_request_test_internal (hio_request_t *requests, int nrequests, s
       }
 
       ++ncomplete;
-    } else if (requests[i]->req_complete) {
+      continue;
+    }
+
+    if (requests[i]->req_dataset && !hioi_worker_request_complete (requests[i])) {
+      /* the request is waiting in a read queue. issue the queued reads */
+      int rc = hioi_dataset_read_flush (requests[i]->req_dataset);
+      if (HIO_SUCCESS != rc) {
+        return rc;
+      }
+    }
+
+    if (hioi_worker_request_complete (requests[i])) {
       if (complete) {
         complete[i] = true;
       }
 
       if (bytes_transferred) {
-        bytes_transferred[i] = requests[i]->req_transferred;
+        if (HIO_SUCCESS != requests[i]->req_status) {
+          bytes_transferred[i] = requests[i]->req_status;
+        } else {
+          bytes_transferred[i] = requests[i]->req_transferred;
+        }
       }
 
       hioi_request_release (requests[i]);
@@ -93,8 +152,8 @@ int hio_request_wait (hio_request_t *requests, int nrequests, ssize_t *bytes_tra
 
     first = false;
 
-    struct timespec interval = {.tv_sec = 0, .tv_nsec = 1000};
-    nanosleep (&interval, NULL);
+    /* block until one of the remaining requests completes */
+    hioi_worker_wait (requests, nrequests);
   } while (1);
 
   return HIO_SUCCESS;
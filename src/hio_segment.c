@@ -0,0 +1,305 @@
+/* -*- Mode: C; c-basic-offset:2 ; indent-tabs-mode:nil -*- */
+/*
+ * Copyright (c) 2014-2016 Los Alamos National Security, LLC.  All rights
+ *                         reserved.
+ * $COPYRIGHT$
+ *
+ * Additional copyrights may follow
+ *
+ * $HEADER$
+ */
+
+/**
+ * @file hio_segment.c
+ * @brief Element segment index
+ *
+ * Segments are kept in a B+tree keyed by application offset. Leaves hold
+ * the segment descriptors themselves and are chained in offset order so
+ * the index can be walked or exported without touching interior nodes.
+ * Interior node entry i (i > 0) routes all offsets >= sn_keys[i] that are
+ * less than sn_keys[i + 1] to child i. Offsets less than sn_keys[1] go to
+ * child 0. Segments are never removed so a separator always equals the
+ * first offset stored under it.
+ */
+
+#include "hio_internal.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/** maximum number of segments in a leaf or children in an interior node */
+#define HIO_SEGMENT_NODE_MAX  32
+
+/** deepest tree supported (32^16 segments is more than enough) */
+#define HIO_SEGMENT_MAX_HEIGHT 16
+
+typedef struct hio_segment_node_t {
+  /** number of segments (leaf) or children (interior) */
+  int sn_count;
+  /** next leaf in offset order (leaves only) */
+  struct hio_segment_node_t *sn_next;
+  union {
+    struct {
+      /** first application offset under each child. sn_keys[0] is not used for routing */
+      uint64_t sn_keys[HIO_SEGMENT_NODE_MAX];
+      struct hio_segment_node_t *sn_children[HIO_SEGMENT_NODE_MAX];
+    } interior;
+    hio_manifest_segment_t sn_segments[HIO_SEGMENT_NODE_MAX];
+  } sn_u;
+} hio_segment_node_t;
+
+void hioi_segment_index_init (hio_segment_index_t *index) {
+  index->si_root = NULL;
+  index->si_height = 0;
+  index->si_count = 0;
+}
+
+static void hioi_segment_node_free (hio_segment_node_t *node, int height) {
+  if (height) {
+    for (int i = 0 ; i < node->sn_count ; ++i) {
+      hioi_segment_node_free (node->sn_u.interior.sn_children[i], height - 1);
+    }
+  }
+
+  free (node);
+}
+
+void hioi_segment_index_fini (hio_segment_index_t *index) {
+  if (index->si_root) {
+    hioi_segment_node_free (index->si_root, index->si_height);
+  }
+
+  hioi_segment_index_init (index);
+}
+
+/* index of the child of an interior node that covers offset */
+static int hioi_segment_child (const hio_segment_node_t *node, uint64_t offset) {
+  int low = 1, high = node->sn_count;
+
+  /* find the first key greater than offset. the child before it covers offset */
+  while (low < high) {
+    int mid = (low + high) / 2;
+
+    if (node->sn_u.interior.sn_keys[mid] > offset) {
+      high = mid;
+    } else {
+      low = mid + 1;
+    }
+  }
+
+  return low - 1;
+}
+
+/* number of segments in a leaf that start at or before offset */
+static int hioi_segment_upper (const hio_segment_node_t *leaf, uint64_t offset) {
+  int low = 0, high = leaf->sn_count;
+
+  while (low < high) {
+    int mid = (low + high) / 2;
+
+    if (leaf->sn_u.sn_segments[mid].seg_offset > offset) {
+      high = mid;
+    } else {
+      low = mid + 1;
+    }
+  }
+
+  return low;
+}
+
+static hio_segment_node_t *hioi_segment_leaf (const hio_segment_index_t *index, uint64_t offset) {
+  hio_segment_node_t *node = index->si_root;
+
+  for (int level = index->si_height ; level > 0 ; --level) {
+    node = node->sn_u.interior.sn_children[hioi_segment_child (node, offset)];
+  }
+
+  return node;
+}
+
+hio_manifest_segment_t *hioi_segment_index_find (const hio_segment_index_t *index, uint64_t offset) {
+  hio_segment_node_t *leaf;
+  int seg_index;
+
+  if (NULL == index->si_root) {
+    return NULL;
+  }
+
+  leaf = hioi_segment_leaf (index, offset);
+  seg_index = hioi_segment_upper (leaf, offset);
+
+  /* only the first leaf can be reached by an offset less than all of its segments */
+  return seg_index ? leaf->sn_u.sn_segments + seg_index - 1 : NULL;
+}
+
+hio_manifest_segment_t *hioi_segment_index_next (const hio_segment_index_t *index, uint64_t offset) {
+  hio_segment_node_t *leaf;
+  int seg_index;
+
+  if (NULL == index->si_root) {
+    return NULL;
+  }
+
+  leaf = hioi_segment_leaf (index, offset);
+  seg_index = hioi_segment_upper (leaf, offset);
+  if (seg_index < leaf->sn_count) {
+    return leaf->sn_u.sn_segments + seg_index;
+  }
+
+  return leaf->sn_next ? leaf->sn_next->sn_u.sn_segments : NULL;
+}
+
+/* insert a separator and child at position pos of an interior node. if the node is full it
+ * is split and the new right sibling is returned */
+static hio_segment_node_t *hioi_segment_interior_insert (hio_segment_node_t *node, int pos, uint64_t key,
+                                                         hio_segment_node_t *child) {
+  uint64_t keys[HIO_SEGMENT_NODE_MAX + 1];
+  hio_segment_node_t *children[HIO_SEGMENT_NODE_MAX + 1], *right;
+  int split;
+
+  if (node->sn_count < HIO_SEGMENT_NODE_MAX) {
+    memmove (node->sn_u.interior.sn_keys + pos + 1, node->sn_u.interior.sn_keys + pos,
+             (node->sn_count - pos) * sizeof (keys[0]));
+    memmove (node->sn_u.interior.sn_children + pos + 1, node->sn_u.interior.sn_children + pos,
+             (node->sn_count - pos) * sizeof (children[0]));
+    node->sn_u.interior.sn_keys[pos] = key;
+    node->sn_u.interior.sn_children[pos] = child;
+    ++node->sn_count;
+    return NULL;
+  }
+
+  right = calloc (1, sizeof (*right));
+  if (NULL == right) {
+    return NULL;
+  }
+
+  memcpy (keys, node->sn_u.interior.sn_keys, pos * sizeof (keys[0]));
+  memcpy (children, node->sn_u.interior.sn_children, pos * sizeof (children[0]));
+  keys[pos] = key;
+  children[pos] = child;
+  memcpy (keys + pos + 1, node->sn_u.interior.sn_keys + pos, (HIO_SEGMENT_NODE_MAX - pos) * sizeof (keys[0]));
+  memcpy (children + pos + 1, node->sn_u.interior.sn_children + pos,
+          (HIO_SEGMENT_NODE_MAX - pos) * sizeof (children[0]));
+
+  /* appending (the common case for in-order writers) leaves the left node full */
+  split = (HIO_SEGMENT_NODE_MAX == pos) ? HIO_SEGMENT_NODE_MAX : (HIO_SEGMENT_NODE_MAX + 1) / 2;
+
+  memcpy (node->sn_u.interior.sn_keys, keys, split * sizeof (keys[0]));
+  memcpy (node->sn_u.interior.sn_children, children, split * sizeof (children[0]));
+  node->sn_count = split;
+
+  right->sn_count = HIO_SEGMENT_NODE_MAX + 1 - split;
+  memcpy (right->sn_u.interior.sn_keys, keys + split, right->sn_count * sizeof (keys[0]));
+  memcpy (right->sn_u.interior.sn_children, children + split, right->sn_count * sizeof (children[0]));
+
+  return right;
+}
+
+int hioi_segment_index_insert (hio_segment_index_t *index, const hio_manifest_segment_t *segment) {
+  hio_segment_node_t *path[HIO_SEGMENT_MAX_HEIGHT];
+  hio_manifest_segment_t segments[HIO_SEGMENT_NODE_MAX + 1];
+  uint64_t offset = segment->seg_offset;
+  hio_segment_node_t *node, *right;
+  int slots[HIO_SEGMENT_MAX_HEIGHT];
+  int pos, split, depth;
+  uint64_t key;
+
+  if (NULL == index->si_root) {
+    index->si_root = calloc (1, sizeof (*index->si_root));
+    if (NULL == index->si_root) {
+      return HIO_ERR_OUT_OF_RESOURCE;
+    }
+  }
+
+  node = index->si_root;
+  for (depth = 0 ; depth < index->si_height ; ++depth) {
+    path[depth] = node;
+    slots[depth] = hioi_segment_child (node, offset);
+    node = node->sn_u.interior.sn_children[slots[depth]];
+  }
+
+  /* segments with the same offset are kept in insertion order */
+  pos = hioi_segment_upper (node, offset);
+
+  if (node->sn_count < HIO_SEGMENT_NODE_MAX) {
+    memmove (node->sn_u.sn_segments + pos + 1, node->sn_u.sn_segments + pos,
+             (node->sn_count - pos) * sizeof (segments[0]));
+    node->sn_u.sn_segments[pos] = *segment;
+    ++node->sn_count;
+    ++index->si_count;
+    return HIO_SUCCESS;
+  }
+
+  right = calloc (1, sizeof (*right));
+  if (NULL == right) {
+    return HIO_ERR_OUT_OF_RESOURCE;
+  }
+
+  memcpy (segments, node->sn_u.sn_segments, pos * sizeof (segments[0]));
+  segments[pos] = *segment;
+  memcpy (segments + pos + 1, node->sn_u.sn_segments + pos, (HIO_SEGMENT_NODE_MAX - pos) * sizeof (segments[0]));
+
+  split = (HIO_SEGMENT_NODE_MAX == pos) ? HIO_SEGMENT_NODE_MAX : (HIO_SEGMENT_NODE_MAX + 1) / 2;
+
+  memcpy (node->sn_u.sn_segments, segments, split * sizeof (segments[0]));
+  node->sn_count = split;
+  right->sn_count = HIO_SEGMENT_NODE_MAX + 1 - split;
+  memcpy (right->sn_u.sn_segments, segments + split, right->sn_count * sizeof (segments[0]));
+
+  right->sn_next = node->sn_next;
+  node->sn_next = right;
+  ++index->si_count;
+
+  /* push the new node up the tree splitting interior nodes as needed */
+  key = right->sn_u.sn_segments[0].seg_offset;
+  while (depth-- > 0) {
+    hio_segment_node_t *parent = path[depth];
+    bool full = HIO_SEGMENT_NODE_MAX == parent->sn_count;
+
+    node = hioi_segment_interior_insert (parent, slots[depth] + 1, key, right);
+    if (NULL == node) {
+      /* a full parent can only fail to split if memory is exhausted. the segment is in the
+       * leaf chain but can not be found by lookups */
+      return full ? HIO_ERR_OUT_OF_RESOURCE : HIO_SUCCESS;
+    }
+
+    right = node;
+    key = right->sn_u.interior.sn_keys[0];
+  }
+
+  if (index->si_height + 1 == HIO_SEGMENT_MAX_HEIGHT) {
+    return HIO_ERR_OUT_OF_RESOURCE;
+  }
+
+  /* the root was split. grow the tree */
+  node = calloc (1, sizeof (*node));
+  if (NULL == node) {
+    return HIO_ERR_OUT_OF_RESOURCE;
+  }
+
+  node->sn_count = 2;
+  node->sn_u.interior.sn_children[0] = index->si_root;
+  node->sn_u.interior.sn_children[1] = right;
+  node->sn_u.interior.sn_keys[1] = key;
+  index->si_root = node;
+  ++index->si_height;
+
+  return HIO_SUCCESS;
+}
+
+void hioi_segment_index_export (const hio_segment_index_t *index, hio_manifest_segment_t *segments) {
+  hio_segment_node_t *node = index->si_root;
+
+  if (NULL == node) {
+    return;
+  }
+
+  for (int level = index->si_height ; level > 0 ; --level) {
+    node = node->sn_u.interior.sn_children[0];
+  }
+
+  for ( ; node ; node = node->sn_next) {
+    memcpy (segments, node->sn_u.sn_segments, node->sn_count * sizeof (segments[0]));
+    segments += node->sn_count;
+  }
+}
@@ -0,0 +1,341 @@
+/* -*- Mode: C; c-basic-offset:2 ; indent-tabs-mode:nil -*- */
+/*
+ * Copyright (c) 2014-2016 Los Alamos National Security, LLC.  All rights
+ *                         reserved.
+ * $COPYRIGHT$
+ *
+ * Additional copyrights may follow
+ *
+ * $HEADER$
+ */
+
+/**
+ * @file hio_worker.c
+ * @brief asynchronous request processing
+ *
+ * Each context owns a pool of worker threads that process queued internal
+ * requests. Requests are queued by the non-blocking element read/write
+ * functions and are handed to the dataset's process requests function by
+ * a worker. Reads queued for coalescing are processed by the thread that
+ * completes them and are completed with hioi_worker_complete_requests(). All
+ * completion state (hio requests, dataset pending counts) is protected by the
+ * pool lock. Threads waiting on user requests block on a condition variable
+ * that is signaled as requests complete and process queued requests themselves
+ * while there is work in the queue. User requests are allocated from per-context
+ * slabs kept on a free list that is also protected by the pool lock.
+ */
+
+#include "hio_internal.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static void hioi_worker_complete (hio_worker_pool_t *pool, hio_internal_request_t *req, int rc) {
+  hio_dataset_t dataset = hioi_element_dataset (req->ir_element);
+
+  if (HIO_SUCCESS == rc && req->ir_status < 0) {
+    rc = req->ir_status;
+  }
+
+  if (req->ir_urequest) {
+    hio_request_t request = req->ir_urequest;
+
+    request->req_transferred = (req->ir_status > 0) ? req->ir_status : 0;
+    request->req_status = rc;
+    request->req_complete = true;
+
+    if (pool->wp_waiters) {
+      pthread_cond_broadcast (&pool->wp_complete);
+    }
+  } else if (HIO_SUCCESS != rc && HIO_SUCCESS == dataset->ds_async_status) {
+    /* no one to report the error to. save it for the next flush */
+    dataset->ds_async_status = rc;
+  }
+
+  if (0 == --dataset->ds_pending) {
+    pthread_cond_broadcast (&pool->wp_done);
+  }
+}
+
+/**
+ * Process the request at the head of the queue. Must be called with the pool lock
+ * held and a non-empty queue. The lock is dropped while the request is processed.
+ */
+static void hioi_worker_process_one (hio_worker_pool_t *pool) {
+  hio_internal_request_t *req;
+  hio_dataset_t dataset;
+  int rc;
+
+  req = hioi_list_item (pool->wp_queue.next, hio_internal_request_t, ir_list);
+  hioi_list_remove (req, ir_list);
+  --pool->wp_qcount;
+  pthread_mutex_unlock (&pool->wp_lock);
+
+  dataset = hioi_element_dataset (req->ir_element);
+  rc = dataset->ds_process_reqs (dataset, &req, 1);
+
+  pthread_mutex_lock (&pool->wp_lock);
+  hioi_worker_complete (pool, req, rc);
+  free (req);
+}
+
+static void *hioi_worker_main (void *arg) {
+  hio_context_t context = (hio_context_t) arg;
+  hio_worker_pool_t *pool = &context->c_workers;
+
+  pthread_mutex_lock (&pool->wp_lock);
+  do {
+    while (0 == pool->wp_qcount && !pool->wp_shutdown) {
+      pthread_cond_wait (&pool->wp_cond, &pool->wp_lock);
+    }
+
+    if (0 == pool->wp_qcount) {
+      /* shutting down and the queue has been drained */
+      break;
+    }
+
+    hioi_worker_process_one (pool);
+  } while (1);
+  pthread_mutex_unlock (&pool->wp_lock);
+
+  return NULL;
+}
+
+/**
+ * Start the worker threads. Must be called with the pool lock held.
+ */
+static int hioi_worker_pool_start (hio_context_t context) {
+  hio_worker_pool_t *pool = &context->c_workers;
+  int rc;
+
+  pool->wp_threads = calloc (context->c_io_threads, sizeof (pool->wp_threads[0]));
+  if (NULL == pool->wp_threads) {
+    return HIO_ERR_OUT_OF_RESOURCE;
+  }
+
+  for (int i = 0 ; i < context->c_io_threads ; ++i) {
+    rc = pthread_create (pool->wp_threads + i, NULL, hioi_worker_main, context);
+    if (0 != rc) {
+      hioi_log (context, HIO_VERBOSE_WARN, "could only start %d of %d I/O worker threads",
+                pool->wp_nthreads, context->c_io_threads);
+      break;
+    }
+
+    ++pool->wp_nthreads;
+  }
+
+  hioi_log (context, HIO_VERBOSE_DEBUG_LOW, "started %d I/O worker threads", pool->wp_nthreads);
+
+  return pool->wp_nthreads ? HIO_SUCCESS : HIO_ERROR;
+}
+
+/**
+ * Check if a request can be processed by a worker thread
+ */
+static bool hioi_worker_can_queue (hio_context_t context, const hio_internal_request_t *req) {
+#if HIO_MPI_HAVE(1)
+  /* reads (and prefetches) may need to look up segments in the dataset map using MPI one-sided operations */
+  if (context->c_use_mpi && !context->c_mpi_thread_multiple && HIO_REQUEST_TYPE_WRITE != req->ir_type) {
+    return false;
+  }
+#endif
+
+  return true;
+}
+
+void hioi_worker_pool_init (hio_context_t context) {
+  hio_worker_pool_t *pool = &context->c_workers;
+
+  pthread_mutex_init (&pool->wp_lock, NULL);
+  pthread_cond_init (&pool->wp_cond, NULL);
+  pthread_cond_init (&pool->wp_done, NULL);
+  pthread_cond_init (&pool->wp_complete, NULL);
+  hioi_list_init (pool->wp_queue);
+  hioi_list_init (pool->wp_free);
+  hioi_list_init (pool->wp_slabs);
+  pool->wp_waiters = 0;
+  pool->wp_qcount = 0;
+  pool->wp_threads = NULL;
+  pool->wp_nthreads = 0;
+  pool->wp_shutdown = false;
+}
+
+void hioi_worker_pool_fini (hio_context_t context) {
+  hio_worker_pool_t *pool = &context->c_workers;
+
+  pthread_mutex_lock (&pool->wp_lock);
+  pool->wp_shutdown = true;
+  pthread_cond_broadcast (&pool->wp_cond);
+  pthread_mutex_unlock (&pool->wp_lock);
+
+  for (int i = 0 ; i < pool->wp_nthreads ; ++i) {
+    pthread_join (pool->wp_threads[i], NULL);
+  }
+
+  free (pool->wp_threads);
+  pool->wp_threads = NULL;
+  pool->wp_nthreads = 0;
+
+  hioi_request_pool_fini (context);
+
+  pthread_cond_destroy (&pool->wp_complete);
+  pthread_cond_destroy (&pool->wp_done);
+  pthread_cond_destroy (&pool->wp_cond);
+  pthread_mutex_destroy (&pool->wp_lock);
+}
+
+int hioi_worker_submit (hio_dataset_t dataset, const hio_internal_request_t *req, hio_request_t *request) {
+  hio_context_t context = hioi_object_context (&dataset->ds_object);
+  hio_worker_pool_t *pool = &context->c_workers;
+  hio_internal_request_t *new_req, *reqs[1];
+  hio_request_t new_request = NULL;
+  int rc;
+
+  if (request) {
+    new_request = hioi_request_alloc (context);
+    if (NULL == new_request) {
+      return HIO_ERR_OUT_OF_RESOURCE;
+    }
+  }
+
+  new_req = malloc (sizeof (*new_req));
+  if (NULL == new_req) {
+    hioi_request_release (new_request);
+    return HIO_ERR_OUT_OF_RESOURCE;
+  }
+
+  memcpy (new_req, req, sizeof (*new_req));
+  new_req->ir_urequest = new_request;
+  new_req->ir_status = 0;
+
+  pthread_mutex_lock (&pool->wp_lock);
+  if (0 == pool->wp_nthreads && context->c_io_threads > 0 && !pool->wp_shutdown) {
+    rc = hioi_worker_pool_start (context);
+    if (HIO_SUCCESS != rc) {
+      /* fall back on processing requests synchronously */
+      context->c_io_threads = 0;
+    }
+  }
+
+  ++dataset->ds_pending;
+
+  if (0 == pool->wp_nthreads || !hioi_worker_can_queue (context, new_req)) {
+    pthread_mutex_unlock (&pool->wp_lock);
+
+    reqs[0] = new_req;
+    rc = dataset->ds_process_reqs (dataset, reqs, 1);
+
+    pthread_mutex_lock (&pool->wp_lock);
+    hioi_worker_complete (pool, new_req, rc);
+    pthread_mutex_unlock (&pool->wp_lock);
+    free (new_req);
+
+    if (NULL == new_request) {
+      /* error (if any) will be reported by the next flush */
+      return HIO_SUCCESS;
+    }
+
+    /* match the old behavior of returning errors immediately when the request was processed inline */
+    rc = new_request->req_status;
+    if (HIO_SUCCESS != rc) {
+      hioi_request_release (new_request);
+      return rc;
+    }
+
+    *request = new_request;
+    return HIO_SUCCESS;
+  }
+
+  hioi_list_append (new_req, pool->wp_queue, ir_list);
+  ++pool->wp_qcount;
+  pthread_cond_signal (&pool->wp_cond);
+  pthread_mutex_unlock (&pool->wp_lock);
+
+  if (request) {
+    *request = new_request;
+  }
+
+  return HIO_SUCCESS;
+}
+
+void hioi_worker_complete_requests (hio_dataset_t dataset, hio_internal_request_t **reqs, int count) {
+  hio_context_t context = hioi_object_context (&dataset->ds_object);
+  hio_worker_pool_t *pool = &context->c_workers;
+
+  pthread_mutex_lock (&pool->wp_lock);
+  for (int i = 0 ; i < count ; ++i) {
+    /* count the request as pending so it is completed like a queued request */
+    ++dataset->ds_pending;
+    hioi_worker_complete (pool, reqs[i], HIO_SUCCESS);
+  }
+  pthread_mutex_unlock (&pool->wp_lock);
+}
+
+int hioi_worker_drain (hio_dataset_t dataset) {
+  hio_context_t context = hioi_object_context (&dataset->ds_object);
+  hio_worker_pool_t *pool = &context->c_workers;
+  int rc, flush_rc;
+
+  flush_rc = hioi_dataset_read_flush (dataset);
+
+  pthread_mutex_lock (&pool->wp_lock);
+  while (dataset->ds_pending) {
+    pthread_cond_wait (&pool->wp_done, &pool->wp_lock);
+  }
+
+  rc = dataset->ds_async_status;
+  dataset->ds_async_status = HIO_SUCCESS;
+  pthread_mutex_unlock (&pool->wp_lock);
+
+  return (HIO_SUCCESS == rc) ? flush_rc : rc;
+}
+
+bool hioi_worker_request_complete (hio_request_t request) {
+  hio_context_t context = (hio_context_t) request->req_object.parent;
+  bool complete;
+
+  pthread_mutex_lock (&context->c_workers.wp_lock);
+  complete = request->req_complete;
+  pthread_mutex_unlock (&context->c_workers.wp_lock);
+
+  return complete;
+}
+
+/* check if any of the requests has completed. must be called with the pool lock held */
+static bool hioi_worker_any_complete (hio_request_t *requests, int nrequests) {
+  for (int i = 0 ; i < nrequests ; ++i) {
+    if (HIO_OBJECT_NULL != requests[i] && requests[i]->req_complete) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+void hioi_worker_wait (hio_request_t *requests, int nrequests) {
+  hio_worker_pool_t *pool = NULL;
+
+  for (int i = 0 ; i < nrequests && NULL == pool ; ++i) {
+    if (HIO_OBJECT_NULL != requests[i]) {
+      pool = &((hio_context_t) requests[i]->req_object.parent)->c_workers;
+    }
+  }
+
+  if (NULL == pool) {
+    return;
+  }
+
+  pthread_mutex_lock (&pool->wp_lock);
+  while (!hioi_worker_any_complete (requests, nrequests)) {
+    if (pool->wp_qcount) {
+      /* make progress on queued requests instead of sleeping */
+      hioi_worker_process_one (pool);
+      continue;
+    }
+
+    ++pool->wp_waiters;
+    pthread_cond_wait (&pool->wp_complete, &pool->wp_lock);
+    --pool->wp_waiters;
+  }
+  pthread_mutex_unlock (&pool->wp_lock);
+}
@@ -261,6 +261,11 @@
  *   Note: This function is currently experimental, it requires a pre-release version of DataWarp and
  *   compile time enablement via -DHIO_DATAWARP_DEBUG_LOG.
  *
+ * - @b io_threads - Number of threads used to process non-blocking reads and writes. Requests
+ *   started with hio_element_write_nb() or hio_element_read_nb() are queued and the call returns
+ *   immediately. When set to 0 requests are processed before the non-blocking call returns. The
+ *   default is 1. This value must be set before the first non-blocking request is started.
+ *
  * - @b print_statistics - Print IO statistics when hio_dataset_free() is called. This value is only meaningful
  *   on the first IO rank.
  *
@@ -284,11 +289,91 @@
  *   only supported with @ref HIO_SET_ELEMENT_SHARED.
  *
  * - @b dataset_block_size - Relevant only when the dataset_file_mode is either file_per_node or strided. This
- *   variable sets the internal block size and the filesystem stipe size (when supported).
+ *   variable sets the internal block size and the filesystem stipe size (when supported). If not set the
+ *   block size is 8M, raised to the stripe size in file_per_node mode. A block size set by the user is
+ *   never adjusted.
  *
  * - @b dataset_file_count - Relevant only when the dataset_file_mode is strided. Sets the number of files
  *   element blocks are strided across.
  *
+ * - @b dataset_direct_io - Open dataset files with O_DIRECT on POSIX-like file systems to bypass the
+ *   page cache. Unaligned transfers are staged through aligned buffers. If the file system does not
+ *   support direct I/O hio falls back on buffered I/O. Files written by more than one process (any
+ *   file mode other than basic with unique elements) are always written with buffered I/O.
+ *   Default: false
+ *
+ * - @b dataset_max_open_files - Relevant only when the dataset_file_mode is either file_per_node or strided.
+ *   Maximum number of data files each rank keeps open. When the limit is reached the least recently used
+ *   file is closed. Hits, misses, and evictions are reported by the file_cache_hits, file_cache_misses,
+ *   and file_cache_evictions performance variables. Default: 32
+ *
+ * - @b dataset_mmap_read - Only valid for datasets opened for reading. Map data files into memory on
+ *   POSIX-like file systems and copy element data out of the mapping instead of issuing a read system
+ *   call for each read. Takes precedence over dataset_direct_io. Default: false
+ *
+ * - @b dataset_read_ahead - Only valid for datasets opened for reading. Number of element reads to
+ *   prefetch once hio detects that an element is being read sequentially or with a fixed stride.
+ *   Prefetching is done by the I/O threads (see io_threads). Set to 0 to disable read-ahead. Default: 0
+ *
+ * - @b dataset_flush_threads - Only valid for datasets opened for writing. Number of threads used to
+ *   write out the dataset buffer (see dataset_buffer_size). Buffered data is split by target file (strided
+ *   mode) or into evenly sized pieces (other modes) and the pieces are written concurrently. Default: 1
+ *
+ * - @b dataset_preallocate - Only valid for datasets opened for writing. Preallocate space in optimized
+ *   and strided mode data files. In optimized mode the space expected in each file is calculated from
+ *   dataset_expected_size and is allocated when the file is opened. Blocks reserved beyond the expected
+ *   size are allocated as they are reserved. In strided mode each block is allocated when it is first
+ *   written. Unused space is released when the dataset is closed. Ignored on filesystems without
+ *   fallocate support. Default: true
+ *
+ * - @b dataset_writeback_size - Only valid for datasets opened for writing. Start writing back the
+ *   dirty pages of a data file each time this many bytes have been written to it. This reduces the
+ *   amount of data left to sync when the dataset is flushed with HIO_FLUSH_MODE_COMPLETE. 0 disables
+ *   early writeback. Default: 0
+ *
+ * - @b dataset_stripe_exclusive - Only valid in optimized file mode. Each rank on a node reserves
+ *   blocks from its own lane of the shared data file instead of from a single node-wide counter. On
+ *   filesystems that support striping there is one lane per stripe and the block size is set to the
+ *   stripe size so each lane maps to a single I/O server. Default: true
+ *
+ * - @b dataset_pack_threshold - Only valid in optimized file mode. Writes smaller than this many bytes
+ *   are packed into blocks shared by all ranks on a node instead of reserving a full block. Packed
+ *   writes are grouped by size so little space is lost at the end of each block. 0 disables packing.
+ *   Default: 64k
+ *
+ * - @b dataset_pack_alignment - Only valid in optimized file mode. Alignment (power of two) of packed
+ *   writes in the data file. Default: 4k
+ *
+ * - @b dataset_compression - Only valid in optimized file mode. Codec used to compress element
+ *   data before it is written. Valid values are "none" and "zlib" (if hio was built with zlib).
+ *   Compressed element data can not be overwritten. Default: none
+ *
+ * - @b dataset_compression_block_size - Only valid in optimized file mode. Element data is compressed
+ *   in independent blocks of this size. Reading any part of a block reads and decompresses the whole
+ *   block. Default: 1M
+ *
+ * - @b dataset_checksum - Only valid in optimized file mode. Store a crc32c checksum with each
+ *   segment of element data. Checksums are verified when the data is read and reads of data
+ *   that fails verification return HIO_ERR_CORRUPT. Default: false
+ *
+ * - @b dataset_incremental - Only valid in optimized file mode. Compare each block of element data
+ *   with the same block of the last instance of the dataset written by this context and only write
+ *   blocks that changed. Unchanged blocks refer to the data of the older dataset. A dataset can not
+ *   be unlinked while a newer dataset refers to its data. Data that already exists in the dataset
+ *   can not be overwritten. Default: false
+ *
+ * - @b dataset_incremental_block_size - Size of the element blocks compared when writing
+ *   incrementally. The compression block size is used if compression is enabled. Default: 1M
+ *
+ * - @b dataset_read_aggregate - Queue reads started with hio_element_read_nb() and
+ *   hio_element_read_strided_nb() that are smaller than a quarter of dataset_buffer_size. Queued
+ *   reads are issued when one of their requests is tested or waited on or when hio_complete() is
+ *   called. They are sorted by element and offset and nearby reads are serviced by a single read
+ *   of at most dataset_buffer_size bytes. Default: false
+ *
+ * - @b dataset_read_aggregate_gap - Largest gap in bytes between two queued reads (or two extents
+ *   of hio_element_read_list()) that are serviced by a single read. Default: 16k
+ *
  * - @b dataset_filesystem_type - Read only variable describing the filesystem backing a dataset. Valid
  *   values are "default" (posix-like), "lustre", and "gpfs". Additional types will be added in the
  *   future.
@@ -306,7 +391,9 @@
  *   if supported. Not valid for optimized file mode.
  *
  * - @b dataset_expected_size - Expected global size of a dataset in bytes. This value will be used when
- *   calculating the appropriate output interval for the dataset.
+ *   calculating the appropriate output interval for the dataset and when preallocating data files (see
+ *   dataset_preallocate). If not set this is a running average of the size of previous instances of
+ *   the dataset.
  *
  * @page page_example Examples
  * @section sec_example_c C Example
@@ -456,6 +543,8 @@ typedef enum hio_return_t {
   HIO_ERR_BAD_PARAM       = -7,
   /** Dataset id already exists */
   HIO_ERR_EXISTS          = -8,
+  /** Data read failed checksum verification */
+  HIO_ERR_CORRUPT         = -9,
   /** Temporary IO error. Try the IO again later. */
   HIO_ERR_IO_TEMPORARY   = -0x00010001,
   /** Permanent IO error. IO to the current data root is no longer available. */
@@ -746,6 +835,8 @@ hio_return_t hio_dataset_alloc (hio_context_t context, hio_dataset_t *set_out, c
  *          of processes.
  * @returns HIO_ERR_EXISTS if HIO_FLAG_CREAT is specified and the dataset id already
  *          exists in the current data root.
+ * @returns HIO_ERR_PERM if HIO_FLAG_TRUNC is specified and a newer incremental dataset
+ *          refers to the data of the existing dataset.
  *
  * This function attempts to open/create an hio dataset.
  */
@@ -806,6 +897,7 @@ hio_return_t hio_dataset_get_id (hio_dataset_t dataset, int64_t *set_id);
  *
  * @returns HIO_SUCCESS on success
  * @returns HIO_ERR_NOT_FOUND if the dataset id is not found
+ * @returns HIO_ERR_PERM if a newer incremental dataset refers to the dataset's data
  *
  * This function removes all data associated with an hio dataset on all data
  * roots. It is invalid to specify HIO_DATASET_ID_HIGHEST for {set_id}.
@@ -996,6 +1088,55 @@ hio_return_t hio_element_write_strided_nb (hio_element_t element, hio_request_t
                                            unsigned long reserved0, const void *ptr, size_t count, size_t size,
                                            size_t stride);
 
+/**
+ * @ingroup nonblocking
+ * @brief Write to an hio element without copying the data
+ *
+ * @param[in]  element      hio element handle
+ * @param[in]  offset       offset to write to
+ * @param[in]  reserved0    reserved for future use (pass 0)
+ * @param[in]  ptr          data to write
+ * @param[in]  count        number of elements to write
+ * @param[in]  size         size of each element
+ * @param[in]  stride       stride between each element (0 for contiguous data)
+ *
+ * @returns HIO_SUCCESS if the write has successfully been recorded
+ *
+ * This function records a write of the data specified by {ptr}, {size}, and {stride}
+ * to the element specified in {element} without copying it into the dataset's write
+ * buffer. The data is gathered directly from {ptr} when the buffered writes of the
+ * dataset are flushed. The application must not modify or free the buffer until the
+ * next call to hio_element_flush() or hio_dataset_flush() on any element of the dataset
+ * or until the element or dataset is closed. Any error occurring during the write will
+ * be reported by the flush or close. This is useful for applications that write many
+ * small fields that stay unchanged until the checkpoint is complete.
+ */
+hio_return_t hio_element_write_deferred (hio_element_t element, off_t offset, unsigned long reserved0,
+                                         const void *ptr, size_t count, size_t size, size_t stride);
+
+/**
+ * @ingroup blocking
+ * @brief Write a list of extents to an hio element
+ *
+ * @param[in]  element      hio element handle
+ * @param[in]  count        number of extents
+ * @param[in]  offsets      element offset of each extent
+ * @param[in]  ptrs         data to write for each extent
+ * @param[in]  lengths      length in bytes of each extent
+ *
+ * @returns the total number of bytes written if the write was successful or an
+ * hio_return_t value on error (all of which are negative)
+ *
+ * This function writes {count} extents to the element specified in {element}. Extent
+ * i writes {lengths[i]} bytes from {ptrs[i]} to element offset {offsets[i]}. The extents
+ * are handed to the backend as a single batch. Extents that are contiguous in the
+ * element are written with vectored writes. The order extents that overlap are written
+ * in is undefined. The call returns when all of the buffers are free to be modified.
+ * Completion of a write does not guarantee the data has been written to the data store.
+ */
+ssize_t hio_element_write_list (hio_element_t element, int count, const off_t *offsets, const void * const *ptrs,
+                                const size_t *lengths);
+
 /**
  * @ingroup nonblocking
  * @brief Complete all pending writes on all elements of a dataset
@@ -1147,6 +1288,28 @@ hio_return_t hio_element_read_strided_nb (hio_element_t element, hio_request_t *
                                           off_t offset, unsigned long reserved0, void *ptr,
                                           size_t count, size_t size, size_t stride);
 
+/**
+ * @ingroup blocking
+ * @brief Read a list of extents from an hio element
+ *
+ * @param[in]  element      hio element handle
+ * @param[in]  count        number of extents
+ * @param[in]  offsets      element offset of each extent
+ * @param[in]  ptrs         buffer to read each extent into
+ * @param[in]  lengths      length in bytes of each extent
+ *
+ * @returns the total number of bytes read if the read was successful or an
+ * hio_return_t value on error (all of which are negative)
+ *
+ * This function reads {count} extents from the element specified in {element}. Extent
+ * i reads {lengths[i]} bytes from element offset {offsets[i]} into {ptrs[i]}. The extents
+ * are processed as a single batch. Extents that are at most dataset_read_aggregate_gap
+ * bytes apart are serviced by a single read. This call returns when all of the buffers
+ * contain the requested data or the read failed.
+ */
+ssize_t hio_element_read_list (hio_element_t element, int count, const off_t *offsets, void * const *ptrs,
+                               const size_t *lengths);
+
 /**
  * @ingroup nonblocking
  * @brief Complete all outstanding read operations on an hio element.
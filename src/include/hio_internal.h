@@ -28,6 +28,10 @@
 #include <sys/time.h>
 #endif
 
+#if defined(HAVE_SYS_UIO_H)
+#include <sys/uio.h>
+#endif
+
 /**
  * Verbosity levels - preprocessor variables rather than an enum so
  * the value can be resolved to a numeric sring at compile time.
@@ -204,6 +208,75 @@ uint32_t hioi_crc32 (uint8_t *buf, size_t length);
  */
 uint64_t hioi_crc64 (uint8_t *buf, size_t length);
 
+/**
+ * Calculate the crc32c (Castagnoli) checksum of a buffer
+ *
+ * @param[in] crc     crc of the preceding data (0 to start a new checksum)
+ * @param[in] buf     buffer to checksum
+ * @param[in] length  length of buffer
+ *
+ * Uses the crc32 instructions on cpus that have them and a table-driven
+ * implementation that processes 8 bytes at a time otherwise. Checksums of
+ * consecutive buffers can be chained by passing the previous result as crc.
+ */
+uint32_t hioi_crc32c (uint32_t crc, const void *buf, size_t length);
+
+/**
+ * Calculate a 64-bit hash of a buffer
+ *
+ * @param[in] buf     buffer to hash
+ * @param[in] length  length of buffer
+ *
+ * Computes xxHash64 (seed 0). Used to detect unchanged blocks of element data.
+ * This is not a cryptographic hash.
+ */
+uint64_t hioi_hash64 (const void *buf, size_t length);
+
+/**
+ * Check if a data compression codec is available
+ *
+ * @param[in] codec   codec to check
+ */
+bool hioi_codec_available (hio_codec_t codec);
+
+/**
+ * Get the maximum compressed size of a buffer
+ *
+ * @param[in] codec   compression codec
+ * @param[in] length  length of the uncompressed buffer
+ */
+size_t hioi_compress_bound (hio_codec_t codec, size_t length);
+
+/**
+ * Compress a buffer
+ *
+ * @param[in]    codec       compression codec
+ * @param[in]    src         buffer to compress
+ * @param[in]    length      length of src
+ * @param[in]    dst         output buffer
+ * @param[inout] dst_length  size of dst on input. compressed length on output
+ *
+ * @returns HIO_SUCCESS on success
+ * @returns HIO_ERR_TRUNCATE if the compressed data does not fit in dst
+ * @returns HIO_ERR_NOT_AVAILABLE if the codec is not available
+ */
+int hioi_compress (hio_codec_t codec, const void *src, size_t length, void *dst, size_t *dst_length);
+
+/**
+ * Decompress a buffer
+ *
+ * @param[in] codec       compression codec
+ * @param[in] src         compressed data
+ * @param[in] length      length of src
+ * @param[in] dst         output buffer
+ * @param[in] dst_length  expected length of the decompressed data
+ *
+ * @returns HIO_SUCCESS on success
+ * @returns HIO_ERROR if the data is corrupt or does not decompress to dst_length bytes
+ * @returns HIO_ERR_NOT_AVAILABLE if the codec is not available
+ */
+int hioi_decompress (hio_codec_t codec, const void *src, size_t length, void *dst, size_t dst_length);
+
 /**
  * Get the associated context for an hio object
  *
@@ -304,6 +377,17 @@ int hioi_dataset_gather_manifest_comm (hio_dataset_t dataset, MPI_Comm comm, uns
  */
 void hioi_dataset_add_element (hio_dataset_t dataset, hio_element_t element);
 
+/**
+ * Merge contiguous segments in all elements of a dataset
+ *
+ * @param[in] dataset   dataset to compact
+ *
+ * Called before the manifest is generated to reduce the number of segments
+ * that have to be serialized, mapped, and searched. The number of segments
+ * removed is added to the segments_merged performance variable.
+ */
+int hioi_dataset_compact_segments (hio_dataset_t dataset);
+
 /* context dataset persistent data functions */
 
 /**
@@ -333,13 +417,193 @@ hio_dataset_backend_data_t *hioi_dbd_lookup_backend_data (hio_dataset_data_t *da
  */
 hio_element_t hioi_element_alloc (hio_dataset_t dataset, const char *name, const int rank);
 
+/**
+ * Allocate a user request
+ *
+ * @param[in] context   context the request belongs to
+ *
+ * Requests are taken from a per-context free list that is refilled a slab
+ * at a time.
+ */
 hio_request_t hioi_request_alloc (hio_context_t context);
 
+/**
+ * Return a user request to the free list of its context
+ */
 void hioi_request_release (hio_request_t request);
 
+/**
+ * Release the request slabs of a context
+ *
+ * @param[in] context   context to finalize
+ *
+ * Must only be called when no requests are in use.
+ */
+void hioi_request_pool_fini (hio_context_t context);
+
+/* asynchronous request functions */
+
+/**
+ * Initialize the asynchronous request worker pool on a context
+ *
+ * @param[in] context   context to initialize
+ *
+ * Worker threads are not started until the first request is submitted.
+ */
+void hioi_worker_pool_init (hio_context_t context);
+
+/**
+ * Stop all worker threads and release the worker pool
+ *
+ * @param[in] context   context to finalize
+ *
+ * Any queued requests are processed before the workers exit.
+ */
+void hioi_worker_pool_fini (hio_context_t context);
+
+/**
+ * Submit an internal request for asynchronous processing
+ *
+ * @param[in]  dataset  dataset the request operates on
+ * @param[in]  req      request to submit (copied)
+ * @param[out] request  new user request (may be NULL)
+ *
+ * @returns HIO_SUCCESS if the request was queued or completed successfully
+ * @returns HIO_ERR_OUT_OF_RESOURCE if a request could not be allocated
+ *
+ * If the context has no worker threads (io_threads = 0) the request is
+ * processed before this function returns.
+ */
+int hioi_worker_submit (hio_dataset_t dataset, const hio_internal_request_t *req, hio_request_t *request);
+
+/**
+ * Complete requests that were processed outside of the worker pool
+ *
+ * @param[in] dataset   dataset the requests operate on
+ * @param[in] reqs      processed requests (ir_status set)
+ * @param[in] count     number of requests
+ *
+ * The user request (if any) of each request is completed. Errors of requests
+ * without a user request are reported by the next flush.
+ */
+void hioi_worker_complete_requests (hio_dataset_t dataset, hio_internal_request_t **reqs, int count);
+
+/**
+ * Wait for all asynchronous requests on a dataset to complete
+ *
+ * @param[in] dataset   dataset to drain
+ *
+ * @returns HIO_SUCCESS if all requests without a user request completed successfully
+ * @returns the error code of the first failed request otherwise
+ *
+ * Queued reads are issued before waiting. This function must not be called with
+ * the dataset lock held.
+ */
+int hioi_worker_drain (hio_dataset_t dataset);
+
+/**
+ * Check if a user request has completed
+ *
+ * @param[in] request   user request
+ */
+bool hioi_worker_request_complete (hio_request_t request);
+
+/**
+ * Block until at least one of the user requests completes
+ *
+ * @param[in] requests  user requests (completed requests may be HIO_OBJECT_NULL)
+ * @param[in] nrequests number of requests
+ *
+ * The calling thread processes queued requests while it waits. Requests waiting
+ * in a read queue must be issued (see hioi_dataset_read_flush) before calling
+ * this function.
+ */
+void hioi_worker_wait (hio_request_t *requests, int nrequests);
+
 int hioi_element_add_segment (hio_element_t element, int file_index, uint64_t file_offset,
                               uint64_t app_offset, size_t seg_length);
 
+int hioi_element_insert_segment (hio_element_t element, const hio_manifest_segment_t *new_segment);
+
+void hioi_element_set_segment_crc (hio_element_t element, uint64_t app_offset, size_t length, uint32_t crc);
+
+/**
+ * Get the segments of an element sorted by application offset
+ *
+ * @param[in] element hio element handle
+ *
+ * @returns an array of element->e_segments.si_count segments or NULL on error
+ *
+ * The array is owned by the element and is valid until the next segment is
+ * added. It is used to serialize or map the segments.
+ */
+hio_manifest_segment_t *hioi_element_segments (hio_element_t element);
+
+/**
+ * Merge neighboring element segments that are contiguous in both the element
+ * and the file
+ *
+ * @param[in]  element hio element handle
+ * @param[out] merged  number of segments removed
+ */
+int hioi_element_compact_segments (hio_element_t element, uint64_t *merged);
+
+/**
+ * Freeze the segments of an element
+ *
+ * @param[in] element hio element handle
+ *
+ * After this call hioi_element_translate_offset() searches an immutable
+ * sorted copy of the segments without taking the element lock. No segments
+ * may be added to a frozen element. Used for elements of read-only datasets
+ * once the manifest has been loaded.
+ */
+int hioi_element_freeze_segments (hio_element_t element);
+
+/**
+ * Initialize an empty segment index
+ */
+void hioi_segment_index_init (hio_segment_index_t *index);
+
+/**
+ * Release all memory held by a segment index and leave it empty
+ */
+void hioi_segment_index_fini (hio_segment_index_t *index);
+
+/**
+ * Insert a copy of a segment into a segment index
+ *
+ * @param[in] index   segment index
+ * @param[in] segment segment to insert
+ *
+ * Segments with the same application offset are kept in insertion order.
+ * Pointers returned by hioi_segment_index_find() or hioi_segment_index_next()
+ * are invalidated by this call.
+ */
+int hioi_segment_index_insert (hio_segment_index_t *index, const hio_manifest_segment_t *segment);
+
+/**
+ * Find the last segment that starts at or before an application offset
+ *
+ * @returns the segment or NULL if every segment starts after offset
+ */
+hio_manifest_segment_t *hioi_segment_index_find (const hio_segment_index_t *index, uint64_t offset);
+
+/**
+ * Find the first segment that starts after an application offset
+ *
+ * @returns the segment or NULL if there is none
+ */
+hio_manifest_segment_t *hioi_segment_index_next (const hio_segment_index_t *index, uint64_t offset);
+
+/**
+ * Copy the segments of an index in application offset order
+ *
+ * @param[in]  index    segment index
+ * @param[out] segments array of at least index->si_count segments
+ */
+void hioi_segment_index_export (const hio_segment_index_t *index, hio_manifest_segment_t *segments);
+
 int hioi_element_find_offset (hio_element_t element, uint64_t app_offset, int rank,
                               off_t *offset, size_t *length);
 
@@ -402,6 +666,22 @@ int hioi_manifest_ranks (const unsigned char *manifest, size_t manifest_size, in
  */
 int hioi_manifest_read_header (hio_context_t context, hio_dataset_header_t *header, const char *path);
 
+/**
+ * Read the list of datasets a dataset depends on from its manifest
+ *
+ * @param[in]  context   hio context
+ * @param[in]  path      hio manifest to read
+ * @param[out] refs      identifiers of the datasets referenced (NULL if none)
+ * @param[out] ref_count number of entries in refs
+ *
+ * @returns HIO_SUCCESS on success
+ * @returns hio error code on error
+ *
+ * Incremental datasets refer to unchanged data stored by older datasets. The
+ * caller must free refs.
+ */
+int hioi_manifest_read_references (hio_context_t context, const char *path, int64_t **refs, int *ref_count);
+
 /* context functions */
 
 static inline bool hioi_context_using_mpi (hio_context_t context) {
@@ -479,6 +759,78 @@ int hioi_dataset_shared_fini (hio_dataset_t dataset);
  */
 int hioi_dataset_buffer_flush (hio_dataset_t dataset);
 
+/**
+ * Allocate the dataset buffer arena
+ *
+ * @param[in] dataset dataset handle
+ *
+ * The arena holds the request slots and iovec lists of buffered and deferred
+ * writes as well as the scratch space used to flush them. It is sized using
+ * the dataset_buffer_size configuration variable.
+ */
+int hioi_dataset_buffer_init (hio_dataset_t dataset);
+
+/**
+ * Release the dataset buffer arena
+ *
+ * @param[in] dataset dataset handle
+ */
+void hioi_dataset_buffer_fini (hio_dataset_t dataset);
+
+/**
+ * Sort internal requests by element and offset
+ *
+ * @param[in,out] reqs    requests to sort
+ * @param[in]     count   number of requests
+ * @param[in]     scratch storage for at least count request pointers
+ *
+ * This is a stable radix sort: requests with the same element and offset keep
+ * their relative order.
+ */
+void hioi_dataset_sort_requests (hio_internal_request_t **reqs, int count, hio_internal_request_t **scratch);
+
+/**
+ * Merge sorted writes that are contiguous in their element
+ *
+ * @param[in,out] reqs  sorted write requests
+ * @param[in]     count number of requests
+ * @param[in]     iov   storage for at least count iovec entries
+ *
+ * @returns the number of requests left in reqs
+ *
+ * The first request of each run of contiguous writes is extended to cover the
+ * run. If the data of the run is not contiguous in memory the request gathers it
+ * using entries of iov. Requests that already have an iovec list are not merged.
+ */
+int hioi_dataset_merge_writes (hio_internal_request_t **reqs, int count, struct iovec *iov);
+
+/**
+ * Process a batch of reads
+ *
+ * @param[in] dataset dataset handle
+ * @param[in] reqs    read requests (reordered)
+ * @param[in] count   number of requests
+ * @param[in] scratch storage for at least count request pointers
+ *
+ * This function sorts the reads by element and offset. Reads that are at most ds_read_gap
+ * bytes apart are serviced by a single read of up to ds_buffer_size bytes that is scattered
+ * to the user buffers. The status of each request is set on return. User requests are not
+ * completed.
+ */
+void hioi_dataset_process_reads (hio_dataset_t dataset, hio_internal_request_t **reqs, int count,
+                                 hio_internal_request_t **scratch);
+
+/**
+ * Issue queued reads
+ *
+ * @param[in] dataset dataset handle
+ *
+ * This function processes the reads queued on the dataset (see dataset_read_aggregate)
+ * with hioi_dataset_process_reads(). The requests of all queued reads are complete when
+ * this function returns.
+ */
+int hioi_dataset_read_flush (hio_dataset_t dataset);
+
 int hioi_element_open_internal (hio_dataset_t dataset, hio_element_t *element_out, const char *element_name,
                                 int flags, int rank);
 int hioi_element_close_internal (hio_element_t element);
@@ -491,20 +843,51 @@ int hioi_element_close_internal (hio_element_t element);
  * @param[out] file_index logical file index
  * @param[out] offset logical file offset
  * @param[inout] length length of application segment
+ * @param[out] segment_out copy of the matching segment (may be NULL)
  *
  * This function translates an application block into a logical file
  * segment. If a segment exists that matches the beginning of the
  * segment the index and offset are returned. If the application
  * block extends past the end of the segment the length is adjusted
- * to the end of the file segment.
+ * to the end of the file segment. The file offset is not meaningful
+ * for compressed segments. Use the segment descriptor instead.
  */
 int hioi_element_translate_offset (hio_element_t element, uint64_t app_offset, int *file_index,
-                                   uint64_t *offset, size_t *length);
+                                   uint64_t *offset, size_t *length, hio_manifest_segment_t *segment_out);
+
+/**
+ * Find the element offset of the first segment that starts after an offset
+ *
+ * @param[in] element hio element handle
+ * @param[in] app_offset application offset
+ *
+ * @returns the offset of the next segment or UINT64_MAX if there is none
+ *
+ * Writes that start in a hole use this to avoid allocating file space for data
+ * that already has a segment.
+ */
+uint64_t hioi_element_next_segment_offset (hio_element_t element, uint64_t app_offset);
 
 static inline bool hioi_dataset_doing_io (hio_dataset_t dataset) {
   return true;
 }
 
+/**
+ * Initialize an hio backing file structure
+ *
+ * @param[in] file
+ */
+void hioi_file_init (hio_file_t *file);
+
+/**
+ * Release resources associated with an hio backing file structure
+ *
+ * @param[in] file
+ *
+ * The file must be closed before calling this function.
+ */
+void hioi_file_fini (hio_file_t *file);
+
 /**
  * Helper function to close an hio backing file
  *
@@ -516,47 +899,132 @@ static inline bool hioi_dataset_doing_io (hio_dataset_t dataset) {
 int hioi_file_close (hio_file_t *file);
 
 /**
- * Seek to the given offset from whence
+ * Map an open hio backing file for reading
  *
  * @param[in] file hio file pointer
- * @param[in] offset relative offset from whence
- * @param[in] whence (see man page for lseek or fseek)
  *
- * This is a wrapper around leek and fseek that uses the appropriate
- * file based on how the file was opened (open/fopen/fdopen).
+ * After a successful call reads from the file are copied from the mapping
+ * instead of issuing read system calls. The mapping covers the size of the
+ * file at the time of the call and is removed by hioi_file_close(). The file
+ * must not be written while it is mapped.
  */
-int64_t hioi_file_seek (hio_file_t *file, int64_t offset, int whence);
+int hioi_file_map (hio_file_t *file);
 
 /**
- * Write to an hio backing file
+ * Write to an hio backing file at the given offset
  *
  * @param[in] file hio file pointer
  * @param[in] ptr data to write
  * @param[in] count number of bytes to write
+ * @param[in] offset file offset to write at
  *
- * This is a wrapper around write and fwrite that uses the appropriate
- * file based on how the file was opened (open/fopen/fdopen).
+ * This is a wrapper around pwrite that uses the appropriate file based on
+ * how the file was opened (open/fopen/fdopen). The file position is not
+ * shared so multiple threads may write to the same file concurrently.
+ * Writes to stdio streams are serialized on the stream lock.
  */
-ssize_t hioi_file_write (hio_file_t *file, const void *ptr, size_t count);
+ssize_t hioi_file_pwrite (hio_file_t *file, const void *ptr, size_t count, uint64_t offset);
 
 /**
- * Read from an hio backing file
+ * Read from an hio backing file at the given offset
  *
  * @param[in] file hio file pointer
- * @param[in] ptr data to read
+ * @param[in] ptr buffer to read into
  * @param[in] count number of bytes to read
+ * @param[in] offset file offset to read from
+ *
+ * This is a wrapper around pread that uses the appropriate file based on
+ * how the file was opened (open/fopen/fdopen).
+ */
+ssize_t hioi_file_pread (hio_file_t *file, void *ptr, size_t count, uint64_t offset);
+
+/**
+ * Write a vector of buffers to an hio backing file at the given offset
+ *
+ * @param[in] file hio file pointer
+ * @param[in] iov vector of buffers to write (modified)
+ * @param[in] iovcnt number of entries in iov
+ * @param[in] offset file offset to write at
+ *
+ * This is a wrapper around pwritev. The buffers are written to a contiguous
+ * region of the file starting at offset. The entries in iov may be modified
+ * to continue after a partial write. If pwritev is not available each buffer
+ * is written with hioi_file_pwrite().
+ */
+ssize_t hioi_file_pwritev (hio_file_t *file, struct iovec *iov, int iovcnt, uint64_t offset);
+
+/**
+ * Read a vector of buffers from an hio backing file at the given offset
  *
- * This is a wrapper around read and fread that uses the appropriate
- * file based on how the file was opened (open/fopen/fdopen).
+ * @param[in] file hio file pointer
+ * @param[in] iov vector of buffers to read into (modified)
+ * @param[in] iovcnt number of entries in iov
+ * @param[in] offset file offset to read from
+ *
+ * This is a wrapper around preadv (see hioi_file_pwritev()).
  */
-ssize_t hioi_file_read (hio_file_t *file, void *ptr, size_t count);
+ssize_t hioi_file_preadv (hio_file_t *file, struct iovec *iov, int iovcnt, uint64_t offset);
+
+/**
+ * Hint that a region of an hio backing file will be read soon
+ *
+ * @param[in] file hio file pointer
+ * @param[in] offset start of the region
+ * @param[in] length length of the region
+ *
+ * This starts reading the region into the page cache without waiting for
+ * the data. It is a no-op on systems without posix_fadvise.
+ */
+void hioi_file_prefetch (hio_file_t *file, uint64_t offset, size_t length);
+
+/**
+ * Allocate space for a region of an hio backing file
+ *
+ * @param[in] file hio file pointer
+ * @param[in] offset start of the region
+ * @param[in] length length of the region
+ *
+ * This allocates the extents backing the region without changing the size
+ * of the file. Regions below the preallocated end of the file (f_prealloc)
+ * are skipped.
+ *
+ * @returns HIO_SUCCESS on success
+ * @returns HIO_ERR_NOT_AVAILABLE if the filesystem does not support preallocation
+ */
+int hioi_file_preallocate (hio_file_t *file, uint64_t offset, uint64_t length);
+
+/**
+ * Allocate space for a region of an hio backing file without tracking it
+ *
+ * Unlike hioi_file_preallocate() this does not update the file's preallocation
+ * state so it can be called by multiple threads holding the file read lock.
+ *
+ * @returns HIO_SUCCESS on success
+ * @returns HIO_ERR_NOT_AVAILABLE if the filesystem does not support preallocation
+ */
+int hioi_file_allocate (hio_file_t *file, uint64_t offset, uint64_t length);
+
+/**
+ * Check if an hio backing file has been written since it was last synced
+ *
+ * @param[in] file hio file pointer
+ */
+static inline bool hioi_file_dirty (hio_file_t *file) {
+  return 0 != atomic_load (&file->f_dirty);
+}
 
 /**
  * Flush file data to backing file
  *
  * @param[in] file hio file pointer
+ *
+ * The file is synced even if it is not dirty. Writes to the file must not be
+ * in progress during the call.
+ *
+ * @returns HIO_SUCCESS on success
+ * @returns hio error code on failure
  */
-void hioi_file_flush (hio_file_t *file);
+int hioi_file_flush (hio_file_t *file);
 
 #if defined(DEBUG)
 #define hioi_timed_call(fn) {                   \
@@ -575,7 +1043,7 @@ void hioi_file_flush (hio_file_t *file);
 int hioi_dataset_generate_map (hio_dataset_t dataset);
 int hioi_dataset_map_release (hio_dataset_t dataset);
 int hioi_dataset_map_translate_offset (hio_element_t element, uint64_t app_offset, int *file_index,
-                                       uint64_t *offset, size_t *length);
+                                       uint64_t *offset, size_t *length, hio_manifest_segment_t *segment_out);
 #endif
 
 /* internal version of hio_config_get_info that doesn't strdup the name */
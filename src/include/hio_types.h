@@ -30,6 +30,8 @@
 #include <pthread.h>
 #endif
 
+#include <sys/uio.h>
+
 #if HIO_ATOMICS_C11
 
 #include <stdatomic.h>
@@ -41,7 +43,9 @@ typedef unsigned long atomic_ulong;
 
 #define atomic_init(p, v) (*(p) = v)
 #define atomic_fetch_add(p, v) __atomic_fetch_add(p, v, __ATOMIC_SEQ_CST)
-#define atomic_load(v) (*(v))
+#define atomic_fetch_sub(p, v) __atomic_fetch_sub(p, v, __ATOMIC_SEQ_CST)
+#define atomic_load(v) __atomic_load_n(v, __ATOMIC_SEQ_CST)
+#define atomic_store(p, v) __atomic_store_n(p, v, __ATOMIC_SEQ_CST)
 
 #elif HIO_ATOMICS_SYNC
 
@@ -49,7 +53,9 @@ typedef unsigned long atomic_ulong;
 
 #define atomic_init(p, v) (*(p) = v)
 #define atomic_fetch_add(p, v) __sync_fetch_and_add(p, v)
-#define atomic_load(v) (*(v))
+#define atomic_fetch_sub(p, v) __sync_fetch_and_sub(p, v)
+#define atomic_load(v) __sync_fetch_and_add(v, 0)
+#define atomic_store(p, v) do { __sync_synchronize (); *(p) = (v); __sync_synchronize (); } while (0)
 
 #endif
 
@@ -355,6 +361,36 @@ struct hio_object {
   hio_object_release_fn_t release_fn;
 };
 
+/**
+ * Pool of threads used to process non-blocking requests
+ */
+typedef struct hio_worker_pool_t {
+  /** protects the queue and the completion state of queued requests */
+  pthread_mutex_t wp_lock;
+  /** signaled when a request is queued or the pool is shutting down */
+  pthread_cond_t  wp_cond;
+  /** signaled when the last pending request on a dataset completes */
+  pthread_cond_t  wp_done;
+  /** signaled when a user request completes and there are waiters */
+  pthread_cond_t  wp_complete;
+  /** number of threads blocked in hio_request_wait() */
+  int             wp_waiters;
+  /** queued internal requests */
+  hio_list_t      wp_queue;
+  /** number of queued internal requests */
+  int             wp_qcount;
+  /** worker threads */
+  pthread_t      *wp_threads;
+  /** number of running worker threads */
+  int             wp_nthreads;
+  /** pool is shutting down */
+  bool            wp_shutdown;
+  /** free user requests */
+  hio_list_t      wp_free;
+  /** slabs the user requests are allocated from */
+  hio_list_t      wp_slabs;
+} hio_worker_pool_t;
+
 struct hio_context {
   struct hio_object c_object;
 
@@ -362,6 +398,8 @@ struct hio_context {
   /** internal communicator for this context */
   MPI_Comm          c_comm;
   bool              c_use_mpi;
+  /** MPI was initialized with MPI_THREAD_MULTIPLE */
+  bool              c_mpi_thread_multiple;
 #endif
   /** node:rank:context ID string for messages */
   char *            c_msg_id; 
@@ -419,6 +457,11 @@ struct hio_context {
 
   bool               c_enable_tracing;
   char              *c_trace_format;
+
+  /** number of threads to use for processing non-blocking requests */
+  int32_t            c_io_threads;
+  /** asynchronous request workers */
+  hio_worker_pool_t  c_workers;
 };
 
 struct hio_dataset_data_t {
@@ -437,7 +480,7 @@ struct hio_dataset_data_t {
   /** weighted average write time for a member of this dataset */
   uint64_t    dd_average_write_time;
 
-  /** average dataset size */
+  /** weighted average global size of a member of this dataset */
   uint64_t    dd_average_size;
 
   hio_list_t  dd_backend_data;
@@ -503,13 +546,46 @@ typedef struct hio_fs_attr_t hio_fs_attr_t;
 
 /**
  * hio buffer descriptor
+ *
+ * Buffered writes do not take the buffer lock. Each write reserves space in the
+ * buffer and a request slot with atomic operations, copies its data, then fills
+ * in the slot. The lock is only taken to flush the buffer (or to wait for another
+ * thread to flush it) and to record deferred writes.
+ *
+ * The request slots, the iovec lists of deferred writes, and the scratch space
+ * used by flushes are allocated as a single arena when the dataset is opened. The
+ * arena is reset after each flush so buffering does not allocate memory.
  */
 typedef struct hio_buffer_t {
-  hio_list_t b_reqlist;
-  int        b_reqcount;
+  /** serializes flushes and deferred writes. this is a recursive lock as the
+   * buffer is flushed while appending to it */
+  pthread_mutex_t b_lock;
   void      *b_base;
   size_t     b_size;
-  size_t     b_remaining;
+  /** number of bytes of the buffer reserved by writers. may exceed b_size if
+   * writers failed to reserve space */
+  atomic_ulong b_reserved;
+  /** number of request slots claimed by writers. may exceed b_max_slots */
+  atomic_ulong b_nslots;
+  /** number of writers currently reserving space or copying data */
+  atomic_ulong b_active;
+  /** non-zero while the buffer is being flushed */
+  atomic_ulong b_closed;
+  /** time spent copying data into the buffer since the last flush */
+  atomic_ulong b_time;
+  /** requests describing the buffered and deferred writes */
+  struct hio_internal_request_t *b_slots;
+  unsigned long b_max_slots;
+  /** last deferred write. its iovec list ends at b_iov + b_niov */
+  struct hio_internal_request_t *b_deferred;
+  /** iovec arena for deferred writes (b_max_slots entries) */
+  struct iovec *b_iov;
+  unsigned long b_niov;
+  /** flush scratch space: sorted requests, radix sort scratch, and iovec lists of
+   * merged writes (b_max_slots entries each) */
+  struct hio_internal_request_t **b_sorted;
+  struct hio_internal_request_t **b_scratch;
+  struct iovec *b_merge_iov;
 } hio_buffer_t;
 
 #if HIO_MPI_HAVE(3)
@@ -535,6 +611,14 @@ typedef struct hio_dataset_map_t {
 } hio_dataset_map_t;
 #endif /* HIO_MPI_HAVE(3) */
 
+/**
+ * Number of size classes used when packing small reservations into shared blocks.
+ * Class 0 holds reservations up to HIO_SHARED_PACK_MIN bytes. Each class after
+ * that holds reservations up to twice the size of the previous class.
+ */
+#define HIO_SHARED_PACK_CLASSES 12
+#define HIO_SHARED_PACK_MIN     4096
+
 /**
  * Data structure for control block in shared memory
  */
@@ -542,6 +626,16 @@ typedef struct hio_shared_control_t {
   /** master rank in context */
   int32_t      s_master;
 
+  /** small reservation packing. each size class fills one shared block at a time */
+  struct {
+    /** coordination lock for this size class */
+    pthread_mutex_t p_mutex;
+    /** next free offset in the current block */
+    uint64_t p_offset;
+    /** space left in the current block */
+    uint64_t p_remaining;
+  } s_pack[HIO_SHARED_PACK_CLASSES];
+
   /** stripe coordination structure */
   struct {
     /** coordination lock for this stripe */
@@ -605,8 +699,27 @@ struct hio_dataset {
   /** buffer size to allocate for aggregating reads/writes */
   uint64_t            ds_buffer_size;
 
+  /** expected global size of the dataset (defaults to the average size of previous members) */
+  uint64_t            ds_expected_size;
+
+  /** required alignment of the aggregation buffer (set by the backend, 0 for the default) */
+  size_t              ds_buffer_align;
+
   hio_buffer_t        ds_buffer;
 
+  /** queue non-blocking reads and coalesce them when they are completed */
+  bool                ds_read_aggregate;
+  /** largest gap in bytes between queued reads that are coalesced */
+  uint64_t            ds_read_gap;
+  /** queued reads (protected by the buffer lock) */
+  hio_list_t          ds_rqueue;
+  /** number of entries in ds_rqueue */
+  int                 ds_rqueue_count;
+  /** number of queued reads serviced by a coalesced read */
+  uint64_t            ds_reads_coalesced;
+  /** number of element segments removed by hioi_dataset_compact_segments() */
+  uint64_t            ds_segments_merged;
+
 #if HIO_MPI_HAVE(3)
   MPI_Win             ds_shared_win;
   hio_dataset_map_t   ds_map;
@@ -622,6 +735,20 @@ struct hio_dataset {
 
   /** process multiple requests */
   hio_dataset_process_requests_fn_t ds_process_reqs;
+
+  /** process the sorted requests from the aggregation buffer (optional, ds_process_reqs
+   * is used if not set) */
+  hio_dataset_process_requests_fn_t ds_flush_reqs;
+
+  /** number of queued or active asynchronous requests (protected by the context worker lock) */
+  int                 ds_pending;
+  /** first error from an asynchronous request that had no user request */
+  int                 ds_async_status;
+
+  /** identifiers of older datasets holding data referenced by this dataset (incremental datasets) */
+  int64_t            *ds_refs;
+  /** number of entries in ds_refs */
+  int                 ds_ref_count;
 };
 
 typedef struct hio_file_t {
@@ -631,25 +758,64 @@ typedef struct hio_file_t {
   int       f_fd;
   /** file identifier */
   int       f_bid;
-  /** current offset in the file */
-  uint64_t  f_offset;
+  /** identifier of the dataset the file belongs to (files of other datasets hold referenced data) */
+  int64_t   f_dsid;
   /** element associated with the file (if any) */
   hio_element_t f_element;
+  /** position of the file in a backend's open file cache (if any) */
+  hio_list_t f_lru;
+  /** hash bucket of the file in a backend's open file cache (if any) */
+  hio_list_t f_hash;
+  /** held for reading while I/O is in progress on the file and for writing
+   * while the file is being opened or closed */
+  pthread_rwlock_t f_lock;
+  /** required alignment of transfers when the file was opened for direct I/O (0 otherwise) */
+  size_t    f_align;
+  /** logical size of a file open for direct writes */
+  uint64_t  f_size;
+  /** direct writes padded the file past f_size */
+  bool      f_extended;
+  /** serializes read-modify-write of partial blocks during direct I/O */
+  pthread_mutex_t f_rmw_lock;
+  /** read-only mapping of the file (NULL if the file is not mapped) */
+  void     *f_map;
+  /** size of the mapping */
+  size_t    f_map_size;
+  /** end of the region of the file that has been preallocated (see hioi_file_preallocate) */
+  uint64_t  f_prealloc;
+  /** end of the furthest region preallocated since the file was opened */
+  uint64_t  f_prealloc_end;
+  /** bitmap of the blocks preallocated since the file was opened (strided mode) */
+  unsigned long *f_pblocks;
+  /** number of blocks that fit in f_pblocks */
+  size_t    f_pblocks_count;
+  /** number of bytes written since the file was last synced */
+  atomic_ulong f_dirty;
+  /** start writing back dirty pages each time this many bytes are written (0: disabled) */
+  uint64_t  f_wb_size;
 } hio_file_t;
 
 struct hio_request {
   struct hio_object req_object;
+  /** free list entry */
+  hio_list_t        req_list;
   /** completion indicator */
   bool              req_complete;
   /** number of bytes transferred */
   size_t            req_transferred;
   /** status of the request */
   int               req_status;
+  /** dataset whose read queue must be flushed for this request to complete (NULL if the
+   * request was not queued) */
+  hio_dataset_t     req_dataset;
 };
 
 typedef enum hio_request_type_t {
   HIO_REQUEST_TYPE_READ,
   HIO_REQUEST_TYPE_WRITE,
+  /** hint that ir_count ranges of ir_size bytes starting at ir_offset and separated by
+   * ir_stride bytes in the element will be read soon. no data is transferred. */
+  HIO_REQUEST_TYPE_PREFETCH,
 } hio_request_type_t;
 
 typedef struct hio_internal_request_t {
@@ -666,9 +832,24 @@ typedef struct hio_internal_request_t {
   size_t        ir_transferred;
   int           ir_status;
   hio_request_type_t ir_type;
-  hio_request_t *ir_urequest;
+  /** user request to complete when this request finishes (may be NULL) */
+  hio_request_t ir_urequest;
+  /** user buffers of a deferred write (see hio_element_write_deferred()). when set the
+   * request writes ir_size contiguous element bytes gathered from this list starting at
+   * ir_data.w which points into the first entry. NULL for all other requests. */
+  struct iovec *ir_iov;
+  /** number of entries in ir_iov */
+  int           ir_iovcnt;
 } hio_internal_request_t;
 
+/** codecs that can be used to compress dataset data */
+typedef enum hio_codec_t {
+  /** data is stored as written */
+  HIO_CODEC_NONE = 0,
+  /** zlib (deflate) */
+  HIO_CODEC_ZLIB = 1,
+} hio_codec_t;
+
 typedef struct hio_manifest_segment_t {
   /** application offset */
   uint64_t   seg_offset;
@@ -678,8 +859,42 @@ typedef struct hio_manifest_segment_t {
   uint64_t   seg_foffset;
   /** file index */
   int        seg_file_index;
+  /** codec used to compress the segment. compressed segments must be read whole */
+  hio_codec_t seg_codec;
+  /** length of the segment in the file if compressed (0 otherwise) */
+  uint64_t   seg_clength;
+  /** crc32c of the segment data as stored in the file */
+  uint32_t   seg_crc;
+  /** seg_crc is valid. checksummed segments must be read whole to be verified */
+  bool       seg_has_crc;
+  /** the data of a new checksummed segment is being written. seg_crc is set once the
+   * write completes. pending segments are never merged with their neighbors */
+  bool       seg_crc_pending;
+  /** hash of the uncompressed segment data (incremental datasets) */
+  uint64_t   seg_hash;
+  /** seg_hash is valid */
+  bool       seg_has_hash;
+  /** the segment data is stored in the files of dataset seg_ref_id */
+  bool       seg_is_ref;
+  /** identifier of the dataset that holds the segment data (if seg_is_ref) */
+  int64_t    seg_ref_id;
 } hio_manifest_segment_t;
 
+struct hio_segment_node_t;
+
+/**
+ * Ordered index of element segments. Segments are stored in the leaves
+ * of a B+tree keyed by application offset (see hio_segment.c).
+ */
+typedef struct hio_segment_index_t {
+  /** root node (NULL if the index is empty) */
+  struct hio_segment_node_t *si_root;
+  /** number of interior levels above the leaves */
+  int                        si_height;
+  /** number of segments in the index */
+  size_t                     si_count;
+} hio_segment_index_t;
+
 struct hio_element {
   struct hio_object e_object;
 
@@ -689,10 +904,17 @@ struct hio_element {
   /** elements are held in a list on the associated dataset */
   hio_list_t        e_list;
 
-  /** segment list */
-  size_t            e_scount;
-  size_t            e_ssize;
+  /** segment index */
+  hio_segment_index_t e_segments;
+  /** sorted copy of the segments (see hioi_element_segments()) */
   hio_manifest_segment_t *e_sarray;
+  /** number of entries allocated in e_sarray */
+  size_t            e_ssize;
+  /** e_sarray matches e_segments */
+  bool              e_sarray_valid;
+  /** segments are frozen in e_sarray and can be looked up without locking
+   * (read-only datasets, see hioi_element_freeze_segments()) */
+  bool              e_frozen;
 
   /** global element identifier (shared dataset only) used
    * to uniquely identify this element in the global map */
@@ -706,6 +928,28 @@ struct hio_element {
 
   hio_file_t        e_file;
 
+  /** read-ahead state: offset and size of the last read, distance between the last
+   * two reads, number of consecutive reads at that distance, and the end of the
+   * prefetched region */
+  uint64_t          e_ra_last;
+  size_t            e_ra_size;
+  int64_t           e_ra_delta;
+  int               e_ra_hits;
+  uint64_t          e_ra_end;
+
+  /** last compressed segment read by this element: decompressed data along with the
+   * dataset, file index, and file offset of the segment */
+  void             *e_zbuf;
+  int64_t           e_zdsid;
+  int               e_zfile;
+  uint64_t          e_zoffset;
+  /** incremented each time the element segments change. a segment read is only cached
+   * if no write completed while it was being read */
+  uint64_t          e_zgen;
+
+  /** serializes recomputing segment checksums after partial overwrites */
+  pthread_mutex_t   e_crc_lock;
+
   /** function to flush pending element writes */
   hio_element_flush_fn_t e_flush;
 
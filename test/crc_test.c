@@ -0,0 +1,122 @@
+/* -*- Mode: C; c-basic-offset:2 ; indent-tabs-mode:nil -*- */
+/*
+ * Copyright (c) 2014-2016 Los Alamos National Security, LLC.  All rights
+ *                         reserved.
+ * $COPYRIGHT$
+ *
+ * Additional copyrights may follow
+ *
+ * $HEADER$
+ */
+
+/* Known answer tests for each crc32c implementation. The source is included
+ * directly so the implementations that are not selected on this cpu can be
+ * called. */
+
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "../src/hio_crc.c"
+
+#define CRC_TEST_BUFFER_SIZE 4096
+
+typedef struct crc_test_impl_t {
+  const char *name;
+  hioi_crc32c_fn_t fn;
+} crc_test_impl_t;
+
+/* bit at a time reference crc32c */
+static uint32_t crc_test_reference (uint32_t crc, const uint8_t *buf, size_t length) {
+  crc = ~crc;
+
+  while (length--) {
+    crc ^= *buf++;
+    for (int j = 0 ; j < 8 ; ++j) {
+      crc = (crc >> 1) ^ (CRC32CPOLY & -(crc & 1));
+    }
+  }
+
+  return ~crc;
+}
+
+static int crc_test_impl (const crc_test_impl_t *impl, const uint8_t *data) {
+  const char *check = "123456789";
+  uint32_t crc, expected;
+  int failed = 0;
+
+  crc = ~impl->fn (~0u, (const uint8_t *) check, 9);
+  if (0xe3069283 != crc) {
+    fprintf (stderr, "%s: crc32c(\"%s\") = 0x%08x, expected 0xe3069283\n", impl->name, check, crc);
+    ++failed;
+  }
+
+  /* cover every alignment of the start and end of the buffer so the byte loops
+   * and the 8 byte loop are all exercised */
+  for (size_t start = 0 ; start < 16 ; ++start) {
+    for (size_t length = 0 ; length < 64 ; ++length) {
+      expected = crc_test_reference (0, data + start, length);
+      crc = ~impl->fn (~0u, data + start, length);
+      if (expected != crc) {
+        fprintf (stderr, "%s: crc32c mismatch at start %lu length %lu. got 0x%08x, expected 0x%08x\n",
+                 impl->name, (unsigned long) start, (unsigned long) length, crc, expected);
+        ++failed;
+      }
+    }
+  }
+
+  expected = crc_test_reference (0, data + 3, CRC_TEST_BUFFER_SIZE - 3);
+  crc = ~impl->fn (~0u, data + 3, CRC_TEST_BUFFER_SIZE - 3);
+  if (expected != crc) {
+    fprintf (stderr, "%s: crc32c mismatch on %d byte buffer. got 0x%08x, expected 0x%08x\n", impl->name,
+             CRC_TEST_BUFFER_SIZE - 3, crc, expected);
+    ++failed;
+  }
+
+  return failed;
+}
+
+int main (int argc, char *argv[]) {
+  crc_test_impl_t impls[3];
+  int nimpls = 0, failed = 0;
+  uint8_t *data;
+  uint32_t crc;
+
+  data = malloc (CRC_TEST_BUFFER_SIZE);
+  if (NULL == data) {
+    return EXIT_FAILURE;
+  }
+
+  for (int i = 0 ; i < CRC_TEST_BUFFER_SIZE ; ++i) {
+    data[i] = (uint8_t) (i * 2654435761u >> 13);
+  }
+
+  crc_init_tables ();
+
+  impls[nimpls++] = (crc_test_impl_t) {.name = "slicing-by-8", .fn = hioi_crc32c_sw};
+#if HIO_CRC32C_SSE42
+  if (__builtin_cpu_supports ("sse4.2")) {
+    impls[nimpls++] = (crc_test_impl_t) {.name = "sse4.2", .fn = hioi_crc32c_sse42};
+  } else {
+    fprintf (stderr, "sse4.2 not supported by this cpu. skipping\n");
+  }
+#elif HIO_CRC32C_ARM
+  impls[nimpls++] = (crc_test_impl_t) {.name = "arm", .fn = hioi_crc32c_arm};
+#endif
+
+  for (int i = 0 ; i < nimpls ; ++i) {
+    failed += crc_test_impl (impls + i, data);
+  }
+
+  /* the selected implementation through the public entry point. checksums of
+   * consecutive buffers are chained */
+  crc = hioi_crc32c (0, "1234", 4);
+  crc = hioi_crc32c (crc, "56789", 5);
+  if (0xe3069283 != crc) {
+    fprintf (stderr, "hioi_crc32c: chained crc32c = 0x%08x, expected 0xe3069283\n", crc);
+    ++failed;
+  }
+
+  free (data);
+
+  return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,245 @@
+/* -*- Mode: C; c-basic-offset:2 ; indent-tabs-mode:nil -*- */
+/*
+ * Copyright (c) 2014-2016 Los Alamos National Security, LLC.  All rights
+ *                         reserved.
+ * $COPYRIGHT$
+ *
+ * Additional copyrights may follow
+ *
+ * $HEADER$
+ */
+
+/*
+ * Multi-threaded buffered write benchmark
+ *
+ * usage: test02.x [-t max_threads] [-n writes_per_thread] [-s write_size] [-c config_file]
+ *
+ * Each rank writes to a shared element from 1, 2, 4, ... max_threads threads. Every thread
+ * issues small hio_element_write calls (which are buffered by the dataset) to its own
+ * region of the element. The aggregate write rate for each thread count is reported by
+ * rank 0 and the data is read back and checked. Set HIO_data_roots to choose where the
+ * datasets are written.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/time.h>
+
+#include <mpi.h>
+#include <hio.h>
+
+struct thread_args {
+  hio_element_t element;
+  int nwrites;
+  size_t size;
+  uint64_t base;
+  int rc;
+};
+
+static unsigned char pattern (uint64_t offset) {
+  return (unsigned char) ((offset * 2654435761u) >> 13);
+}
+
+static void *write_thread (void *arg) {
+  struct thread_args *args = (struct thread_args *) arg;
+  unsigned char *data = malloc (args->nwrites * args->size);
+
+  args->rc = HIO_SUCCESS;
+
+  if (NULL == data) {
+    args->rc = HIO_ERR_OUT_OF_RESOURCE;
+    return NULL;
+  }
+
+  for (size_t i = 0 ; i < args->nwrites * args->size ; ++i) {
+    data[i] = pattern (args->base + i);
+  }
+
+  for (int i = 0 ; i < args->nwrites ; ++i) {
+    ssize_t rc = hio_element_write (args->element, args->base + i * args->size, 0, data + i * args->size,
+                                    1, args->size);
+    if (rc != (ssize_t) args->size) {
+      args->rc = (int) rc;
+      break;
+    }
+  }
+
+  free (data);
+
+  return NULL;
+}
+
+static double wtime (void) {
+  struct timeval tv;
+
+  gettimeofday (&tv, NULL);
+
+  return (double) tv.tv_sec + (double) tv.tv_usec * 1e-6;
+}
+
+static int check_data (hio_context_t context, int64_t id, uint64_t base, size_t length) {
+  unsigned char *data = malloc (length);
+  hio_dataset_t dataset;
+  hio_element_t element;
+  int errors = 0;
+  ssize_t rc;
+
+  if (NULL == data) {
+    return 1;
+  }
+
+  if (HIO_SUCCESS != hio_dataset_alloc (context, &dataset, "mtwrite", id, HIO_FLAG_READ, HIO_SET_ELEMENT_SHARED) ||
+      HIO_SUCCESS != hio_dataset_open (dataset)) {
+    fprintf (stderr, "Could not open dataset %ld for reading\n", (long) id);
+    free (data);
+    return 1;
+  }
+
+  if (HIO_SUCCESS == hio_element_open (dataset, &element, "data", 0)) {
+    rc = hio_element_read (element, base, 0, data, 1, length);
+    if (rc != (ssize_t) length) {
+      fprintf (stderr, "Short read from dataset %ld: %ld\n", (long) id, (long) rc);
+      ++errors;
+    }
+
+    for (size_t i = 0 ; i < length && !errors ; ++i) {
+      if (data[i] != pattern (base + i)) {
+        fprintf (stderr, "Data mismatch in dataset %ld at offset %lu\n", (long) id, (unsigned long) (base + i));
+        ++errors;
+      }
+    }
+
+    hio_element_close (&element);
+  } else {
+    ++errors;
+  }
+
+  hio_dataset_close (dataset);
+  hio_dataset_free (&dataset);
+  free (data);
+
+  return errors;
+}
+
+int main (int argc, char *argv[]) {
+  int max_threads = 8, nwrites = 16384, rank, nranks, opt, errors = 0;
+  MPI_Comm comm = MPI_COMM_WORLD;
+  char *config_file = NULL;
+  size_t size = 64;
+  hio_context_t context;
+  int rc;
+
+  MPI_Init (&argc, &argv);
+  MPI_Comm_rank (MPI_COMM_WORLD, &rank);
+  MPI_Comm_size (MPI_COMM_WORLD, &nranks);
+
+  while (-1 != (opt = getopt (argc, argv, "t:n:s:c:"))) {
+    switch (opt) {
+    case 't':
+      max_threads = atoi (optarg);
+      break;
+    case 'n':
+      nwrites = atoi (optarg);
+      break;
+    case 's':
+      size = strtoul (optarg, NULL, 0);
+      break;
+    case 'c':
+      config_file = optarg;
+      break;
+    default:
+      fprintf (stderr, "usage: %s [-t max_threads] [-n writes_per_thread] [-s write_size] [-c config_file]\n",
+               argv[0]);
+      MPI_Abort (MPI_COMM_WORLD, 1);
+    }
+  }
+
+  rc = hio_init_mpi (&context, &comm, config_file, "#HIO.", "mtwrite");
+  if (HIO_SUCCESS != rc) {
+    fprintf (stderr, "Could not initialize hio\n");
+    MPI_Abort (MPI_COMM_WORLD, 1);
+  }
+
+  for (int nthreads = 1, id = 1 ; nthreads <= max_threads ; nthreads <<= 1, ++id) {
+    struct thread_args args[nthreads];
+    pthread_t threads[nthreads];
+    uint64_t rank_size = (uint64_t) nthreads * nwrites * size;
+    hio_dataset_t dataset;
+    hio_element_t element;
+    double start, elapsed;
+
+    rc = hio_dataset_alloc (context, &dataset, "mtwrite", id, HIO_FLAG_WRITE | HIO_FLAG_CREAT | HIO_FLAG_TRUNC,
+                            HIO_SET_ELEMENT_SHARED);
+    if (HIO_SUCCESS == rc) {
+      rc = hio_dataset_open (dataset);
+    }
+
+    if (HIO_SUCCESS != rc) {
+      fprintf (stderr, "Could not create dataset %d. reason: %d\n", id, rc);
+      MPI_Abort (MPI_COMM_WORLD, 1);
+    }
+
+    rc = hio_element_open (dataset, &element, "data", 0);
+    if (HIO_SUCCESS != rc) {
+      fprintf (stderr, "Could not create dataset element. reason: %d\n", rc);
+      MPI_Abort (MPI_COMM_WORLD, 1);
+    }
+
+    MPI_Barrier (MPI_COMM_WORLD);
+    start = wtime ();
+
+    for (int i = 0 ; i < nthreads ; ++i) {
+      args[i].element = element;
+      args[i].nwrites = nwrites;
+      args[i].size = size;
+      args[i].base = rank * rank_size + (uint64_t) i * nwrites * size;
+      pthread_create (threads + i, NULL, write_thread, args + i);
+    }
+
+    for (int i = 0 ; i < nthreads ; ++i) {
+      pthread_join (threads[i], NULL);
+      if (HIO_SUCCESS != args[i].rc) {
+        fprintf (stderr, "Error writing data from thread %d. reason: %d\n", i, args[i].rc);
+        ++errors;
+      }
+    }
+
+    rc = hio_element_close (&element);
+    if (HIO_SUCCESS == rc) {
+      rc = hio_dataset_close (dataset);
+    }
+
+    if (HIO_SUCCESS != rc) {
+      fprintf (stderr, "Error closing dataset. reason: %d\n", rc);
+      ++errors;
+    }
+
+    elapsed = wtime () - start;
+    MPI_Allreduce (MPI_IN_PLACE, &elapsed, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+
+    hio_dataset_free (&dataset);
+
+    if (0 == rank) {
+      double mib = (double) rank_size * nranks / (1024.0 * 1024.0);
+      printf ("threads: %3d writes: %10lu size: %6lu time: %8.3f s rate: %10.2f MiB/s %10.0f writes/s\n",
+              nthreads, (unsigned long) nthreads * nwrites * nranks, (unsigned long) size, elapsed,
+              mib / elapsed, (double) nthreads * nwrites * nranks / elapsed);
+    }
+
+    errors += check_data (context, id, rank * rank_size, rank_size);
+  }
+
+  MPI_Allreduce (MPI_IN_PLACE, &errors, 1, MPI_INT, MPI_SUM, MPI_COMM_WORLD);
+  if (0 == rank && errors) {
+    fprintf (stderr, "%d errors detected\n", errors);
+  }
+
+  (void) hio_fini (&context);
+  MPI_Finalize ();
+
+  return errors ? 1 : 0;
+}
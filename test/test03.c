@@ -0,0 +1,283 @@
+/* -*- Mode: C; c-basic-offset:2 ; indent-tabs-mode:nil -*- */
+/*
+ * Copyright (c) 2014-2016 Los Alamos National Security, LLC.  All rights
+ *                         reserved.
+ * $COPYRIGHT$
+ *
+ * Additional copyrights may follow
+ *
+ * $HEADER$
+ */
+
+/*
+ * Incremental write test
+ *
+ * usage: test03.x data_root
+ *
+ * Each rank writes its part of a shared element to dataset 1 then writes dataset 2 with
+ * only one block changed. Run with HIO_dataset_file_mode=file_per_node and
+ * HIO_dataset_incremental=1. The test checks that the unchanged blocks were not written,
+ * that dataset 2 records its reference to dataset 1, that dataset 1 can neither be
+ * unlinked nor truncated while dataset 2 exists, and that dataset 2 reads back correctly.
+ * data_root must be a posix data root.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <mpi.h>
+#include <hio.h>
+
+#define TEST03_BLOCK_SIZE   (1ul << 20)
+#define TEST03_BLOCK_COUNT  8
+/* block rewritten by dataset 2 */
+#define TEST03_CHANGED_BLOCK 3
+
+static unsigned char pattern (int version, uint64_t offset) {
+  if (version && TEST03_CHANGED_BLOCK == (offset / TEST03_BLOCK_SIZE) % TEST03_BLOCK_COUNT) {
+    offset += 17;
+  }
+
+  return (unsigned char) ((offset * 2654435761u) >> 13);
+}
+
+static int write_dataset (hio_context_t context, int64_t id, int version, uint64_t base, uint64_t *unchanged) {
+  size_t length = TEST03_BLOCK_SIZE * TEST03_BLOCK_COUNT;
+  unsigned char *data = malloc (length);
+  hio_dataset_t dataset;
+  hio_element_t element;
+  int errors = 0;
+  ssize_t rc;
+
+  if (NULL == data) {
+    return 1;
+  }
+
+  for (size_t i = 0 ; i < length ; ++i) {
+    data[i] = pattern (version, base + i);
+  }
+
+  if (HIO_SUCCESS != hio_dataset_alloc (context, &dataset, "incremental", id, HIO_FLAG_WRITE | HIO_FLAG_CREAT |
+                                        HIO_FLAG_TRUNC, HIO_SET_ELEMENT_SHARED) ||
+      HIO_SUCCESS != hio_dataset_open (dataset)) {
+    fprintf (stderr, "Could not create dataset %ld\n", (long) id);
+    free (data);
+    return 1;
+  }
+
+  if (HIO_SUCCESS == hio_element_open (dataset, &element, "data", 0)) {
+    /* write in pieces smaller than the incremental block size */
+    for (size_t offset = 0 ; offset < length ; offset += TEST03_BLOCK_SIZE / 4) {
+      rc = hio_element_write (element, base + offset, 0, data + offset, 1, TEST03_BLOCK_SIZE / 4);
+      if (rc != (ssize_t) TEST03_BLOCK_SIZE / 4) {
+        fprintf (stderr, "Error writing dataset %ld at offset %lu: %ld\n", (long) id,
+                 (unsigned long) (base + offset), (long) rc);
+        ++errors;
+        break;
+      }
+    }
+
+    hio_element_close (&element);
+  } else {
+    ++errors;
+  }
+
+  *unchanged = 0;
+  (void) hio_perf_get_value ((hio_object_t) dataset, "unchanged_bytes", unchanged, sizeof (*unchanged));
+
+  if (HIO_SUCCESS != hio_dataset_close (dataset)) {
+    fprintf (stderr, "Error closing dataset %ld\n", (long) id);
+    ++errors;
+  }
+
+  hio_dataset_free (&dataset);
+  free (data);
+
+  return errors;
+}
+
+static int check_data (hio_context_t context, int64_t id, int version, uint64_t base) {
+  size_t length = TEST03_BLOCK_SIZE * TEST03_BLOCK_COUNT;
+  unsigned char *data = malloc (length);
+  hio_dataset_t dataset;
+  hio_element_t element;
+  uint64_t offset;
+  int errors = 0;
+  ssize_t rc;
+
+  if (NULL == data) {
+    return 1;
+  }
+
+  if (HIO_SUCCESS != hio_dataset_alloc (context, &dataset, "incremental", id, HIO_FLAG_READ,
+                                        HIO_SET_ELEMENT_SHARED) ||
+      HIO_SUCCESS != hio_dataset_open (dataset)) {
+    fprintf (stderr, "Could not open dataset %ld for reading\n", (long) id);
+    free (data);
+    return 1;
+  }
+
+  if (HIO_SUCCESS == hio_element_open (dataset, &element, "data", 0)) {
+    rc = hio_element_read (element, base, 0, data, 1, length);
+    if (rc != (ssize_t) length) {
+      fprintf (stderr, "Short read from dataset %ld: %ld\n", (long) id, (long) rc);
+      ++errors;
+    }
+
+    for (size_t i = 0 ; i < length && !errors ; ++i) {
+      if (data[i] != pattern (version, base + i)) {
+        fprintf (stderr, "Data mismatch in dataset %ld at offset %lu\n", (long) id, (unsigned long) (base + i));
+        ++errors;
+      }
+    }
+
+    /* a read that starts and ends inside a referenced block */
+    offset = base + TEST03_BLOCK_SIZE + 12345;
+    rc = hio_element_read (element, offset, 0, data, 1, 100);
+    if (100 != rc) {
+      fprintf (stderr, "Short read from dataset %ld: %ld\n", (long) id, (long) rc);
+      ++errors;
+    }
+
+    for (size_t i = 0 ; i < 100 && !errors ; ++i) {
+      if (data[i] != pattern (version, offset + i)) {
+        fprintf (stderr, "Data mismatch in dataset %ld at offset %lu\n", (long) id, (unsigned long) (offset + i));
+        ++errors;
+      }
+    }
+
+    hio_element_close (&element);
+  } else {
+    ++errors;
+  }
+
+  hio_dataset_close (dataset);
+  hio_dataset_free (&dataset);
+  free (data);
+
+  return errors;
+}
+
+/* check that the manifest of dataset 2 lists dataset 1 as a reference */
+static int check_references (const char *data_root) {
+  char path[1024], buffer[4096], *references;
+  size_t count;
+  FILE *fh;
+
+  if (0 == strncmp (data_root, "posix:", 6)) {
+    data_root += 6;
+  }
+
+  snprintf (path, sizeof (path), "%s/test03.hio/incremental/2/manifest.json", data_root);
+  fh = fopen (path, "r");
+  if (NULL == fh) {
+    fprintf (stderr, "Could not open manifest %s\n", path);
+    return 1;
+  }
+
+  count = fread (buffer, 1, sizeof (buffer) - 1, fh);
+  fclose (fh);
+  buffer[count] = '\0';
+
+  references = strstr (buffer, "\"hio_references\"");
+  if (NULL == references || NULL == strchr (references, '[') || 1 != strtol (strchr (references, '[') + 1, NULL, 10)) {
+    fprintf (stderr, "Manifest %s does not list dataset 1 as a reference\n", path);
+    return 1;
+  }
+
+  return 0;
+}
+
+int main (int argc, char *argv[]) {
+  uint64_t base, unchanged;
+  MPI_Comm comm = MPI_COMM_WORLD;
+  hio_context_t context;
+  hio_dataset_t dataset;
+  int rank, errors = 0;
+  int rc;
+
+  MPI_Init (&argc, &argv);
+  MPI_Comm_rank (MPI_COMM_WORLD, &rank);
+
+  if (2 != argc) {
+    fprintf (stderr, "usage: %s data_root\n", argv[0]);
+    MPI_Abort (MPI_COMM_WORLD, 1);
+  }
+
+  rc = hio_init_mpi (&context, &comm, NULL, "#HIO.", "test03");
+  if (HIO_SUCCESS != rc) {
+    fprintf (stderr, "Could not initialize hio\n");
+    MPI_Abort (MPI_COMM_WORLD, 1);
+  }
+
+  rc = hio_config_set_value ((hio_object_t) context, "data_roots", argv[1]);
+  if (HIO_SUCCESS != rc) {
+    fprintf (stderr, "Could not set data root to %s\n", argv[1]);
+    MPI_Abort (MPI_COMM_WORLD, 1);
+  }
+
+  base = (uint64_t) rank * TEST03_BLOCK_SIZE * TEST03_BLOCK_COUNT;
+
+  errors += write_dataset (context, 1, 0, base, &unchanged);
+  errors += write_dataset (context, 2, 1, base, &unchanged);
+  if (unchanged != (TEST03_BLOCK_COUNT - 1) * TEST03_BLOCK_SIZE) {
+    fprintf (stderr, "Expected %lu unchanged bytes in dataset 2. got %lu\n",
+             (unsigned long) (TEST03_BLOCK_COUNT - 1) * TEST03_BLOCK_SIZE, (unsigned long) unchanged);
+    ++errors;
+  }
+
+  if (0 == rank) {
+    errors += check_references (argv[1]);
+
+    rc = hio_dataset_unlink (context, "incremental", 1, HIO_UNLINK_MODE_FIRST);
+    if (HIO_ERR_PERM != rc) {
+      fprintf (stderr, "Unlink of referenced dataset 1 returned %d. expected HIO_ERR_PERM\n", rc);
+      ++errors;
+    }
+  }
+
+  MPI_Barrier (MPI_COMM_WORLD);
+
+  rc = hio_dataset_alloc (context, &dataset, "incremental", 1, HIO_FLAG_WRITE | HIO_FLAG_CREAT | HIO_FLAG_TRUNC,
+                          HIO_SET_ELEMENT_SHARED);
+  if (HIO_SUCCESS == rc) {
+    rc = hio_dataset_open (dataset);
+    if (HIO_SUCCESS == rc) {
+      hio_dataset_close (dataset);
+    }
+
+    hio_dataset_free (&dataset);
+  }
+
+  if (HIO_ERR_PERM != rc) {
+    fprintf (stderr, "Truncating referenced dataset 1 returned %d. expected HIO_ERR_PERM\n", rc);
+    ++errors;
+  }
+
+  errors += check_data (context, 2, 1, base);
+  errors += check_data (context, 1, 0, base);
+
+  MPI_Barrier (MPI_COMM_WORLD);
+
+  if (0 == rank) {
+    /* once dataset 2 is gone dataset 1 can be removed */
+    if (HIO_SUCCESS != hio_dataset_unlink (context, "incremental", 2, HIO_UNLINK_MODE_FIRST) ||
+        HIO_SUCCESS != hio_dataset_unlink (context, "incremental", 1, HIO_UNLINK_MODE_FIRST)) {
+      fprintf (stderr, "Could not unlink datasets\n");
+      ++errors;
+    }
+  }
+
+  MPI_Allreduce (MPI_IN_PLACE, &errors, 1, MPI_INT, MPI_SUM, MPI_COMM_WORLD);
+
+  hio_fini (&context);
+  MPI_Finalize ();
+
+  if (0 == rank) {
+    printf ("%s: %d errors\n", argv[0], errors);
+  }
+
+  return errors ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,501 @@
+/* -*- Mode: C; c-basic-offset:2 ; indent-tabs-mode:nil -*- */
+/*
+ * Copyright (c) 2014-2016 Los Alamos National Security, LLC.  All rights
+ *                         reserved.
+ * $COPYRIGHT$
+ *
+ * Additional copyrights may follow
+ *
+ * $HEADER$
+ */
+
+/*
+ * List I/O test
+ *
+ * usage: test04.x data_root
+ *
+ * Each rank writes its part of a shared element with hio_element_write_list() using extents
+ * in random order with gaps between some of them and zero-length entries mixed in. The data
+ * is read back with hio_element_read_list() using a different set of extents. The test also
+ * checks that a failure of a single extent is returned by the list call. Deferred writes
+ * are tested by issuing contiguous and out-of-order hio_element_write_deferred() calls,
+ * flushing, and reusing the same buffers for a second set of writes. Run in each file
+ * mode by setting HIO_dataset_file_mode.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <mpi.h>
+#include <hio.h>
+
+#define TEST04_EXTENT_COUNT 1000
+#define TEST04_FIELD_COUNT 64
+#define TEST04_STRIDED_COUNT 16
+#define TEST04_STRIDED_SIZE 32
+/* each set of deferred writes goes to its own region of the rank's span */
+#define TEST04_REGION_SIZE (1ul << 18)
+
+static unsigned char pattern (uint64_t offset) {
+  return (unsigned char) ((offset * 2654435761u) >> 13);
+}
+
+/* shuffle the first count extents. rand () is seeded by the caller */
+static void shuffle (int count, off_t *offsets, void **ptrs, size_t *lengths) {
+  for (int i = count - 1 ; i > 0 ; --i) {
+    int j = rand () % (i + 1);
+    off_t offset = offsets[i];
+    void *ptr = ptrs[i];
+    size_t length = lengths[i];
+
+    offsets[i] = offsets[j];
+    ptrs[i] = ptrs[j];
+    lengths[i] = lengths[j];
+    offsets[j] = offset;
+    ptrs[j] = ptr;
+    lengths[j] = length;
+  }
+}
+
+static int open_dataset (hio_context_t context, hio_dataset_t *dataset, int64_t id, int flags,
+                         hio_element_t *element) {
+  int rc;
+
+  rc = hio_dataset_alloc (context, dataset, "list", id, flags, HIO_SET_ELEMENT_SHARED);
+  if (HIO_SUCCESS != rc) {
+    return rc;
+  }
+
+  if (2 == id) {
+    /* compressed data can not be overwritten */
+    (void) hio_config_set_value ((hio_object_t) *dataset, "dataset_compression", "zlib");
+  }
+
+  rc = hio_dataset_open (*dataset);
+  if (HIO_SUCCESS != rc) {
+    hio_dataset_free (dataset);
+    return rc;
+  }
+
+  rc = hio_element_open (*dataset, element, "data", 0);
+  if (HIO_SUCCESS != rc) {
+    hio_dataset_close (*dataset);
+    hio_dataset_free (dataset);
+  }
+
+  return rc;
+}
+
+static void close_dataset (hio_dataset_t *dataset, hio_element_t *element) {
+  hio_element_close (element);
+  hio_dataset_close (*dataset);
+  hio_dataset_free (dataset);
+}
+
+/* write and read back the element using list I/O */
+static int test_list (hio_context_t context, uint64_t base, uint64_t end) {
+  off_t offsets[TEST04_EXTENT_COUNT], read_offsets[2 * TEST04_EXTENT_COUNT], bad_offsets[3];
+  size_t lengths[TEST04_EXTENT_COUNT], read_lengths[2 * TEST04_EXTENT_COUNT], bad_lengths[3];
+  void *ptrs[TEST04_EXTENT_COUNT], *read_ptrs[2 * TEST04_EXTENT_COUNT], *bad_ptrs[3];
+  unsigned char *data, *buffer;
+  hio_dataset_t dataset;
+  hio_element_t element;
+  uint64_t offset = 0;
+  size_t total = 0;
+  int errors = 0, count;
+  ssize_t rc;
+
+  for (int i = 0 ; i < TEST04_EXTENT_COUNT ; ++i) {
+    offsets[i] = offset;
+    /* zero-length extents are skipped. their buffers are never touched */
+    lengths[i] = (i % 50) ? 1 + (i * 37) % 500 : 0;
+    offset += lengths[i];
+    if (0 == i % 10) {
+      /* leave a gap */
+      offset += 1000;
+    }
+  }
+
+  data = calloc (1, offset);
+  buffer = calloc (1, offset);
+  if (NULL == data || NULL == buffer) {
+    free (data);
+    free (buffer);
+    return 1;
+  }
+
+  for (int i = 0 ; i < TEST04_EXTENT_COUNT ; ++i) {
+    ptrs[i] = lengths[i] ? data + offsets[i] : NULL;
+    for (size_t j = 0 ; j < lengths[i] ; ++j) {
+      data[offsets[i] + j] = pattern (base + offsets[i] + j);
+    }
+
+    offsets[i] += base;
+    total += lengths[i];
+  }
+
+  shuffle (TEST04_EXTENT_COUNT, offsets, ptrs, lengths);
+
+  rc = open_dataset (context, &dataset, 1, HIO_FLAG_WRITE | HIO_FLAG_CREAT | HIO_FLAG_TRUNC, &element);
+  if (HIO_SUCCESS != rc) {
+    fprintf (stderr, "Could not create dataset. reason: %ld\n", (long) rc);
+    free (data);
+    free (buffer);
+    return 1;
+  }
+
+  rc = hio_element_write_list (element, TEST04_EXTENT_COUNT, offsets, (const void * const *) ptrs, lengths);
+  if (rc != (ssize_t) total) {
+    fprintf (stderr, "hio_element_write_list returned %ld. expected %lu\n", (long) rc, (unsigned long) total);
+    ++errors;
+  }
+
+  /* nothing is written if any extent is invalid */
+  bad_offsets[0] = base;
+  bad_offsets[1] = -1;
+  bad_lengths[0] = bad_lengths[1] = 1;
+  bad_ptrs[0] = bad_ptrs[1] = data;
+  rc = hio_element_write_list (element, 2, bad_offsets, (const void * const *) bad_ptrs, bad_lengths);
+  if (HIO_ERR_BAD_PARAM != rc) {
+    fprintf (stderr, "hio_element_write_list with a negative offset returned %ld. expected %d\n", (long) rc,
+             HIO_ERR_BAD_PARAM);
+    ++errors;
+  }
+
+  close_dataset (&dataset, &element);
+
+  /* read each extent back in two pieces */
+  count = 0;
+  for (int i = 0 ; i < TEST04_EXTENT_COUNT ; ++i) {
+    size_t half = lengths[i] / 2;
+    unsigned char *ptr = lengths[i] ? buffer + (offsets[i] - base) : NULL;
+
+    read_offsets[count] = offsets[i];
+    read_lengths[count] = half;
+    read_ptrs[count++] = ptr;
+    read_offsets[count] = offsets[i] + half;
+    read_lengths[count] = lengths[i] - half;
+    read_ptrs[count++] = ptr ? ptr + half : NULL;
+  }
+
+  shuffle (count, read_offsets, read_ptrs, read_lengths);
+
+  rc = open_dataset (context, &dataset, 1, HIO_FLAG_READ, &element);
+  if (HIO_SUCCESS != rc) {
+    fprintf (stderr, "Could not open dataset for reading. reason: %ld\n", (long) rc);
+    free (data);
+    free (buffer);
+    return errors + 1;
+  }
+
+  rc = hio_element_read_list (element, count, read_offsets, read_ptrs, read_lengths);
+  if (rc != (ssize_t) total) {
+    fprintf (stderr, "hio_element_read_list returned %ld. expected %lu\n", (long) rc, (unsigned long) total);
+    ++errors;
+  }
+
+  if (memcmp (data, buffer, offset)) {
+    fprintf (stderr, "Data read with hio_element_read_list does not match the data written\n");
+    ++errors;
+  }
+
+  /* a read of one extent past the end of the element must be reported */
+  bad_offsets[0] = base;
+  bad_offsets[1] = end + 4096;
+  bad_offsets[2] = base + 100;
+  bad_lengths[0] = bad_lengths[1] = bad_lengths[2] = 100;
+  bad_ptrs[0] = buffer;
+  bad_ptrs[1] = buffer + 100;
+  bad_ptrs[2] = buffer + 200;
+  rc = hio_element_read_list (element, 3, bad_offsets, bad_ptrs, bad_lengths);
+  if (rc >= 300) {
+    fprintf (stderr, "hio_element_read_list past the end of the element returned %ld\n", (long) rc);
+    ++errors;
+  }
+
+  /* the dataset is not writable */
+  rc = hio_element_write_list (element, 1, bad_offsets, (const void * const *) bad_ptrs, bad_lengths);
+  if (HIO_ERR_PERM != rc) {
+    fprintf (stderr, "hio_element_write_list on a read-only dataset returned %ld. expected %d\n", (long) rc,
+             HIO_ERR_PERM);
+    ++errors;
+  }
+
+  close_dataset (&dataset, &element);
+
+  free (data);
+  free (buffer);
+
+  return errors;
+}
+
+/* one extent of a list write fails because it overwrites compressed data */
+static int test_list_error (hio_context_t context, uint64_t base) {
+  off_t offsets[2] = {base + 8192, base + 2048};
+  size_t lengths[2] = {4096, 1000};
+  unsigned char data[3][4096];
+  const void *ptrs[2] = {data[1], data[2]};
+  hio_dataset_t dataset;
+  hio_element_t element;
+  uint64_t compressed = 0;
+  int errors = 0;
+  ssize_t rc;
+
+  for (int i = 0 ; i < 3 ; ++i) {
+    memset (data[i], 'a' + i, sizeof (data[i]));
+  }
+
+  rc = open_dataset (context, &dataset, 2, HIO_FLAG_WRITE | HIO_FLAG_CREAT | HIO_FLAG_TRUNC, &element);
+  if (HIO_SUCCESS != rc) {
+    fprintf (stderr, "Could not create compressed dataset. reason: %ld\n", (long) rc);
+    return 1;
+  }
+
+  rc = hio_element_write (element, base, 0, data[0], 1, sizeof (data[0]));
+  if (rc != (ssize_t) sizeof (data[0])) {
+    fprintf (stderr, "hio_element_write returned %ld\n", (long) rc);
+    ++errors;
+  }
+
+  /* write the buffered data so the overwrite is detected by the list write */
+  (void) hio_element_flush (element, HIO_FLUSH_MODE_LOCAL);
+
+  /* compression is only supported in optimized mode and requires zlib */
+  (void) hio_perf_get_value ((hio_object_t) dataset, "compressed_bytes", &compressed, sizeof (compressed));
+  if (0 == compressed) {
+    close_dataset (&dataset, &element);
+    return errors;
+  }
+
+  rc = hio_element_write_list (element, 2, offsets, ptrs, lengths);
+  if (HIO_ERR_NOT_AVAILABLE != rc) {
+    fprintf (stderr, "hio_element_write_list overwriting compressed data returned %ld. expected %d\n", (long) rc,
+             HIO_ERR_NOT_AVAILABLE);
+    ++errors;
+  }
+
+  close_dataset (&dataset, &element);
+
+  return errors;
+}
+
+/* fill the field buffers with the data expected at the region starting at base */
+static void fill_fields (uint64_t base, int count, const off_t *offsets, void **ptrs, const size_t *lengths,
+                         unsigned char *strided) {
+  for (int i = 0 ; i < count ; ++i) {
+    for (size_t j = 0 ; j < lengths[i] ; ++j) {
+      ((unsigned char *) ptrs[i])[j] = pattern (base + offsets[i] + j);
+    }
+  }
+
+  /* only every other block of the strided buffer is written */
+  for (int i = 0 ; i < TEST04_STRIDED_COUNT ; ++i) {
+    memset (strided + 2 * i * TEST04_STRIDED_SIZE + TEST04_STRIDED_SIZE, 0xff, TEST04_STRIDED_SIZE);
+    for (int j = 0 ; j < TEST04_STRIDED_SIZE ; ++j) {
+      strided[2 * i * TEST04_STRIDED_SIZE + j] = pattern (base + TEST04_REGION_SIZE / 2 + i * TEST04_STRIDED_SIZE + j);
+    }
+  }
+}
+
+/* write two regions with deferred writes from the same buffers and read them back */
+static int test_deferred (hio_context_t context, uint64_t base) {
+  off_t offsets[TEST04_FIELD_COUNT], region_offsets[TEST04_FIELD_COUNT];
+  size_t lengths[TEST04_FIELD_COUNT], region_lengths[TEST04_FIELD_COUNT];
+  void *ptrs[TEST04_FIELD_COUNT], *region_ptrs[TEST04_FIELD_COUNT];
+  unsigned char strided[2 * TEST04_STRIDED_COUNT * TEST04_STRIDED_SIZE];
+  unsigned char *fields, *buffer, *ptr;
+  hio_dataset_t dataset;
+  hio_element_t element;
+  uint64_t offset = 0;
+  int errors = 0;
+  ssize_t rc;
+
+  /* fields are contiguous in the element except for a gap before every eighth field. they are
+   * padded in memory so contiguous writes need more than one iovec */
+  for (int i = 0 ; i < TEST04_FIELD_COUNT ; ++i) {
+    if (i && 0 == i % 8) {
+      offset += 512;
+    }
+
+    offsets[i] = offset;
+    lengths[i] = 1 + (i * 53) % 3000;
+    offset += lengths[i];
+  }
+
+  fields = malloc (offset + TEST04_FIELD_COUNT * 16);
+  buffer = malloc (TEST04_REGION_SIZE);
+  if (NULL == fields || NULL == buffer) {
+    free (fields);
+    free (buffer);
+    return 1;
+  }
+
+  ptr = fields;
+  for (int i = 0 ; i < TEST04_FIELD_COUNT ; ++i) {
+    ptrs[i] = ptr;
+    ptr += lengths[i] + 16;
+  }
+
+  rc = open_dataset (context, &dataset, 3, HIO_FLAG_WRITE | HIO_FLAG_CREAT | HIO_FLAG_TRUNC, &element);
+  if (HIO_SUCCESS != rc) {
+    fprintf (stderr, "Could not create dataset. reason: %ld\n", (long) rc);
+    free (fields);
+    free (buffer);
+    return 1;
+  }
+
+  for (int region = 0 ; region < 2 ; ++region) {
+    uint64_t region_base = base + region * TEST04_REGION_SIZE;
+
+    /* the buffers of the first region are reused once the flush has returned */
+    fill_fields (region_base, TEST04_FIELD_COUNT, offsets, ptrs, lengths, strided);
+
+    memcpy (region_offsets, offsets, sizeof (offsets));
+    memcpy (region_ptrs, ptrs, sizeof (ptrs));
+    memcpy (region_lengths, lengths, sizeof (lengths));
+
+    /* the first half of the fields are written in order and the rest out of order */
+    shuffle (TEST04_FIELD_COUNT / 2, region_offsets + TEST04_FIELD_COUNT / 2, region_ptrs + TEST04_FIELD_COUNT / 2,
+             region_lengths + TEST04_FIELD_COUNT / 2);
+
+    for (int i = 0 ; i < TEST04_FIELD_COUNT ; ++i) {
+      rc = hio_element_write_deferred (element, region_base + region_offsets[i], 0, region_ptrs[i], 1,
+                                       region_lengths[i], 0);
+      if (HIO_SUCCESS != rc) {
+        fprintf (stderr, "hio_element_write_deferred returned %ld\n", (long) rc);
+        ++errors;
+      }
+    }
+
+    rc = hio_element_write_deferred (element, region_base + TEST04_REGION_SIZE / 2, 0, strided,
+                                     TEST04_STRIDED_COUNT, TEST04_STRIDED_SIZE, TEST04_STRIDED_SIZE);
+    if (HIO_SUCCESS != rc) {
+      fprintf (stderr, "strided hio_element_write_deferred returned %ld\n", (long) rc);
+      ++errors;
+    }
+
+    rc = hio_element_flush (element, HIO_FLUSH_MODE_LOCAL);
+    if (HIO_SUCCESS != rc) {
+      fprintf (stderr, "hio_element_flush after deferred writes returned %ld\n", (long) rc);
+      ++errors;
+    }
+  }
+
+  /* clobber the buffers. the data must have been written by the flush */
+  memset (fields, 0, offset + TEST04_FIELD_COUNT * 16);
+  memset (strided, 0, sizeof (strided));
+
+  close_dataset (&dataset, &element);
+
+  rc = open_dataset (context, &dataset, 3, HIO_FLAG_READ, &element);
+  if (HIO_SUCCESS != rc) {
+    fprintf (stderr, "Could not open dataset for reading. reason: %ld\n", (long) rc);
+    free (fields);
+    free (buffer);
+    return errors + 1;
+  }
+
+  for (int region = 0 ; region < 2 ; ++region) {
+    uint64_t region_base = base + region * TEST04_REGION_SIZE;
+    size_t strided_size = TEST04_STRIDED_COUNT * TEST04_STRIDED_SIZE;
+
+    for (int i = 0 ; i < TEST04_FIELD_COUNT ; ++i) {
+      rc = hio_element_read (element, region_base + offsets[i], 0, buffer, 1, lengths[i]);
+      if (rc != (ssize_t) lengths[i]) {
+        fprintf (stderr, "hio_element_read of deferred field %d returned %ld. expected %lu\n", i, (long) rc,
+                 (unsigned long) lengths[i]);
+        ++errors;
+        continue;
+      }
+
+      for (size_t j = 0 ; j < lengths[i] ; ++j) {
+        if (buffer[j] != pattern (region_base + offsets[i] + j)) {
+          fprintf (stderr, "Data mismatch in deferred field %d of region %d at byte %lu\n", i, region,
+                   (unsigned long) j);
+          ++errors;
+          break;
+        }
+      }
+    }
+
+    rc = hio_element_read (element, region_base + TEST04_REGION_SIZE / 2, 0, buffer, 1, strided_size);
+    if (rc != (ssize_t) strided_size) {
+      fprintf (stderr, "hio_element_read of strided deferred write returned %ld. expected %lu\n", (long) rc,
+               (unsigned long) strided_size);
+      ++errors;
+      continue;
+    }
+
+    for (size_t j = 0 ; j < strided_size ; ++j) {
+      if (buffer[j] != pattern (region_base + TEST04_REGION_SIZE / 2 + j)) {
+        fprintf (stderr, "Data mismatch in strided deferred write of region %d at byte %lu\n", region,
+                 (unsigned long) j);
+        ++errors;
+        break;
+      }
+    }
+  }
+
+  /* the dataset is not writable */
+  rc = hio_element_write_deferred (element, base, 0, fields, 1, 1, 0);
+  if (HIO_ERR_PERM != rc) {
+    fprintf (stderr, "hio_element_write_deferred on a read-only dataset returned %ld. expected %d\n", (long) rc,
+             HIO_ERR_PERM);
+    ++errors;
+  }
+
+  close_dataset (&dataset, &element);
+
+  free (fields);
+  free (buffer);
+
+  return errors;
+}
+
+int main (int argc, char *argv[]) {
+  MPI_Comm comm = MPI_COMM_WORLD;
+  int rank, nranks, errors = 0;
+  hio_context_t context;
+  uint64_t span = 1ul << 20;
+  int rc;
+
+  MPI_Init (&argc, &argv);
+  MPI_Comm_rank (MPI_COMM_WORLD, &rank);
+  MPI_Comm_size (MPI_COMM_WORLD, &nranks);
+
+  if (2 != argc) {
+    fprintf (stderr, "usage: %s data_root\n", argv[0]);
+    MPI_Abort (MPI_COMM_WORLD, 1);
+  }
+
+  rc = hio_init_mpi (&context, &comm, NULL, "#HIO.", "test04");
+  if (HIO_SUCCESS != rc) {
+    fprintf (stderr, "Could not initialize hio\n");
+    MPI_Abort (MPI_COMM_WORLD, 1);
+  }
+
+  rc = hio_config_set_value ((hio_object_t) context, "data_roots", argv[1]);
+  if (HIO_SUCCESS != rc) {
+    fprintf (stderr, "Could not set data root to %s\n", argv[1]);
+    MPI_Abort (MPI_COMM_WORLD, 1);
+  }
+
+  srand (rank + 1);
+
+  errors += test_list (context, rank * span, nranks * span);
+  errors += test_list_error (context, rank * span);
+  errors += test_deferred (context, rank * span);
+
+  MPI_Allreduce (MPI_IN_PLACE, &errors, 1, MPI_INT, MPI_SUM, MPI_COMM_WORLD);
+
+  hio_fini (&context);
+  MPI_Finalize ();
+
+  if (0 == rank) {
+    printf ("%s: %d errors\n", argv[0], errors);
+  }
+
+  return errors ? EXIT_FAILURE : EXIT_SUCCESS;
+}
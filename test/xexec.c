@@ -184,6 +184,9 @@ char * help =
   "  her <offset> <size> Element read, offset relative to current element offset\n"
   "  hewr <offset> <min> <max> <align> Element write random size, offset relative to current element offset\n"
   "  herr <offset> <min> <max> <align> Element read random size, offset relative to current element offset\n"
+  "  hern <offset> <size> <count> <stride> Element non-blocking reads of <count> pieces of <size>\n"
+  "                bytes <stride> bytes apart, offset relative to current element offset.  The\n"
+  "                byte count and data of each piece are checked against a blocking read\n"
   "  hsega <start> <size_per_rank> <rank_shift> Activate absolute segmented\n"
   "                addressing. Actual offset now ofs + <start> + rank*size\n"
   "  hsegr <start> <size_per_rank> <rank_shift> Activate relative segmented\n"
@@ -194,7 +197,8 @@ char * help =
   "  hdu <name> <id> CURRENT|FIRST|ALL  Dataset unlink\n"
   "  hf            Fini\n"
   "  hxrc <rc_name|ANY> Expect non-SUCCESS rc on next HIO action\n"
-  "  hxct <count>  Expect count != request on next R/W.  -999 = any count\n"
+  "  hxct <count>  Expect count != request on next R/W.  -999 = any count, other negative\n"
+  "                values are an expected hio error code\n"
   "  hxdi <id> Expect dataset ID on next hdo\n"
   "  hvp <type regex> <name regex> Prints config and performance variables that match\n"
   "                the type and name regex's [1][2].  Types are two letter codes {c|p} {c|d|e}\n"
@@ -1923,6 +1927,7 @@ ENUM_NAMP(HIO_, ERR_NOT_FOUND)
 ENUM_NAMP(HIO_, ERR_NOT_AVAILABLE)
 ENUM_NAMP(HIO_, ERR_BAD_PARAM)
 ENUM_NAMP(HIO_, ERR_EXISTS)
+ENUM_NAMP(HIO_, ERR_CORRUPT)
 ENUM_NAMP(HIO_, ERR_IO_TEMPORARY)
 ENUM_NAMP(HIO_, ERR_IO_PERMANENT)
 ENUM_NAMP(HIO_, ANY)
@@ -2225,6 +2230,65 @@ ACTION_RUN(herr_run) {
   her_run(&new, pactn);
 }
 
+ACTION_CHECK(hern_check) {
+  U64 size = V1.u;
+  U64 count = V2.u;
+  if (count < 1) ERRX("%s; count < 1", A.desc);
+  if (size * count > rwbuf_len) ERRX("%s; size * count > rwbuf_len", A.desc);
+}
+
+// Issue all pieces with hio_element_read_nb so they can be aggregated, then compare each
+// piece with a blocking read of the same range.  hxct applies to the total byte count.
+ACTION_RUN(hern_run) {
+  hio_return_t hrc = HIO_SUCCESS;
+  ssize_t hcnt = 0;
+  I64 ofs_param = V0.u;
+  U64 size = V1.u;
+  U64 count = V2.u;
+  U64 stride = V3.u;
+  U64 hreq = size * count;
+  U64 ofs_abs;
+
+  ofs_abs = hio_e_ofs + ofs_param;
+  DBG2("hern el_ofs: %lld ofs_param: %lld ofs_abs: %lld len: %lld count: %lld stride: %lld", hio_e_ofs,
+       ofs_param, ofs_abs, size, count, stride);
+  hio_e_ofs = ofs_abs + (count - 1) * stride + size;
+  hio_request_t * reqs = MALLOCX(count * sizeof(hio_request_t));
+  ssize_t * cnts = MALLOCX(count * sizeof(ssize_t));
+  char * buf = MALLOCX(size);
+
+  ETIMER_START(&local_tmr);
+  for (U64 i = 0; i < count; ++i) {
+    hio_return_t rc = hio_element_read_nb (element, &reqs[i], ofs_abs + i * stride, 0,
+                                           (char *)rbuf_ptr + i * size, 1, size);
+    if (HIO_SUCCESS != rc) {
+      reqs[i] = HIO_OBJECT_NULL;
+      if (HIO_SUCCESS == hrc) hrc = rc;
+    }
+  }
+  hio_request_wait (reqs, count, cnts);
+  hio_her_time += ETIMER_ELAPSED(&local_tmr);
+  HRC_TEST(hio_element_read_nb)
+
+  ETIMER_START(&local_tmr);
+  for (U64 i = 0; i < count; ++i) {
+    ssize_t bcnt = hio_element_read (element, ofs_abs + i * stride, 0, buf, 1, size);
+    if (cnts[i] != bcnt || (bcnt > 0 && memcmp(buf, (char *)rbuf_ptr + i * size, bcnt))) {
+      VERB0("%s; piece %lld at offset %lld: hio_element_read_nb cnt: %lld hio_element_read cnt: %lld%s",
+            A.desc, i, ofs_abs + i * stride, (I64)cnts[i], (I64)bcnt, cnts[i] == bcnt ? " data mismatch": "");
+      local_fails++;
+    }
+    if (cnts[i] > 0) hcnt += cnts[i];
+  }
+  hio_exc_time += ETIMER_ELAPSED(&local_tmr);
+  HCNT_TEST(hio_element_read_nb)
+  hio_rw_count[0] += hcnt;
+
+  FREEX(buf);
+  FREEX(cnts);
+  FREEX(reqs);
+}
+
 ACTION_RUN(hec_run) {
   hio_return_t hrc;
   ETIMER_START(&local_tmr);
@@ -2318,8 +2382,8 @@ ACTION_RUN(hxrc_run) {
 
 ACTION_CHECK(hxct_check) {
   I64 count = V0.u;
-  if (count < 0 && count != HIO_CNT_ANY && count != HIO_CNT_REQ)
-    ERRX("%s; count negative and not %d (ANY) or %d (REQ)", A.desc, HIO_CNT_ANY, HIO_CNT_REQ);
+  if (count < HIO_ERR_IO_PERMANENT && count != HIO_CNT_ANY && count != HIO_CNT_REQ)
+    ERRX("%s; count negative and not an hio error code, %d (ANY) or %d (REQ)", A.desc, HIO_CNT_ANY, HIO_CNT_REQ);
 }
 
 ACTION_RUN(hxct_run) {
@@ -2647,6 +2711,7 @@ struct parse {
   {"her",   {SINT, UINT, NONE, NONE, NONE}, her_check,     her_run     },
   {"hewr",  {SINT, UINT, UINT, UINT, NONE}, hew_check,     hewr_run    },
   {"herr",  {SINT, UINT, UINT, UINT, NONE}, her_check,     herr_run    },
+  {"hern",  {SINT, UINT, UINT, UINT, NONE}, hern_check,    hern_run    },
   {"hec",   {NONE, NONE, NONE, NONE, NONE}, NULL,          hec_run     },
   {"hdc",   {NONE, NONE, NONE, NONE, NONE}, NULL,          hdc_run     },
   {"hdf",   {NONE, NONE, NONE, NONE, NONE}, NULL,          hdf_run     },